@@ -0,0 +1,290 @@
+//analyze.cpp
+// Reads record stores (see koikoi-record.hpp) straight out of memory, on every core, and reports on the games in them:
+// how often each combo scores, how often Koi-Koi pays off for each raw score it is called on, how often deals are
+// redone, and how the dealer fares against the other seat.
+//
+// Each thread takes an even slice of every store's records and walks it in order. Rounds are unpacked a batch at a time
+// into one array per field, and every statistic is then a plain loop over those arrays (which the compiler vectorises),
+// rather than a branch per round.
+extern "C" {
+#include "csapp.h"
+}
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include "koikoi-record.hpp"
+#include "koikoi-strategy.hpp"
+
+#define BATCHROUNDS 4096    // rounds unpacked at a time
+#define RAWBUCKETS  16      // Koi-Koi calls are counted per raw score up to this, and together above it
+
+/* =====================================
+STATISTICS
+===================================== */
+
+// one batch of rounds, one array per field
+struct RoundBatch {
+    int             count;
+    unsigned char   dealer[BATCHROUNDS];
+    unsigned char   winner[BATCHROUNDS];        // seat that scored + 1 (0 if nobody did)
+    unsigned char   points[BATCHROUNDS];
+    unsigned char   misdeals[BATCHROUNDS];
+    unsigned char   instant[BATCHROUNDS];
+    unsigned short  combos[BATCHROUNDS];
+    unsigned char   rawAtCall[2][BATCHROUNDS];  // each seat's raw score at its first call (0 = no call), at most RAWBUCKETS
+};
+
+// everything counted (each thread fills its own, and they are merged at the end)
+struct Analysis {
+    long    games;
+    long    bytes;
+    long    badRecords;                         // records that ended part-way through a round
+    long    rounds;
+    long    misdeals;
+    long    instantWins;
+    long    noPoints;                           // rounds that ended with the deck running out
+    long    combos[NUMCOMBOS];                  // scoring rounds the combo was part of
+    long    scoringRounds;                      // rounds won other than by an instant win
+    long    wins[2];                            // rounds won by the dealer [0] & the other seat [1]
+    long    points[2];                          // points they scored
+    long    calls[RAWBUCKETS+1];                // rounds with a first Koi-Koi call on each raw score
+    long    callsWon[RAWBUCKETS+1];             // ...that the caller went on to win
+    long    callsLost[RAWBUCKETS+1];            // ...that the opponent went on to win
+
+    Analysis() { memset(this, 0, sizeof(*this)); }
+
+    void merge(const Analysis &other) {
+        const long *from = reinterpret_cast<const long*>(&other);
+        long *to = reinterpret_cast<long*>(this);
+        for (size_t i = 0; i < sizeof(*this) / sizeof(long); i++) {     // (every member is a long)
+            to[i] += from[i];
+        }
+    }
+};
+
+// adds up one batch; each loop is branch-free over one or two arrays, with counters small enough to stay in vector lanes
+static void countBatch(const RoundBatch &b, Analysis &a) {
+    int n = b.count;
+    unsigned int misdeals = 0, instant = 0, noPoints = 0, scoring = 0;
+    unsigned int wins[2] = {0, 0}, points[2] = {0, 0};
+
+    for (int i = 0; i < n; i++) {
+        misdeals += b.misdeals[i];
+        instant  += b.instant[i];
+        noPoints += (b.winner[i] == 0);
+        scoring  += (b.winner[i] != 0) & (b.instant[i] == 0);
+    }
+    for (int i = 0; i < n; i++) {
+        unsigned int dealerWon = (b.winner[i] == b.dealer[i] + 1);
+        unsigned int otherWon  = (b.winner[i] != 0) & !dealerWon;
+        wins[0]   += dealerWon;
+        wins[1]   += otherWon;
+        points[0] += dealerWon * b.points[i];
+        points[1] += otherWon * b.points[i];
+    }
+    for (int c = 0; c < NUMCOMBOS; c++) {
+        unsigned int count = 0;
+        for (int i = 0; i < n; i++) {
+            count += (b.combos[i] >> c) & 1;
+        }
+        a.combos[c] += count;
+    }
+    for (int seat = 0; seat < 2; seat++) {
+        const unsigned char *raw = b.rawAtCall[seat];
+        for (int r = 1; r <= RAWBUCKETS; r++) {
+            unsigned int calls = 0, won = 0, lost = 0;
+            for (int i = 0; i < n; i++) {
+                unsigned int called = (raw[i] == r);
+                calls += called;
+                won   += called & (b.winner[i] == seat + 1);
+                lost  += called & (b.winner[i] == 2 - seat);
+            }
+            a.calls[r]     += calls;
+            a.callsWon[r]  += won;
+            a.callsLost[r] += lost;
+        }
+    }
+
+    a.rounds        += n;
+    a.misdeals      += misdeals;
+    a.instantWins   += instant;
+    a.noPoints      += noPoints;
+    a.scoringRounds += scoring;
+    for (int s = 0; s < 2; s++) {
+        a.wins[s]   += wins[s];
+        a.points[s] += points[s];
+    }
+    return;
+}
+
+// unpacks every round of one record into the batch, counting (and emptying) the batch whenever it fills up
+// RETURN: false if the record ends part-way through a round
+static bool unpackRecord(const unsigned char *record, RoundBatch &b, Analysis &a) {
+    size_t length = recordLength(record);
+    size_t at = RECORDHEADER;
+
+    for (int r = 0; r < recordRounds(record); r++) {
+        const unsigned char *round = record + at;
+        if (at + RECORDROUND > length || at + roundLength(round) > length) {
+            return false;
+        }
+        int i = b.count++;
+        b.dealer[i]   = roundDealer(round);
+        b.winner[i]   = roundWinner(round) + 1;
+        b.points[i]   = roundPoints(round);
+        b.misdeals[i] = roundMisdeals(round);
+        b.instant[i]  = roundInstantWin(round);
+        b.combos[i]   = roundCombos(round);
+        for (int seat = 0; seat < 2; seat++) {
+            int raw = roundRawAtCall(round, seat);
+            b.rawAtCall[seat][i] = (raw < RAWBUCKETS) ? raw : RAWBUCKETS;
+        }
+        if (b.count == BATCHROUNDS) {
+            countBatch(b, a);
+            b.count = 0;
+        }
+        at += roundLength(round);
+    }
+    return true;
+}
+
+/* =====================================
+SCANNING
+===================================== */
+
+struct ScanWorker {
+    const std::vector<RecordStore*> *stores;
+    int         index;              // which worker this is (0 to threads-1)
+    int         threads;
+    Analysis    analysis;
+};
+
+static void *scanThread(void *vargp) {
+    ScanWorker *worker = static_cast<ScanWorker*>(vargp);
+    Analysis &a = worker->analysis;
+    RoundBatch *batch = new RoundBatch;
+
+    batch->count = 0;
+    for (size_t s = 0; s < worker->stores->size(); s++) {
+        const RecordStore &store = *(*worker->stores)[s];
+        long first = store.count() * worker->index / worker->threads;
+        long last  = store.count() * (worker->index + 1) / worker->threads;
+        if (first == last) {
+            continue;
+        }
+        const unsigned char *record = store.record(first);     // the slice's records are back to back, so walk them in order
+        for (long g = first; g < last; g++) {
+            a.games++;
+            a.bytes += recordLength(record);
+            if (!unpackRecord(record, *batch, a)) {
+                a.badRecords++;
+            }
+            record += recordLength(record);
+        }
+    }
+    countBatch(*batch, a);
+    delete batch;
+    return NULL;
+}
+
+/* =====================================
+REPORTING
+===================================== */
+
+// percentage of part in whole, or 0 if whole is 0
+static double percent(long part, long whole) {
+    return (whole == 0) ? 0.0 : 100.0 * part / whole;
+}
+
+static void printReport(const Analysis &a, int stores, int threads, double seconds) {
+    printf("%ld games (%ld rounds, %.1f MB) from %d store%s, %d threads\n",
+           a.games, a.rounds, a.bytes / 1e6, stores, (stores == 1) ? "" : "s", threads);
+    printf("Scanned in %.3f s: %.0f games/s, %.0f MB/s\n", seconds, a.games / seconds, a.bytes / 1e6 / seconds);
+    if (a.badRecords > 0) {
+        printf("  (%ld records were cut short, and only counted up to where they stop)\n", a.badRecords);
+    }
+
+    printf("\nROUNDS\n");
+    printf("  misdeals per round:   %8.4f\n", (a.rounds == 0) ? 0.0 : static_cast<double>(a.misdeals) / a.rounds);
+    printf("  instant wins:         %6.2f%%\n", percent(a.instantWins, a.rounds));
+    printf("  no points (deck out): %6.2f%%\n", percent(a.noPoints, a.rounds));
+    printf("                         dealer    other seat\n");
+    printf("  rounds won:           %6.2f%%    %6.2f%%\n", percent(a.wins[0], a.rounds), percent(a.wins[1], a.rounds));
+    printf("  points per round:     %7.3f    %7.3f\n",
+           (a.rounds == 0) ? 0.0 : static_cast<double>(a.points[0]) / a.rounds, (a.rounds == 0) ? 0.0 : static_cast<double>(a.points[1]) / a.rounds);
+    printf("  points per round won: %7.3f    %7.3f\n",
+           (a.wins[0] == 0) ? 0.0 : static_cast<double>(a.points[0]) / a.wins[0], (a.wins[1] == 0) ? 0.0 : static_cast<double>(a.points[1]) / a.wins[1]);
+
+    printf("\nCOMBOS (share of %ld rounds scored with combos)\n", a.scoringRounds);
+    for (int c = 0; c < NUMCOMBOS; c++) {
+        printf("  %-20s %6.2f%%\n", comboName(static_cast<ComboType>(c)), percent(a.combos[c], a.scoringRounds));
+    }
+
+    printf("\nKOI-KOI BY RAW SCORE AT THE FIRST CALL\n");
+    printf("  raw      calls      won     lost  deck out\n");
+    for (int r = 1; r <= RAWBUCKETS; r++) {
+        if (a.calls[r] == 0) {
+            continue;               // skip raw scores nobody called on
+        }
+        printf("  %3d%s %9ld  %6.2f%%  %6.2f%%  %6.2f%%\n", r, (r == RAWBUCKETS) ? "+" : " ", a.calls[r],
+               percent(a.callsWon[r], a.calls[r]), percent(a.callsLost[r], a.calls[r]),
+               percent(a.calls[r] - a.callsWon[r] - a.callsLost[r], a.calls[r]));
+    }
+    return;
+}
+
+// prints how to run the analyzer, then exits
+static void usage(const char *progname) {
+    fprintf(stderr, "usage: %s [-t threads] store...\n", progname);
+    fprintf(stderr, "   -t  worker threads (default: one per online core)\n");
+    fprintf(stderr, "   store: a record store written by hserver.out or hsim.out -o\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    std::vector<RecordStore*> stores;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:")) != -1) {
+        switch (opt) {
+            case 't': threads = atoi(optarg); break;
+            default:  usage(argv[0]);
+        }
+    }
+    if (threads < 1 || optind >= argc) {
+        usage(argv[0]);
+    }
+    for (int i = optind; i < argc; i++) {
+        RecordStore *store = new RecordStore;
+        if (!store->open(argv[i], false)) {
+            perror(argv[i]);
+            return 1;
+        }
+        stores.push_back(store);
+    }
+
+    std::vector<ScanWorker> workers(threads);
+    std::vector<pthread_t> tids(threads);
+    Analysis total;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < threads; i++) {
+        workers[i].stores  = &stores;
+        workers[i].index   = i;
+        workers[i].threads = threads;
+        Pthread_create(&tids[i], NULL, scanThread, &workers[i]);
+    }
+    for (int i = 0; i < threads; i++) {
+        Pthread_join(tids[i], NULL);
+        total.merge(workers[i].analysis);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printReport(total, stores.size(), threads, seconds);
+    for (size_t i = 0; i < stores.size(); i++) {
+        delete stores[i];
+    }
+    return 0;
+}
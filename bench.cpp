@@ -0,0 +1,267 @@
+//bench.cpp
+// Microbenchmarks for the card, hand, deck, and scoring primitives. Reports the time and the # of heap allocations
+// per operation, and compares them against a stored baseline (see "bench-baseline.txt"), so that every change to
+// those data structures can be measured. Run "make bench" to build & run it against the baseline.
+#include <unistd.h>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include <chrono>
+#include "hanafuda-card.hpp"
+#include "hanafuda-deck.hpp"
+#include "hanafuda-hands.hpp"
+#include "koikoi-rules.hpp"
+
+/* =====================================
+COUNTING ALLOCATIONS
+Every heap allocation in the program goes through these, so a benchmark can count its own.
+===================================== */
+
+static long allocations = 0;
+
+void *operator new(std::size_t size) {
+    allocations++;
+    void *p = std::malloc(size ? size : 1);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+/* =====================================
+RUNNING BENCHMARKS
+===================================== */
+
+#define POSITIONS 64        // # of different seeded positions each benchmark cycles through
+
+static volatile long sink;  // results are added here, so that the compiler cannot throw the work away
+
+// a random mid-round position: a hand, a table, and a score pile
+struct Position {
+    Hand        hand;
+    Hand        table;
+    ScorePile   pile;
+};
+
+struct BenchResult {
+    std::string name;
+    double      nsPerOp;
+    double      allocsPerOp;
+};
+
+// settings & shared data for all the benchmarks
+struct Bench {
+    double                      seconds;        // minimum time to spend timing each benchmark
+    const char                  *filter;        // only run benchmarks whose names contain this, or NULL for all
+    std::vector<Position>       positions;
+    std::vector<BenchResult>    results;
+
+    // times body(i) for i = 0, 1, 2, ..., where each call does opsPerCall operations; the # of calls is doubled until it takes long enough
+    template <class Body>
+    void run(const char *name, int opsPerCall, Body body) {
+        if (filter != NULL && strstr(name, filter) == NULL) {
+            return;
+        }
+        for (long i = 0; i < 1000; i++) {           // warm up, so that any reusable buffers are already allocated
+            body(i);
+        }
+        for (long calls = 1000; ; calls *= 2) {
+            long allocs_before = allocations;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (long i = 0; i < calls; i++) {
+                body(i);
+            }
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (elapsed >= seconds) {
+                BenchResult result;
+                result.name        = name;
+                result.nsPerOp     = 1e9 * elapsed / (calls * opsPerCall);
+                result.allocsPerOp = static_cast<double>(allocations - allocs_before) / (calls * opsPerCall);
+                results.push_back(result);
+                return;
+            }
+        }
+    }
+};
+
+// deals POSITIONS random positions, each partway through a round
+static void makePositions(std::vector<Position> &positions) {
+    std::mt19937 rng(1);
+    DeckType deck;
+    positions.resize(POSITIONS);
+    for (int p = 0; p < POSITIONS; p++) {
+        deck.initialize();
+        deck.shuffle(rng);
+        dealCards(deck, positions[p].hand, 1 + rng() % 8);
+        dealCards(deck, positions[p].table, 6 + rng() % 7);
+        for (int n = 2 * (rng() % 10); n > 0; n--) {
+            positions[p].pile.addCard(deck.drawCard());
+        }
+    }
+    return;
+}
+
+static void runAll(Bench &bench) {
+    const std::vector<Position> &pos = bench.positions;
+    std::vector<int> matches;
+    std::mt19937 rng(1);
+    DeckType deck;
+    Hand hand;
+
+    bench.run("CardType::cardName", 1, [&](long i) {
+        sink = sink + CardType::fromId(i % NUMCARDS).cardName().length();
+    });
+    bench.run("Hand::addCard", 8, [&](long i) {          // builds a hand of 8 cards, one at a time
+        hand.destroy();
+        for (int c = 0; c < 8; c++) {
+            hand.addCard(CardType::fromId((i * 7 + c * 13) % NUMCARDS));
+        }
+    });
+    bench.run("Hand::playCard", 8, [&](long i) {         // plays out a hand of 8 cards (the time to build it is subtracted below)
+        hand.destroy();
+        for (int c = 0; c < 8; c++) {
+            hand.addCard(CardType::fromId((i * 7 + c * 13) % NUMCARDS));
+        }
+        for (int c = 7; c >= 0; c--) {
+            sink = sink + hand.playCard(i % (c + 1)).getMonth();
+        }
+    });
+    bench.run("Hand::numOfThisMonth", 1, [&](long i) {
+        sink = sink + pos[i % POSITIONS].table.numOfThisMonth(static_cast<MonthType>(JAN + i % 12));
+    });
+    bench.run("DeckType::shuffle()", 1, [&](long) {
+        deck.shuffle();
+    });
+    bench.run("DeckType::shuffle(rng)", 1, [&](long) {
+        deck.shuffle(rng);
+    });
+    bench.run("findMatches", 1, [&](long i) {
+        sink = sink + findMatches(CardType::fromId(i % NUMCARDS), pos[i % POSITIONS].table, matches);
+    });
+    bench.run("noCardsToPlay", 1, [&](long i) {
+        sink = sink + noCardsToPlay(pos[i % POSITIONS].hand, pos[i % POSITIONS].table);
+    });
+    bench.run("ScorePile::rawScore", 1, [&](long i) {
+        sink = sink + pos[i % POSITIONS].pile.rawScore();
+    });
+    bench.run("ScorePile::finalScore", 1, [&](long i) {
+        sink = sink + pos[i % POSITIONS].pile.finalScore(i & 1);
+    });
+
+    // Hand::playCard was timed along with building the hand, so take that time (and those allocations) back out
+    BenchResult *add = NULL, *play = NULL;
+    for (size_t r = 0; r < bench.results.size(); r++) {
+        if (bench.results[r].name == "Hand::addCard")  { add  = &bench.results[r]; }
+        if (bench.results[r].name == "Hand::playCard") { play = &bench.results[r]; }
+    }
+    if (add != NULL && play != NULL) {
+        play->nsPerOp     -= add->nsPerOp;
+        play->allocsPerOp -= add->allocsPerOp;
+    }
+    return;
+}
+
+/* =====================================
+BASELINE
+A baseline file has one line per benchmark: its name, ns/op, and allocations/op.
+===================================== */
+
+static std::map<std::string, BenchResult> readBaseline(const char *filename) {
+    std::map<std::string, BenchResult> baseline;
+    FILE *file = fopen(filename, "r");
+    char name[256];
+    BenchResult result;
+
+    if (file == NULL) {
+        return baseline;
+    }
+    while (fscanf(file, "%255s %lf %lf", name, &result.nsPerOp, &result.allocsPerOp) == 3) {
+        result.name = name;
+        baseline[result.name] = result;
+    }
+    fclose(file);
+    return baseline;
+}
+
+static bool writeBaseline(const char *filename, const std::vector<BenchResult> &results) {
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) {
+        return false;
+    }
+    for (size_t r = 0; r < results.size(); r++) {
+        fprintf(file, "%s %.2f %.3f\n", results[r].name.c_str(), results[r].nsPerOp, results[r].allocsPerOp);
+    }
+    fclose(file);
+    return true;
+}
+
+// prints how to run the benchmarks, then exits
+static void usage(const char *progname) {
+    fprintf(stderr, "usage: %s [-b baseline] [-w] [-t seconds] [-f filter]\n", progname);
+    fprintf(stderr, "   -b  baseline file to compare against (default bench-baseline.txt)\n");
+    fprintf(stderr, "   -w  write the results to the baseline file, instead of comparing against it\n");
+    fprintf(stderr, "   -t  minimum time to spend on each benchmark, in seconds (default 0.2)\n");
+    fprintf(stderr, "   -f  only run the benchmarks whose names contain this\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    Bench bench;
+    const char *baselineFile = "bench-baseline.txt";
+    bool write = false;
+    int opt;
+
+    bench.seconds = 0.2;
+    bench.filter  = NULL;
+    while ((opt = getopt(argc, argv, "b:wt:f:")) != -1) {
+        switch (opt) {
+            case 'b': baselineFile  = optarg;        break;
+            case 'w': write         = true;          break;
+            case 't': bench.seconds = atof(optarg);  break;
+            case 'f': bench.filter  = optarg;        break;
+            default:  usage(argv[0]);
+        }
+    }
+
+    makePositions(bench.positions);
+    runAll(bench);
+
+    std::map<std::string, BenchResult> baseline = readBaseline(baselineFile);
+    printf("%-26s %10s %10s   %14s %8s\n", "benchmark", "ns/op", "allocs/op", "baseline ns/op", "change");
+    for (size_t r = 0; r < bench.results.size(); r++) {
+        const BenchResult &result = bench.results[r];
+        printf("%-26s %10.2f %10.3f", result.name.c_str(), result.nsPerOp, result.allocsPerOp);
+        if (!write && baseline.count(result.name) > 0) {
+            const BenchResult &base = baseline[result.name];
+            printf("   %14.2f %+7.1f%%", base.nsPerOp, 100.0 * (result.nsPerOp - base.nsPerOp) / base.nsPerOp);
+            if (result.allocsPerOp > base.allocsPerOp + 0.001) {
+                printf("  (was %.3f allocs/op)", base.allocsPerOp);
+            }
+        }
+        printf("\n");
+    }
+
+    if (write) {
+        if (!writeBaseline(baselineFile, bench.results)) {
+            fprintf(stderr, "%s: cannot write %s\n", argv[0], baselineFile);
+            return 1;
+        }
+        printf("\nwrote baseline to %s\n", baselineFile);
+    } else if (baseline.empty()) {
+        printf("\nno baseline in %s (run with -w to save one)\n", baselineFile);
+    }
+    return 0;
+}
@@ -2,12 +2,23 @@
 extern "C" {
 #include "csapp.h"
 }
+#include <csignal>
+#include "hanafuda-card.hpp"
+#include "koikoi-wire.hpp"
 #define QUITCHOICE 99
+#define LOSTCHOICE -1       // SendLineRIO()'s answer when the connection is gone
+#define RECONNECTFOR 300    // seconds to keep trying to get back to the server after losing the connection
 
 // send message to server
 int SendLineRIO(int fd);
 // read message from server
-void ReadLineRIO(rio_t *r);
+bool ReadLineRIO(rio_t *r, bool quiet = false);
+// connect to the server again after losing the connection, and ask for the game back
+int Reconnect(char *host, char *port, rio_t *r, int handshake = 0);
+// play over the binary protocol instead, drawing the cards ourselves (-b)
+int PlayCompact(char *host, char *port);
+
+unsigned long long gameToken = 0;   // the token the server gave our game (0 until it has), for resuming it
 
 
 int main(int argc, char **argv) {
@@ -17,6 +28,18 @@ int main(int argc, char **argv) {
     rio_t rio;                //internal buffer for reading from network
     int currChoice = 0;       //current choice that we've input
     
+    // a connection that drops while we are writing to it should be reconnected, not kill the client
+    signal(SIGPIPE, SIG_IGN);
+    
+    if (argc < 3 || (argc > 3 && strcmp(argv[3], "-b") != 0)) {
+        fprintf(stderr, "usage: %s host port [-b]\n", argv[0]);
+        fprintf(stderr, "   -b  compact mode: the server sends card IDs, and the client draws the cards itself\n");
+        exit(1);
+    }
+    if (argc > 3) {
+        return PlayCompact(host, port);
+    }
+    
     //establish connection
     clientfd = Open_clientfd(host, port);
     
@@ -32,10 +55,16 @@ int main(int argc, char **argv) {
         ReadLineRIO() function re-interprets as a newline character. */
     
     while (currChoice != QUITCHOICE) { // keep going until we indicate to quit
-        // read message and/or instructions from server
-        ReadLineRIO(&rio);
+        // read message and/or instructions from server, and if the connection
+        // has been lost, get it back (which also gets the prompt again)
+        if (!ReadLineRIO(&rio)) {
+            Close(clientfd);
+            clientfd = Reconnect(host, port, &rio);
+            continue;
+        }
         // then send response to the server, grabbing an integer if we
         // typed one in, or 0 if we typed a non-number string.
+        // (the server is then asked again on the next read)
         currChoice = SendLineRIO(clientfd);
     }
     
@@ -66,10 +95,14 @@ int SendLineRIO(int fd) {
     bzero(write_buf, sizeof(write_buf));
     int choice=0;
     
-    // take text from Std Input
-    Fgets(write_buf, MAXLINE, stdin);
-    // send that text to the server
-    Rio_writen(fd, write_buf, strlen(write_buf));
+    // take text from Std Input (the end of it quits)
+    if (Fgets(write_buf, MAXLINE, stdin) == NULL) {
+        strcpy(write_buf, "99\n");
+    }
+    // send that text to the server (a failure shows up on the next read)
+    if (rio_writen(fd, write_buf, strlen(write_buf)) < 0) {
+        return LOSTCHOICE;
+    }
     // also convert it into an integer for our side's controls
     // (returns 0 if there's no valid integer at the start)
     sscanf(write_buf, "%i", &choice);
@@ -81,16 +114,28 @@ int SendLineRIO(int fd) {
    than one newline character, we've actually set up the server so that it sends
    non-final newlines as '\t', and it is in this function here that we reinterpret
    them as '\n'.
+   It also picks the game's token out of the server's messages, for Reconnect(),
+   and returns false if the connection has been lost (printing nothing if quiet).
 */
 
-void ReadLineRIO(rio_t *r) {
+bool ReadLineRIO(rio_t *r, bool quiet) {
     char read_buf[MAXLINE]  = {'\0'}; //buffer for communication from network
     int buflen;                       //length of non-junk text in the buffer
+    const char *resume;
     
     // get text line from the server
-    Rio_readlineb(r, read_buf, MAXLINE);
+    if (rio_readlineb(r, read_buf, MAXLINE) <= 0) {
+        return false;
+    }
     // and measure its length
     buflen = strlen(read_buf);
+    // (the server tells us the token as: enter "resume <token>")
+    if ((resume = strstr(read_buf, "enter \"resume ")) != NULL) {
+        sscanf(resume, "enter \"resume %llx", &gameToken);
+    }
+    if (quiet) {
+        return true;
+    }
     
     // change all '\t' in the received string to '\n'
     for (int i=0; i<buflen; i++) {  // for every character
@@ -101,5 +146,441 @@ void ReadLineRIO(rio_t *r) {
     
     // then print the resulting string client-side
     Fputs(read_buf, stdout);
-    return;
-}
\ No newline at end of file
+    return true;
+}
+
+/* Connects to the server again, waiting a little longer after each failure
+   (in case the network is still down), for up to RECONNECTFOR seconds.
+   If the game had a token, the server's first prompt (for our name) is
+   answered with "resume <token>" (after the handshake byte, if one is given),
+   so that the server puts us back into the game where we left off; otherwise
+   we start over with that prompt.
+*/
+
+int Reconnect(char *host, char *port, rio_t *r, int handshake) {
+    char write_buf[MAXLINE];
+    int fd, wait = 1, waited = 0;
+    
+    fprintf(stderr, "\n(Lost the connection to the server. Reconnecting...)\n");
+    while ((fd = open_clientfd(host, port)) < 0) {
+        if (waited >= RECONNECTFOR) {
+            fprintf(stderr, "Could not get back to the server.\n");
+            exit(1);
+        }
+        sleep(wait);
+        waited += wait;
+        wait = (wait < 8) ? wait * 2 : 8;
+    }
+    Rio_readinitb(r, fd);
+    if (gameToken != 0 && ReadLineRIO(r, true)) {
+        char prefix[2] = {static_cast<char>(handshake), '\0'};      // (empty if there is none)
+        snprintf(write_buf, sizeof(write_buf), "%sresume %016llx\n", prefix, gameToken);
+        rio_writen(fd, write_buf, strlen(write_buf));
+    }
+    return fd;
+}
+// ===================================================
+// COMPACT MODE
+// ===================================================
+
+/*  With -b, the client asks for the binary protocol (and for only what has
+    changed in the listings), so the server sends card IDs and sets of them
+    rather than lines of card names. The client keeps its own copy of the
+    table, the hands and the score piles, and draws them from that, naming
+    each card itself. Prompts come with their choices, so an answer that
+    isn't one is turned down right here, without a trip to the server; and
+    entering "?" at any prompt draws the table, hand & score piles again.
+*/
+
+// everything the server has shown us of the round, as sets of card IDs
+struct LocalView {
+    CardMask    table;
+    CardMask    hand[2];
+    CardMask    pile[2];
+    int         raw[2];
+    int         final[2];
+    std::string options[64];        // the choices of opponent, as numbered by the server
+    bool        player;             // whether the opponent is another player, rather than the CPU
+};
+
+// how the opponent is referred to: {seat 0's owner, seat 1's owner, subject, its}, for the CPU & for another player
+static const char *cpuWords[4]    = {"your", "the CPU's", "The CPU", "its"};
+static const char *playerWords[4] = {"your", "your opponent's", "Your opponent", "their"};
+
+static const char *const *Words(const LocalView &view) {
+    return view.player ? playerWords : cpuWords;
+}
+
+// the i-th card of a set (in ID order)
+static int NthCard(CardMask cards, int i) {
+    for (; i > 0; i--) {
+        cards &= cards - 1;
+    }
+    return (cards == 0) ? -1 : __builtin_ctzll(cards);
+}
+
+static std::string CardName(int id) {
+    return CardType::fromId(id).cardName();
+}
+
+// prints a set of cards as a numbered list (only the ones in marked, if it isn't 0)
+static void ShowCards(CardMask cards, CardMask marked = 0) {
+    int i = 0;
+    for (CardMask rest = cards; rest != 0; rest &= rest - 1, i++) {
+        int id = __builtin_ctzll(rest);
+        if (marked == 0 || ((marked >> id) & 1) != 0) {
+            printf(" (%d)  %s\n", i, CardName(id).c_str());
+        }
+    }
+}
+
+static void ShowTable(const LocalView &view) {
+    printf("These are the cards on the table:\n");
+    ShowCards(view.table);
+    printf("\n");
+}
+
+static void ShowHand(const LocalView &view, int seat) {
+    printf("These are the cards in %s hand:\n", Words(view)[seat]);
+    ShowCards(view.hand[seat]);
+    printf("\n");
+}
+
+static void ShowPile(const LocalView &view, int seat) {
+    printf("These are the cards in %s score pile:\n", Words(view)[seat]);
+    ShowCards(view.pile[seat]);
+    printf("Raw points in %s score pile: %d\n", Words(view)[seat], view.raw[seat]);
+    printf("With bonuses, this would be scored as %d points.\n\n", view.final[seat]);
+}
+
+// applies a WIRE_HAND, WIRE_TABLE, WIRE_PILE or WIRE_DELTA to the view, then draws what it changed
+static void ApplyListing(LocalView &view, const unsigned char *frame) {
+    const unsigned char *payload = frame + WIREHEADER;
+    int type = frame[0], seat = 0;
+    CardMask *cards;
+
+    if (type == WIRE_DELTA) {
+        type = payload[0];
+        seat = payload[1] & 1;
+    } else if (type != WIRE_TABLE) {
+        seat = payload[0] & 1;
+    }
+    cards = (type == WIRE_TABLE) ? &view.table : ((type == WIRE_HAND) ? &view.hand[seat] : &view.pile[seat]);
+
+    if (frame[0] == WIRE_DELTA) {
+        for (int i = 4; i < frame[1]; i++) {
+            CardMask card = 1ULL << (payload[i] & ~WIREREMOVED);
+            *cards = ((payload[i] & WIREREMOVED) != 0) ? (*cards & ~card) : (*cards | card);
+        }
+        if (type == WIRE_PILE) {
+            view.raw[seat]   = payload[2];
+            view.final[seat] = payload[3];
+        }
+    } else if (type == WIRE_TABLE) {
+        *cards = wireU64(payload);
+    } else {
+        *cards = wireU64(payload + 1);
+        if (type == WIRE_PILE) {
+            view.raw[seat]   = payload[9];
+            view.final[seat] = payload[10];
+        }
+    }
+
+    if (type == WIRE_TABLE) {
+        ShowTable(view);
+    } else if (type == WIRE_HAND) {
+        ShowHand(view, seat);
+    } else {
+        ShowPile(view, seat);
+    }
+}
+
+// prints a card played from a hand (WIRE_PLAY) or drawn from the deck (WIRE_DRAW)
+static void ShowTurn(const LocalView &view, const unsigned char *frame) {
+    const unsigned char *payload = frame + WIREHEADER;
+    const char *const *them = Words(view);
+    bool mine = (payload[0] == 0);
+    std::string from = (frame[0] == WIRE_DRAW) ? "the deck" : (mine ? "your hand" : std::string(them[3]) + " hand");
+
+    printf("%s %s this card from %s: %s\n", mine ? "You" : them[2], mine ? "reveal" : "reveals", from.c_str(), CardName(payload[1]).c_str());
+    if (payload[2] == WIRENOCARD) {
+        printf("It can't be matched with any card on the table, so it is added to the table.\n\n");
+    } else {
+        printf("It is matched with this card on the table: %s\n", CardName(payload[2]).c_str());
+        printf("Both cards are put in %s score pile.\n\n", Words(view)[payload[0] & 1]);
+    }
+}
+
+// prints any frame but a prompt
+static void ShowFrame(LocalView &view, const unsigned char *frame) {
+    const unsigned char *payload = frame + WIREHEADER;
+    const char *const *them = Words(view);
+
+    switch (frame[0]) {
+        case WIRE_TOKEN:
+            gameToken = wireU64(payload);
+            printf("Your game's token is %016llx. If you are cut off, the client will take you back to the game.\n\n", gameToken);
+            break;
+        case WIRE_RESUMED:
+            printf("Your game has been resumed where it left off.\n\n");
+            break;
+        case WIRE_OPTION:
+            view.options[payload[0] & 63].assign(reinterpret_cast<const char*>(payload + 1), frame[1] - 1);
+            break;
+        case WIRE_ROUND:
+            printf("-----------------------------------------------\n");
+            printf("                BEGIN ROUND %d\n", payload[0]);
+            printf("-----------------------------------------------\n");
+            view.table = view.hand[0] = view.hand[1] = view.pile[0] = view.pile[1] = 0;
+            view.raw[0] = view.raw[1] = view.final[0] = view.final[1] = 0;
+            break;
+        case WIRE_DEALER:
+            printf("%s the dealer for this round.\n\n", (payload[0] == 0) ? "You are" : (std::string(them[2]) + " is").c_str());
+            break;
+        case WIRE_INSTANTWIN:
+            printf("%s dealt %s--an instant-win combo!\n", (payload[0] == 0) ? "You were" : ((payload[0] == 1) ? (std::string(them[2]) + " was").c_str() : "The table was"),
+                   (payload[1] != 0) ? "four of a kind" : "four pairs of matching cards");
+            printf("%s\n\n", (payload[0] == 2) ? "This deal is null and void, and the round will be re-dealt." : "This round is over.");
+            break;
+        case WIRE_HAND:
+        case WIRE_TABLE:
+        case WIRE_PILE:
+        case WIRE_DELTA:
+            ApplyListing(view, frame);
+            break;
+        case WIRE_PLAY:
+        case WIRE_DRAW:
+            ShowTurn(view, frame);
+            break;
+        case WIRE_KOIKOI:
+            if (payload[0] == 0) {
+                printf("%s\n\n", (payload[1] != 0) ? "You say: \"Koi-Koi!\"" : "You choose to end the round.");
+            } else {
+                printf("%s has collected a combo in %s score pile, and can end this round or call Koi-Koi.\n", them[2], them[3]);
+                printf("%s's choice is: %s\n\n", them[2], (payload[1] != 0) ? "Koi-Koi!" : "End the round.");
+            }
+            break;
+        case WIRE_POINTS:
+            if (payload[0] == WIRENOCARD) {
+                printf("This round has ended without any player scoring points!\nProceeding to next round...\n\n");
+            } else if (payload[0] == 0) {
+                printf("You cash in your score pile and receive %d points.\n\n", payload[1]);
+            } else {
+                printf("%s cashes in %s score pile and receives %d points.\n\n", them[2], them[3], payload[1]);
+            }
+            break;
+        case WIRE_STANDINGS:
+            printf("---CURRENT STANDINGS---\nYour Score:  %u\n%s: %u\n\n", wireU16(payload), view.player ? "Opponent's Score" : "CPU's Score",
+                   wireU16(payload + 2));
+            break;
+        case WIRE_FINAL: {
+            unsigned int you = wireU16(payload), cpu = wireU16(payload + 2), rounds = payload[4];
+            gameToken = 0;          // (the game is over: there is nothing to go back to)
+            printf("-----------------------------------------------------\nFINAL RESULTS:\n\n");
+            printf("Total # of Rounds:  %u\n", rounds);
+            printf("Your Total Points:  %u, average of %.2f points per round\n", you, static_cast<double>(you) / rounds);
+            printf("%s Total Points: %u, average of %.2f points per round\n", view.player ? "Opponent's" : "CPU's", cpu, static_cast<double>(cpu) / rounds);
+            if (you < cpu) {
+                printf("\n%s wins. Better luck next time!\n\n", them[2]);
+            } else {
+                printf("\n%s\n\n", (you > cpu) ? "You are the winner! Congratulations!" : "It's a tie! How rare!");
+            }
+            break;
+        }
+        case WIRE_LEADERS:
+            printf("---LEADERBOARD--- (%u players)\n", wireU32(payload));
+            printf("      Player                    Wins  Games   Points/Round\n");
+            break;
+        case WIRE_LEADER:
+            printf(" %3u  %-24.*s %5u  %5u   %8.3f\n", wireU32(payload), frame[1] - 16, reinterpret_cast<const char*>(payload + 16),
+                   wireU32(payload + 4), wireU32(payload + 8), wireU32(payload + 12) / 1000.0);
+            break;
+        case WIRE_REJECT:
+            printf("The server turned that answer down.\n");
+            break;
+        case WIRE_OPPONENT:
+            view.player = (view.options[payload[0] & 63] == "Arena");
+            if (!view.player) {
+                printf("You are playing against the %.*s CPU.\n\n", frame[1] - 1, reinterpret_cast<const char*>(payload + 1));
+            } else if (frame[1] == 1) {
+                printf("You are playing against another player, who is unranked.\n\n");
+            } else {
+                printf("You are playing against another player: %.*s.\n\n", frame[1] - 1, reinterpret_cast<const char*>(payload + 1));
+            }
+            break;
+        case WIRE_ABANDONED:
+            printf("Your opponent's connection was lost, so the game is over. It will not be scored.\n\n");
+            break;
+        case WIRE_WATCHING:
+            if (payload[0] == 0) {
+                printf("No featured game is being played right now.\n\n");
+            } else if (frame[1] == 2) {
+                printf("You are watching featured game %d (of %d rounds) from an unranked player's seat.\n", payload[0], payload[1]);
+                printf("Below, \"you\" means that player. The game is shown from the start of the next round.\n\n");
+            } else {
+                printf("You are watching featured game %d (of %d rounds) from %.*s's seat.\n", payload[0], payload[1],
+                       frame[1] - 2, reinterpret_cast<const char*>(payload + 2));
+                printf("Below, \"you\" means that player. The game is shown from the start of the next round.\n\n");
+            }
+            break;
+        default:                    // (WIRE_HELLO, and anything newer than this client)
+            break;
+    }
+}
+
+// prints the prompt's question, and the choices it needs listing
+static void ShowPrompt(const LocalView &view, int prompt, int card, CardMask choices) {
+    switch (prompt) {
+        case WIREPROMPT_NAME:
+            printf("Enter a name for the leaderboard (or leave it blank to play unranked):\n");
+            break;
+        case WIREPROMPT_ROUNDS:
+            printf("How many rounds of koi-koi would you like to play?\nEnter a number 1-12:\n");
+            break;
+        case WIREPROMPT_STRATEGY:
+            printf("Which opponent would you like to play against?\n");
+            for (CardMask rest = choices; rest != 0; rest &= rest - 1) {
+                printf(" [%d]  %s\n", __builtin_ctzll(rest), view.options[__builtin_ctzll(rest)].c_str());
+            }
+            printf("Enter the number of the opponent:\n");
+            break;
+        case WIREPROMPT_PLAY:
+            printf("Which card from your hand would you like to use for matching?\nEnter the index of the card:\n");
+            break;
+        case WIREPROMPT_MATCH:
+            printf("These are the cards on the table that you can match:\n");
+            ShowCards(view.table, choices);
+            printf("You are matching the card: %s\n", CardName(card).c_str());
+            printf("Which card from the table would you like to match with that card?\nEnter the index of the table card:\n");
+            break;
+        case WIREPROMPT_GIVEUP:
+            printf("You cannot match any card from your hand with any card on the table,\n");
+            printf("so instead, you must choose a card to give up to the table.\n");
+            printf("Which card do you choose to give up? Enter the index of the card:\n");
+            break;
+        case WIREPROMPT_KOIKOI:
+            printf("You have made a new combo in your score pile! If you end the round now, you will score %d points.\n", view.final[0]);
+            printf("Calling \"Koi-Koi\" will continue the game so you can try to get more combos, but if %s\n", view.player ? "your opponent" : "the CPU");
+            printf("ends the round after this, you will score 0 points.\n");
+            printf("Please enter [1] to call Koi-Koi, or [2] to end the round:\n");
+            break;
+        case WIREPROMPT_AFTER:
+            printf("Enter 1 to see the leaderboard, 2 to quit, or 3 to play again.\n");
+            break;
+    }
+}
+
+/*  Asks the player for an answer to the prompt until they give one that is
+    among its choices, and returns it: a number, or for a card prompt, the ID
+    of the card at the index they entered (in the hand, or on the table).
+    Returns -1 if standard input has ended.
+*/
+static int AskChoice(const LocalView &view, int prompt, CardMask choices) {
+    char line[MAXLINE];
+    bool onTable = (prompt == WIREPROMPT_MATCH);
+    bool isCard  = onTable || prompt == WIREPROMPT_PLAY || prompt == WIREPROMPT_GIVEUP;
+
+    while (true) {
+        if (Fgets(line, sizeof(line), stdin) == NULL) {
+            return -1;
+        }
+        if (line[0] == '?') {       // draw everything again, from our own copy
+            ShowTable(view);
+            ShowHand(view, 0);
+            ShowPile(view, 0);
+            ShowPile(view, 1);
+            ShowPrompt(view, prompt, NthCard(choices, 0), choices);
+            continue;
+        }
+        char *end;
+        long number = strtol(line, &end, 10);
+        if (end == line) {
+            printf("That is not a valid number. Please enter a digit.\n");
+            continue;
+        }
+        int answer = (number < 0 || number >= 64) ? -1 : (isCard ? NthCard(onTable ? view.table : view.hand[0], number) : number);
+        if (answer >= 0 && ((choices >> answer) & 1) != 0) {
+            return answer;
+        }
+        printf("That is not one of the choices. Please try again.\n");
+    }
+}
+
+// sends an answer (a number, or a card ID) to the server
+static bool SendAnswer(int fd, int value) {
+    unsigned char answer[WIREHEADER + 1] = {WIRE_ANSWER, 1, static_cast<unsigned char>(value)};
+    return rio_writen(fd, answer, sizeof(answer)) == sizeof(answer);
+}
+
+/*  Plays in compact mode. The server's first line (the prompt for our name)
+    is still text: the name goes back with the handshake byte in front of it,
+    and everything after that is frames. If the connection is lost, we
+    reconnect and resume the game, as in text mode.
+*/
+int PlayCompact(char *host, char *port) {
+    const int handshake = WIREHELLO | WIREDELTAS;
+    unsigned char frame[WIREMAXFRAME];
+    char line[MAXLINE];
+    LocalView view = LocalView();
+    bool quitting = false;
+    rio_t rio;
+
+    int fd = Open_clientfd(host, port);
+    Rio_readinitb(&rio, fd);
+    if (!ReadLineRIO(&rio)) {
+        fprintf(stderr, "The server hung up.\n");
+        exit(1);
+    }
+    line[0] = handshake;
+    if (Fgets(line + 1, sizeof(line) - 1, stdin) == NULL) {
+        strcpy(line + 1, "\n");
+    }
+    rio_writen(fd, line, strlen(line));
+
+    while (true) {
+        if (rio_readnb(&rio, frame, WIREHEADER) != WIREHEADER || rio_readnb(&rio, frame + WIREHEADER, frame[1]) != frame[1]) {
+            Close(fd);
+            if (quitting) {
+                return 0;
+            }
+            fd = Reconnect(host, port, &rio, handshake);
+            if (gameToken == 0) {       // (no game to go back to: start over)
+                ReadLineRIO(&rio);
+                line[0] = handshake;
+                if (Fgets(line + 1, sizeof(line) - 1, stdin) == NULL) {
+                    strcpy(line + 1, "\n");
+                }
+                rio_writen(fd, line, strlen(line));
+            }
+            continue;
+        }
+        if (frame[0] != WIRE_PROMPT) {
+            ShowFrame(view, frame);
+            continue;
+        }
+
+        const unsigned char *payload = frame + WIREHEADER;
+        int prompt = payload[0];
+        CardMask choices = wireU64(payload + 2);
+        ShowPrompt(view, prompt, payload[1], choices);
+        fflush(stdout);
+        if (prompt == WIREPROMPT_NAME) {
+            unsigned char answer[WIREHEADER + 255] = {WIRE_ANSWER, 0};
+            if (Fgets(line, sizeof(line), stdin) == NULL) {
+                line[0] = '\0';
+            }
+            line[strcspn(line, "\r\n")] = '\0';
+            answer[1] = (strlen(line) < 255) ? strlen(line) : 255;
+            memcpy(answer + WIREHEADER, line, answer[1]);
+            rio_writen(fd, answer, WIREHEADER + answer[1]);
+            continue;
+        }
+        int answer = AskChoice(view, prompt, choices);
+        if (answer < 0) {           // (standard input has ended: quit, and leave the game for resuming)
+            Close(fd);
+            return 0;
+        }
+        quitting = (prompt == WIREPROMPT_AFTER && answer == 2);
+        SendAnswer(fd, answer);     // (a failure shows up on the next read)
+    }
+}
@@ -1,6 +1,8 @@
 #include "hanafuda-card.hpp"
 #include <string>
 #include <iostream>
+#include <cassert>			//to force crash for debugging
+#include <cstdio>
 #define CARDNAMELENGTH 50
 
 /*  ========================================
@@ -398,4 +400,73 @@ std::string CardType::cardName() const {
 		}
 	}
 	return cardname;	
+}
+
+// every card's name is made once, the first time any of them is asked for, and kept for as long as the program runs
+const char *CardType::cardNameText() const {
+	static const struct CardNames {
+		char	name[NUMCARDS][CARDNAMELENGTH];
+
+		CardNames() {
+			for (int id = 0; id < NUMCARDS; id++) {
+				snprintf(name[id], CARDNAMELENGTH, "%s", fromId(id).cardName().c_str());
+			}
+		}
+	} names;
+	return names.name[cardId()];
+}
+
+/*  ========================================
+CARD IDs
+========================================    */
+
+// every card in the deck, in ID order (month by month, and within a month by design)
+static const CardType ALLCARDS[NUMCARDS] = {
+	{JAN, LIGHT}, {JAN, RIBBON}, {JAN, CHAFF},  {JAN, CHAFF},
+	{FEB, SEED},  {FEB, RIBBON}, {FEB, CHAFF},  {FEB, CHAFF},
+	{MAR, LIGHT}, {MAR, RIBBON}, {MAR, CHAFF},  {MAR, CHAFF},
+	{APR, SEED},  {APR, RIBBON}, {APR, CHAFF},  {APR, CHAFF},
+	{MAY, SEED},  {MAY, RIBBON}, {MAY, CHAFF},  {MAY, CHAFF},
+	{JUN, SEED},  {JUN, RIBBON}, {JUN, CHAFF},  {JUN, CHAFF},
+	{JUL, SEED},  {JUL, RIBBON}, {JUL, CHAFF},  {JUL, CHAFF},
+	{AUG, LIGHT}, {AUG, SEED},   {AUG, CHAFF},  {AUG, CHAFF},
+	{SEP, SEED},  {SEP, RIBBON}, {SEP, CHAFF},  {SEP, CHAFF},
+	{OCT, SEED},  {OCT, RIBBON}, {OCT, CHAFF},  {OCT, CHAFF},
+	{NOV, LIGHT}, {NOV, SEED},   {NOV, RIBBON}, {NOV, CHAFF},
+	{DEC, LIGHT}, {DEC, CHAFF},  {DEC, CHAFF},  {DEC, CHAFF}
+};
+
+// each month has 4 IDs, and its designs come in LIGHT < SEED < RIBBON < CHAFF order, so the ID is the month's first ID
+// plus the number of that month's cards that sort before this one
+int CardType::cardId() const {
+	int id = (static_cast<int>(month) - JAN) * 4;		// first ID of the month
+	while (ALLCARDS[id].design < design) {				// (designs of a month are in increasing order)
+		id++;
+	}
+	return id;
+}
+
+// plain chaff fill the end of their month, so every ID from cardId() to the end of the month is the same card
+int CardType::cardIdCount() const {
+	if (design != CHAFF) {
+		return 1;
+	}
+	return (static_cast<int>(month) - JAN) * 4 + 4 - cardId();
+}
+
+CardType CardType::fromId(int id) {
+	if (id < 0 || id >= NUMCARDS) {
+		assert(false);
+	}
+	return ALLCARDS[id];
+}
+
+CardMask CardType::maskOf(bool (CardType::*predicate)() const) {
+	CardMask mask = 0;
+	for (int id = 0; id < NUMCARDS; id++) {
+		if ((ALLCARDS[id].*predicate)()) {
+			mask |= (1ULL << id);
+		}
+	}
+	return mask;
 }
\ No newline at end of file
@@ -18,6 +18,10 @@ enum MonthType {	// "suit" of the cards: there will be 4 of each month in a full
 	DEC		=12			// light, chaff, chaff, chaff		(NB: the "special" December chaff is not implemented, as it is not special in Koi-Koi, nor in the vast majority of Hanafuda games)
 };
 
+#define NUMCARDS 48		// # of cards in a full deck
+
+typedef unsigned long long CardMask;	// a set of cards, as one bit per card ID (see CardType::cardId())
+
 enum DesignType {	// "design" of the cards -- their inner values are set so that they can never overlap with the above MonthType constants.
 	LIGHT	=100,		// 5 count
 	SEED	=101,		// 9 count
@@ -176,11 +180,23 @@ public:
 		return (month == m && design == d);
 	}
 	
+	/*  ========================================
+	CARD IDs
+	Every card in the deck has an ID from 0 to 47, in the same order as operator< (and as DeckType::initialize()).
+	The two or three plain chaff of a month are identical, so cardId() always gives the first of their IDs;
+	Hand keeps its set of IDs canonical by filling a month's chaff IDs from the first one up.
+	========================================    */
+	int cardId() const;										// 0-47 (the first ID of this month & design)
+	int cardIdCount() const;								// # of consecutive IDs starting at cardId() that are the same card (1, or 2-3 for chaff)
+	static CardType fromId(int id);							// the card with the given ID (WARNING: will purposefully crash if given an invalid ID!)
+	static CardMask maskOf(bool (CardType::*predicate)() const);	// the set of all card IDs for which the given is*() function is true, e.g. maskOf(&CardType::isLight)
+
 	/*  ========================================
 	NAME-CREATING FUNCTIONS
 	========================================    */
 
 	std::string cardName() const;			//
+	const char *cardNameText() const;		// the same, without making a string (each name is made once, and kept)
 	std::string cardMonthName() const;		// "January", "February", etc.
 	std::string cardFlowerName() const;		// "Pine", "Plum", "Cherry", etc.
 	std::string cardDesignName() const;		// "Crane & Sun", "Bush Warbler", "Blue Ribbon", "Chaff"
@@ -1,5 +1,6 @@
 #include "hanafuda-deck.hpp"
 #include <vector>
+#include <utility>	//std::swap()
 #include <cstdlib>	//rand(), srand()
 #include <ctime>	//time(), to seed srand()
 
@@ -9,6 +10,7 @@ Initailizes a deck of all 48 cards. Deck will not be shuffled!
 ========================================    */
 
 DeckType::DeckType() {
+	cards.reserve(NUMCARDS);			// so that returnCard() never has to allocate either
 	initialize();						// each new deck should begin with the full 48 cards
 	return;
 }
@@ -136,6 +138,12 @@ CardType DeckType::drawCard() {
 	return topcard;
 }
 
+// puts a card back on top of the deck, so that it will be the next card drawn
+void DeckType::returnCard(CardType card) {
+	cards.push_back(card);
+	return;
+}
+
 // randomizes the order of the cards in the deck
 void DeckType::shuffle() {
 	int size = cards.size();
@@ -155,4 +163,27 @@ void DeckType::shuffle() {
 
 	// the deck should now be sufficiently randomized
 	return;
+}
+
+// a number from 0 to bound-1, each as likely as the others: a draw from rng (32 bits) that falls in the short run at the
+// top that would make the low numbers likelier is turned down, and another one drawn
+static unsigned int boundedDraw(std::mt19937 &rng, unsigned int bound) {
+	const unsigned long long limit = (1ULL << 32) - (1ULL << 32) % bound;		// (the largest multiple of bound that fits)
+	unsigned long long draw;
+	do {
+		draw = rng();
+	} while (draw >= limit);
+	return draw % bound;
+}
+
+// randomizes the order of the cards in the deck, drawing randomness only from the given generator
+// (so that the same seed always gives the same deal, and different threads never share a generator)
+// The algorithm is spelled out rather than left to std::shuffle(), whose draws differ between standard libraries: game
+// records and checkpoints replay deals from their seeds, so this is part of their format (see "koikoi-record.hpp")
+void DeckType::shuffle(std::mt19937 &rng) {
+	// Fisher-Yates: from the last card down to the second, swap each card with one at or below it
+	for (int i = static_cast<int>(cards.size()) - 1; i > 0; i--) {
+		std::swap(cards[i], cards[boundedDraw(rng, i + 1)]);
+	}
+	return;
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include "hanafuda-card.hpp"
 #include <vector>
+#include <random>
 
 class DeckType {
 protected:
@@ -34,7 +35,9 @@ public:
 	MUTATING FUNCTIONS
 	========================================    */
 	CardType drawCard();			// pops a card and returns it
+	void returnCard(CardType card);	// puts a card back on top of the deck (undoes drawCard())
 	void shuffle();					// randomizes the order of the cards in the deck
+	void shuffle(std::mt19937 &rng);	// randomizes the order of the cards in the deck, using (and advancing) the given generator
 };
 
 #endif
\ No newline at end of file
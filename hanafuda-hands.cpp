@@ -13,6 +13,8 @@ CONSTRUCTOR & DESTRUCTOR
 ===================================== */
 Hand::Hand() {
 	cards.clear();
+	cards.reserve(NUMCARDS);		// room for the whole deck up front, so that adding a card never has to allocate
+	mask = 0;
 	return;
 }
 Hand::~Hand() {
@@ -25,6 +27,7 @@ INITIALIZER
 ========================================    */
 void Hand::destroy() {
 	cards.clear();                  //erase all cards in the hand
+	mask = 0;
 	return;
 }
 
@@ -209,8 +212,13 @@ void Hand::sortCards() {
 
 // adds a copy of the card given; also re-sorts the hand
 void Hand::addCard(CardType newCard) {
+	int id = newCard.cardId();
 	cards.push_back(newCard);                   // should use copy constructor, if I'm reading the C++ <vector> documentation right
 	sortCards();
+	while (mask & (1ULL << id)) {               // identical chaff take the first of their IDs that is still free
+		id++;
+	}
+	mask |= (1ULL << id);
 	return;
 }
 
@@ -218,6 +226,11 @@ void Hand::addCard(CardType newCard) {
 CardType Hand::playCard(int index) {
 	CardType playedCard = cards[index];         // copy constructor
 	cards.erase(cards.begin()+index);           // erase the index-th element from the hand
+	int id = playedCard.cardId() + playedCard.cardIdCount() - 1;
+	while (!(mask & (1ULL << id))) {            // identical chaff give back the last of their IDs that is taken
+		id--;
+	}
+	mask &= ~(1ULL << id);
 	//sortCards();                              // unnecessary, since all unplayed cards will still be in order
 	return playedCard;
 }
@@ -366,3 +379,48 @@ int ScorePile::totalChaffScore() const {
 		return 0;               // 0 points for less than 10.
 	}
 }
+
+/* =====================================
+ALL COMBINATIONS
+===================================== */
+
+// sets the bit of every combo that scores
+unsigned int ScorePile::comboMask() const {
+	unsigned int combos = 0;
+	switch (totalLightScore()) {
+		case 6:  combos |= 1 << COMBO_THREE_LIGHTS;      break;
+		case 7:  combos |= 1 << COMBO_RAINY_FOUR_LIGHTS; break;
+		case 8:  combos |= 1 << COMBO_DRY_FOUR_LIGHTS;   break;
+		case 15: combos |= 1 << COMBO_FIVE_LIGHTS;       break;
+		default: break;
+	}
+	combos |= (sakuraViewing()      > 0) << COMBO_SAKURA_VIEWING;
+	combos |= (moonViewing()        > 0) << COMBO_MOON_VIEWING;
+	combos |= (inoshikacho()        > 0) << COMBO_INOSHIKACHO;
+	combos |= (totalSeedScore()     > 0) << COMBO_MANY_SEEDS;
+	combos |= (threePoetryRibbons() > 0) << COMBO_POETRY_RIBBONS;
+	combos |= (threeBlueRibbons()   > 0) << COMBO_BLUE_RIBBONS;
+	combos |= (totalRibbonScore()   > 0) << COMBO_MANY_RIBBONS;
+	combos |= (fourOfAKind()        > 0) << COMBO_FOUR_OF_A_KIND;
+	combos |= (totalChaffScore()    > 0) << COMBO_MANY_CHAFF;
+	return combos;
+}
+
+const char *comboName(ComboType combo) {
+	switch (combo) {
+		case COMBO_SAKURA_VIEWING:		return "Sakura Viewing";
+		case COMBO_MOON_VIEWING:		return "Moon Viewing";
+		case COMBO_THREE_LIGHTS:		return "Three Lights";
+		case COMBO_RAINY_FOUR_LIGHTS:	return "Rainy Four Lights";
+		case COMBO_DRY_FOUR_LIGHTS:		return "Dry Four Lights";
+		case COMBO_FIVE_LIGHTS:			return "Five Lights";
+		case COMBO_INOSHIKACHO:			return "Ino-Shika-Cho";
+		case COMBO_MANY_SEEDS:			return "Many Seeds";
+		case COMBO_POETRY_RIBBONS:		return "Poetry Ribbons";
+		case COMBO_BLUE_RIBBONS:		return "Blue Ribbons";
+		case COMBO_MANY_RIBBONS:		return "Many Ribbons";
+		case COMBO_FOUR_OF_A_KIND:		return "Four of a Kind";
+		case COMBO_MANY_CHAFF:			return "Many Chaff";
+		default:						return "[ERROR in comboName() in hanafuda-hands.cpp -- Invalid COMBO]";
+	}
+}
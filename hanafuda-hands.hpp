@@ -3,10 +3,12 @@
 
 #include <vector>
 #include "hanafuda-card.hpp"
+#include "trace.hpp"
 
 class Hand {
 protected:
 	std::vector<CardType> cards;	//contains the actual cards
+	CardMask mask;					//the same cards, as a set of card IDs (kept up to date by every mutating function)
 public:
 	/* =====================================
 	CONSTRUCTOR & DESTRUCTOR
@@ -33,6 +35,8 @@ public:
 	int findFirstIndex(MonthType m, DesignType d) const;	// returns the first index of the card that matches the input month & design, or -1 if not found
 	int findFirstMatch(MonthType m) const;					// returns the first index of the card that matches the input month, or -1 if not found
 
+	CardMask cardMask() const { return mask; }				// returns the set of card IDs in the hand (see CardType::cardId())
+
 	bool hasRainy() const;									// returns true if there is a rainy card present (Rain Man or Lightning), false otherwise
 	bool instantWin2222() const;							// returns true if the hand has the "instant win" condition: four pairs of cards of the same month
 	bool instantWin4() const;								// returns true if the hand has the "instant win" condition: four-of-a-kind of the same month
@@ -46,6 +50,25 @@ public:
 };
 
 
+enum ComboType {	// every combo a score pile can score with, as the bit # used by ScorePile::comboMask()
+	COMBO_SAKURA_VIEWING	=0,
+	COMBO_MOON_VIEWING		=1,
+	COMBO_THREE_LIGHTS		=2,
+	COMBO_RAINY_FOUR_LIGHTS	=3,
+	COMBO_DRY_FOUR_LIGHTS	=4,
+	COMBO_FIVE_LIGHTS		=5,
+	COMBO_INOSHIKACHO		=6,
+	COMBO_MANY_SEEDS		=7,
+	COMBO_POETRY_RIBBONS	=8,
+	COMBO_BLUE_RIBBONS		=9,
+	COMBO_MANY_RIBBONS		=10,
+	COMBO_FOUR_OF_A_KIND	=11,
+	COMBO_MANY_CHAFF		=12,
+	NUMCOMBOS					// (not a combo) number of combos
+};
+
+const char *comboName(ComboType combo);		// human-readable name of the combo, e.g. "Sakura Viewing"
+
 class ScorePile : public Hand {
 public:
 	/* =====================================
@@ -54,6 +77,7 @@ public:
 	===================================== */
 	// calculates raw # of points in the score pile, without any bonus multipliers
 	int rawScore() const {
+		TRACE_SCOPE("ScorePile::rawScore");
 		int score = 0;
 		score += sakuraViewing();
 		score += moonViewing();
@@ -77,6 +101,8 @@ public:
 		return score;
 	}
 
+	unsigned int comboMask() const;		// the set of combos the score pile scores with, as one bit per ComboType
+
 	/* =====================================
 	INDIVIDUAL SCORING FUNCTIONS
 	These will look at the contents of the score pile and return an integer corresponding to the score for that category.
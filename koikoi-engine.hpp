@@ -0,0 +1,247 @@
+#ifndef KOIKOI_ENGINE_H
+#define KOIKOI_ENGINE_H
+
+#include <vector>
+#include <random>
+#include "hanafuda-hands.hpp"
+#include "hanafuda-deck.hpp"
+#include "koikoi-rules.hpp"
+#include "koikoi-strategy.hpp"
+#include "trace.hpp"
+
+/*  ========================================
+HEADLESS GAME ENGINE
+Plays turns, rounds, and whole games of Koi-Koi between two strategies, without any I/O.
+Everything is a template over the strategy types (see "koikoi-strategy.hpp"), so that self-play loops
+never go through a virtual call; the server's CPU turn uses the same playTurn() with a CPUStrategy.
+
+The two players are called "seats" 0 and 1. When the server uses this engine, seat 0 is the human player.
+========================================    */
+
+// everything that describes a game in progress
+struct GameState {
+	DeckType	deck;
+	Hand		hands[2];			// each seat's hand
+	Hand		table;				// the face-up cards on the table
+	ScorePile	piles[2];			// each seat's score pile
+	bool		calledKK[2];		// whether each seat has called Koi-Koi this round
+	int			scores[2];			// points scored so far this game
+	int			dealer;				// seat that deals (and plays first) this round
+
+	GameState() {
+		calledKK[0] = calledKK[1] = false;
+		scores[0]   = scores[1]   = 0;
+		dealer      = 0;
+	}
+};
+
+// what happened during a single turn (enough to describe it to a human afterwards)
+struct TurnRecord {
+	bool		matchedHand;		// true if a hand card was matched to the table, false if it was given up to the table
+	CardType	handCard;			// the card played from the hand
+	CardType	handTarget;			// the table card it matched (only meaningful if matchedHand)
+	CardType	deckCard;			// the card drawn from the deck
+	bool		matchedDeck;		// true if the deck card matched a table card, false if it was added to the table
+	CardType	deckTarget;			// the table card it matched (only meaningful if matchedDeck)
+	bool		scored;				// true if the score pile gained points this turn, so Koi-Koi had to be decided
+	int			rawScore;			// raw score of the score pile at the end of the turn
+	bool		calledKK;			// true if Koi-Koi was called this turn
+	bool		endRound;			// true if the player chose to end the round this turn
+
+	TurnRecord() : matchedHand(false), handCard(JAN, CHAFF), handTarget(JAN, CHAFF), deckCard(JAN, CHAFF),
+	               matchedDeck(false), deckTarget(JAN, CHAFF), scored(false), rawScore(0), calledKK(false), endRound(false) {}
+};
+
+// how a round ended
+struct RoundResult {
+	int		winner;					// seat that scored this round, or -1 if nobody did
+	int		points;					// points the winner scored
+	bool	instantWin;				// true if the winner was dealt an instant-win hand
+	int		misdeals;				// # of times the deal had to be redone before the round could start
+	int		turns;					// # of turns played
+	int		koikoiCalls[2];			// # of times each seat called Koi-Koi
+	int		rawScoreAtCall[2];		// each seat's raw score the first time it called Koi-Koi this round (0 if it never did)
+
+	RoundResult() : winner(-1), points(0), instantWin(false), misdeals(0), turns(0) {
+		koikoiCalls[0]    = koikoiCalls[1]    = 0;
+		rawScoreAtCall[0] = rawScoreAtCall[1] = 0;
+	}
+};
+
+// does nothing with the events of the game; pass your own class with the same members to watch a game being played
+struct NoObserver {
+	void onTurn(const GameState &, int, const TurnRecord &) {}		// (game, seat, turn) after every turn
+	void onRound(const GameState &, const RoundResult &) {}			// (game, result) after every round
+};
+
+/* =====================================
+PLAYING ONE TURN
+===================================== */
+
+// plays one full turn for a strategy: match (or give up) a hand card, draw & match a deck card, then decide on Koi-Koi
+// UPDATE: hand, deck, table, pile, called_KK, end_round (as in doComputerTurn())
+// RETURN: a record of what was played
+template <class Strategy>
+TurnRecord playTurn(Strategy &cpu, Hand &hand, DeckType &deck, Hand &table, ScorePile &pile, bool &called_KK, bool &end_round,
+                    const ScorePile &opp_pile, const bool opp_KK) {
+	TRACE_SCOPE("playTurn");
+	TurnRecord turn;
+	TurnView view = {hand, table, pile, opp_pile, deck.cardCount(), opp_KK};		// refers to the live hands, so it stays current
+	int score_before = pile.rawScore();		// starting score in the score pile
+	int hand_index  = -1;
+	int table_index = -1;
+
+	// PHASE 1: check cards in the hand to match to the table
+	table_index = cpu.chooseHandCardToPlay(view, hand_index);
+	// PHASE 1: if no matches, then choose a card to put on the table
+	if (table_index == -1) {
+		hand_index = cpu.chooseHandCard4Table(view);
+		turn.handCard = hand.playCard(hand_index);
+		table.addCard(turn.handCard);
+	}
+	// PHASE 1: if it matches something on the table, put both in the score pile
+	else {
+		turn.matchedHand = true;
+		turn.handCard    = hand.playCard(hand_index);
+		turn.handTarget  = table.playCard(table_index);
+		pile.addCard(turn.handCard);
+		pile.addCard(turn.handTarget);
+	}
+
+	// PHASE 2: draw a card from the deck
+	turn.deckCard  = deck.drawCard();
+	view.deckCount = deck.cardCount();
+	table_index = cpu.chooseTableCardToMatch(view, turn.deckCard);
+	// PHASE 2: if no matches, then put the deck card onto the table
+	if (table_index == -1) {
+		table.addCard(turn.deckCard);
+	}
+	// PHASE 2: if it matches something on the table, put both in the score pile
+	else {
+		turn.matchedDeck = true;
+		turn.deckTarget  = table.playCard(table_index);
+		pile.addCard(turn.deckCard);
+		pile.addCard(turn.deckTarget);
+	}
+
+	// PHASE 3: check score pile for koi-koi
+	turn.rawScore = pile.rawScore();
+	if (turn.rawScore != score_before) {							// if score points have changed
+		turn.scored   = true;
+		end_round     = !cpu.callKoiKoi(view, turn.rawScore);		// if the strategy doesn't call Koi-Koi, the round ends
+		turn.calledKK = !end_round;
+		called_KK     = called_KK || !end_round;
+	} else {
+		end_round = false;											// if no update to score pile, then no koi-koi vs. end game decision
+	}
+	turn.endRound = end_round;
+
+	return turn;
+}
+
+/* =====================================
+PLAYING ROUNDS & GAMES
+===================================== */
+
+// checks a freshly-dealt round for instant wins; returns the winning seat, or -1 if there is none
+// (seat 0 is checked first, like the server checks the player before the CPU)
+inline int instantWinner(const GameState &game) {
+	for (int seat = 0; seat < 2; seat++) {
+		if (game.hands[seat].instantWin2222() || game.hands[seat].instantWin4()) {
+			return seat;
+		}
+	}
+	return -1;
+}
+
+// plays one round to completion, starting from the deal; adds the winner's points to game.scores
+template <class S0, class S1, class Observer>
+RoundResult playRound(GameState &game, S0 &cpu0, S1 &cpu1, std::mt19937 &rng, Observer &observer) {
+	RoundResult result;
+	int dealer = game.dealer;
+	int seat;
+	bool end_round = false;
+
+	// deal until the table is not a misdeal (instant wins in either hand take priority over a misdeal)
+	while (true) {
+		setup(game.deck, game.hands[dealer], game.hands[1-dealer], game.table, game.piles[0], game.piles[1], rng);
+		game.calledKK[0] = game.calledKK[1] = false;
+
+		result.winner = instantWinner(game);
+		if (result.winner != -1) {						// somebody was dealt an instant-win hand
+			result.instantWin = true;
+			result.points     = 6;
+			game.scores[result.winner] += result.points;
+			observer.onRound(game, result);
+			return result;
+		}
+		if (!game.table.instantWin2222() && !game.table.instantWin4()) {
+			break;										// a good deal, so the round can start
+		}
+		result.misdeals++;								// otherwise, the deal is null and void
+	}
+
+	// the dealer goes first, and the players alternate until one ends the round or the deck runs out
+	seat = dealer;
+	while (true) {
+		TurnRecord turn;
+		if (seat == 0) {
+			turn = playTurn(cpu0, game.hands[0], game.deck, game.table, game.piles[0], game.calledKK[0], end_round, game.piles[1], game.calledKK[1]);
+		} else {
+			turn = playTurn(cpu1, game.hands[1], game.deck, game.table, game.piles[1], game.calledKK[1], end_round, game.piles[0], game.calledKK[0]);
+		}
+		result.turns++;
+		if (turn.calledKK) {
+			if (result.koikoiCalls[seat] == 0) {
+				result.rawScoreAtCall[seat] = turn.rawScore;
+			}
+			result.koikoiCalls[seat]++;
+		}
+		observer.onTurn(game, seat, turn);
+
+		if (end_round) {								// the player cashes in their score pile
+			result.winner = seat;
+			result.points = game.piles[seat].finalScore(game.calledKK[1-seat]);
+			game.scores[seat] += result.points;
+			break;
+		}
+		if (game.deck.isEmpty() || (game.hands[0].isEmpty() && game.hands[1].isEmpty())) {	// if the deck or both hands run out, the round ends with no points
+			break;
+		}
+		seat = 1 - seat;
+	}
+
+	observer.onRound(game, result);
+	return result;
+}
+
+// plays a whole game of the given # of rounds; the first dealer is chosen at random, and afterwards the winner of each round deals
+// RETURN: the winning seat, or -1 for a tie (final points are left in game.scores)
+template <class S0, class S1, class Observer>
+int playGame(GameState &game, S0 &cpu0, S1 &cpu1, int totalrounds, std::mt19937 &rng, Observer &observer) {
+	game.scores[0] = game.scores[1] = 0;
+	game.dealer    = rng() % 2;
+
+	for (int round = 1; round <= totalrounds; round++) {
+		RoundResult result = playRound(game, cpu0, cpu1, rng, observer);
+		if (result.winner != -1 && !result.instantWin) {	// winner becomes next dealer (an instant win keeps the same dealer, like the server)
+			game.dealer = result.winner;
+		}
+	}
+
+	if (game.scores[0] > game.scores[1]) {
+		return 0;
+	} else if (game.scores[1] > game.scores[0]) {
+		return 1;
+	} else {
+		return -1;
+	}
+}
+
+template <class S0, class S1>
+int playGame(GameState &game, S0 &cpu0, S1 &cpu1, int totalrounds, std::mt19937 &rng) {
+	NoObserver observer;
+	return playGame(game, cpu0, cpu1, totalrounds, rng, observer);
+}
+
+#endif
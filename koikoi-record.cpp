@@ -0,0 +1,338 @@
+#include "koikoi-record.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+/* =====================================
+BUILDING RECORDS
+===================================== */
+
+static void putU16(unsigned char *p, unsigned int n) {
+	p[0] = n & 0xFF;
+	p[1] = (n >> 8) & 0xFF;
+	return;
+}
+
+static void putU32(unsigned char *p, unsigned int n) {
+	putU16(p, n & 0xFFFF);
+	putU16(p + 2, n >> 16);
+	return;
+}
+
+void packTurn(const TurnRecord &turn, unsigned char *bytes) {
+	bytes[0] = turn.handCard.cardId() | (turn.scored ? 0x40 : 0) | (turn.calledKK ? 0x80 : 0);
+	bytes[1] = turn.matchedHand ? turn.handTarget.cardId() : RECORDNOCARD;
+	bytes[2] = turn.matchedDeck ? turn.deckTarget.cardId() : RECORDNOCARD;
+	return;
+}
+
+GameRecorder::GameRecorder() : roundStart(0), inRound(false), turns(0), rounds(0) {
+	rawAtCall[0] = rawAtCall[1] = 0;
+	bytes.reserve(RECORDMAXBYTES);		// so that recording a game never allocates
+}
+
+void GameRecorder::begin(unsigned int seed, int strategy0, int strategy1) {
+	bytes.assign(RECORDHEADER, 0);
+	putU32(&bytes[2], seed);
+	bytes[6] = (strategy0 & 0xF) | ((strategy1 & 0xF) << 4);
+	inRound = false;
+	turns   = 0;
+	rounds  = 0;
+	return;
+}
+
+// sets aside the bytes at the start of the round, which addRound() fills in
+void GameRecorder::startRound() {
+	roundStart = bytes.size();
+	bytes.resize(roundStart + RECORDROUND);
+	inRound      = true;
+	turns        = 0;
+	rawAtCall[0] = rawAtCall[1] = 0;
+	return;
+}
+
+void GameRecorder::addTurn(const TurnRecord &turn) {
+	if (!inRound) {
+		startRound();
+	}
+	bytes.resize(bytes.size() + 3);
+	packTurn(turn, &bytes[bytes.size() - 3]);
+	if (turn.calledKK && rawAtCall[turns % 2] == 0) {		// the dealer plays the even turns
+		rawAtCall[turns % 2] = (turn.rawScore < 255) ? turn.rawScore : 255;
+	}
+	turns++;
+	return;
+}
+
+void GameRecorder::addRound(int dealer, const RoundResult &result, unsigned int combos) {
+	if (!inRound) {						// (an instant win has no turns)
+		startRound();
+	}
+	bytes[roundStart]   = (dealer & 1) | (result.instantWin ? 2 : 0) | ((result.misdeals < 63 ? result.misdeals : 63) << 2);
+	bytes[roundStart+1] = turns;
+	bytes[roundStart+2] = result.winner + 1;
+	bytes[roundStart+3] = (result.points < 255) ? result.points : 255;
+	putU16(&bytes[roundStart+4], combos);
+	bytes[roundStart+6+dealer]   = rawAtCall[0];
+	bytes[roundStart+6+1-dealer] = rawAtCall[1];
+	inRound = false;
+	rounds++;
+	return;
+}
+
+void GameRecorder::finish(int score0, int score1) {
+	bytes[7] = rounds;
+	putU16(&bytes[8], score0);
+	putU16(&bytes[10], score1);
+	putU16(&bytes[0], bytes.size());
+	return;
+}
+
+/* =====================================
+READING RECORDS
+===================================== */
+
+// takes the table card with the given ID (or none, for RECORDNOCARD) with the card played, into the pile
+// RETURN: false if there is no such table card, or it doesn't match
+static bool replayMatch(CardType played, int targetId, Hand &table, ScorePile &pile, bool &matched, CardType &target) {
+	if (targetId == RECORDNOCARD) {
+		table.addCard(played);
+		return true;
+	}
+	if (targetId >= NUMCARDS) {
+		return false;
+	}
+	CardType wanted = CardType::fromId(targetId);
+	int t = table.findFirstIndex(wanted.getMonth(), wanted.getDesign());
+	if (t == -1 || !theseCardsMatch(played, wanted)) {
+		return false;
+	}
+	matched = true;
+	target  = table.playCard(t);
+	pile.addCard(played);
+	pile.addCard(target);
+	return true;
+}
+
+bool replayTurn(const unsigned char *turn, Hand &hand, DeckType &deck, Hand &table, ScorePile &pile, TurnRecord &record) {
+	int handId = turn[0] & 0x3F;
+	if (handId >= NUMCARDS || deck.isEmpty()) {
+		return false;
+	}
+	CardType card = CardType::fromId(handId);
+	int h = hand.findFirstIndex(card.getMonth(), card.getDesign());
+	if (h == -1) {
+		return false;
+	}
+	record.handCard = hand.playCard(h);
+	if (!replayMatch(record.handCard, turn[1], table, pile, record.matchedHand, record.handTarget)) {
+		return false;
+	}
+	record.deckCard = deck.drawCard();
+	if (!replayMatch(record.deckCard, turn[2], table, pile, record.matchedDeck, record.deckTarget)) {
+		return false;
+	}
+	record.rawScore = pile.rawScore();
+	record.scored   = (turn[0] & 0x40) != 0;
+	record.calledKK = (turn[0] & 0x80) != 0;
+	record.endRound = record.scored && !record.calledKK;
+	return true;
+}
+
+/* =====================================
+STORING RECORDS
+===================================== */
+
+// the segment's header; a record counts once games says so, which is always written last
+struct StoreHeader {
+	char				magic[8];
+	unsigned int		version;
+	unsigned int		headerSize;
+	unsigned long long	games;		// # of records
+	unsigned long long	used;		// # of bytes of records after the header
+};
+
+RecordStore::RecordStore() : segfd(-1), idxfd(-1), seg(NULL), segSize(0), idx(NULL), idxSize(0), writable(false) {
+	pthread_mutex_init(&appendLock, NULL);
+}
+
+RecordStore::~RecordStore() {
+	close();
+	pthread_mutex_destroy(&appendLock);
+}
+
+// makes the file (and its mapping) at least "needed" bytes long, in steps of STOREGROWTH
+bool RecordStore::grow(int fd, void *&map, size_t &size, size_t needed) {
+	size_t newSize = size;
+	while (newSize < needed) {
+		newSize += STOREGROWTH;
+	}
+	if (newSize == size) {
+		return true;
+	}
+	if (ftruncate(fd, newSize) < 0) {
+		return false;
+	}
+	void *newMap = (map == NULL) ? mmap(NULL, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+	                             : mremap(map, size, newSize, MREMAP_MAYMOVE);
+	if (newMap == MAP_FAILED) {
+		return false;
+	}
+	map  = newMap;
+	size = newSize;
+	return true;
+}
+
+// works out every record's offset again by walking the segment (for an index that is missing or came up short)
+void RecordStore::rebuildIndex() {
+	const StoreHeader *header = reinterpret_cast<const StoreHeader*>(seg);
+	unsigned long long offset = STOREHEADER;
+	for (unsigned long long g = 0; g < header->games; g++) {
+		idx[g]  = offset;
+		offset += recordLength(seg + offset);
+	}
+	return;
+}
+
+bool RecordStore::open(const char *path, bool forWriting) {
+	std::string idxPath = std::string(path) + ".idx";
+	int flags = forWriting ? (O_RDWR | O_CREAT) : O_RDONLY;
+	int prot  = forWriting ? (PROT_READ | PROT_WRITE) : PROT_READ;
+	struct stat st;
+
+	close();
+	writable = forWriting;
+	segfd = ::open(path, flags, 0644);
+	idxfd = ::open(idxPath.c_str(), flags, 0644);
+	if (segfd < 0 || (idxfd < 0 && (forWriting || errno != ENOENT)) || fstat(segfd, &st) < 0) {		// (a reader can do without the index)
+		close();
+		return false;
+	}
+
+	if (st.st_size == 0 && forWriting) {			// a new store: write its header
+		void *map = NULL;
+		if (!grow(segfd, map, segSize, STOREHEADER)) {
+			close();
+			return false;
+		}
+		seg = static_cast<unsigned char*>(map);
+		StoreHeader *header = reinterpret_cast<StoreHeader*>(seg);
+		memcpy(header->magic, STOREMAGIC, 8);
+		header->version    = STOREVERSION;
+		header->headerSize = STOREHEADER;
+		header->games      = 0;
+		header->used       = 0;
+	} else {
+		segSize = st.st_size;
+		seg = (segSize >= STOREHEADER) ? static_cast<unsigned char*>(mmap(NULL, segSize, prot, MAP_SHARED, segfd, 0)) : static_cast<unsigned char*>(MAP_FAILED);
+		if (seg == MAP_FAILED || memcmp(seg, STOREMAGIC, 8) != 0 || reinterpret_cast<StoreHeader*>(seg)->version != STOREVERSION) {
+			seg = (seg == MAP_FAILED) ? NULL : seg;
+			close();
+			errno = EINVAL;
+			return false;
+		}
+	}
+
+	const StoreHeader *header = reinterpret_cast<const StoreHeader*>(seg);
+	st.st_size = 0;
+	if (idxfd >= 0 && fstat(idxfd, &st) < 0) {
+		close();
+		return false;
+	}
+	idxSize = st.st_size;
+	if (idxSize > 0) {
+		idx = static_cast<unsigned long long*>(mmap(NULL, idxSize, prot, MAP_SHARED, idxfd, 0));
+		if (idx == MAP_FAILED) {
+			idx = NULL;
+			close();
+			return false;
+		}
+	}
+	size_t needed = header->games * sizeof(unsigned long long);
+	if (idxSize < needed) {
+		if (forWriting) {
+			void *map = idx;
+			if (!grow(idxfd, map, idxSize, needed)) {
+				close();
+				return false;
+			}
+			idx = static_cast<unsigned long long*>(map);
+		} else {									// a reader can't fix the index file, so it builds its own copy in memory
+			if (idx != NULL) {
+				munmap(idx, idxSize);
+			}
+			idxSize = needed;
+			idx = static_cast<unsigned long long*>(mmap(NULL, idxSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+			if (idx == MAP_FAILED) {
+				idx = NULL;
+				close();
+				return false;
+			}
+		}
+		rebuildIndex();
+	}
+	if (forWriting && header->games > 0) {			// (a crash between writing used & games leaves used too far along)
+		StoreHeader *fix = reinterpret_cast<StoreHeader*>(seg);
+		fix->used = idx[fix->games - 1] + recordLength(seg + idx[fix->games - 1]) - STOREHEADER;
+	}
+	return true;
+}
+
+void RecordStore::close() {
+	if (seg != NULL) {
+		munmap(seg, segSize);
+	}
+	if (idx != NULL) {
+		munmap(idx, idxSize);
+	}
+	if (segfd >= 0) {
+		::close(segfd);
+	}
+	if (idxfd >= 0) {
+		::close(idxfd);
+	}
+	seg     = NULL;
+	idx     = NULL;
+	segSize = idxSize = 0;
+	segfd   = idxfd   = -1;
+	return;
+}
+
+bool RecordStore::append(const unsigned char *record, size_t length) {
+	bool ok = false;
+
+	if (!writable || seg == NULL) {
+		return false;
+	}
+	pthread_mutex_lock(&appendLock);
+	StoreHeader *header = reinterpret_cast<StoreHeader*>(seg);
+	size_t offset = STOREHEADER + header->used;
+	void *segMap = seg, *idxMap = idx;
+	if (grow(segfd, segMap, segSize, offset + length) && grow(idxfd, idxMap, idxSize, (header->games + 1) * sizeof(unsigned long long))) {
+		seg    = static_cast<unsigned char*>(segMap);
+		idx    = static_cast<unsigned long long*>(idxMap);
+		header = reinterpret_cast<StoreHeader*>(seg);
+		memcpy(seg + offset, record, length);
+		idx[header->games] = offset;
+		__atomic_store_n(&header->used, header->used + length, __ATOMIC_RELEASE);
+		__atomic_store_n(&header->games, header->games + 1, __ATOMIC_RELEASE);		// the record counts from here on
+		ok = true;
+	} else {
+		seg = static_cast<unsigned char*>(segMap);
+		idx = static_cast<unsigned long long*>(idxMap);
+	}
+	pthread_mutex_unlock(&appendLock);
+	return ok;
+}
+
+long RecordStore::count() const {
+	return (seg == NULL) ? 0 : reinterpret_cast<const StoreHeader*>(seg)->games;
+}
+
+size_t RecordStore::bytes() const {
+	return (seg == NULL) ? 0 : reinterpret_cast<const StoreHeader*>(seg)->used;
+}
@@ -0,0 +1,204 @@
+#ifndef KOIKOI_RECORD_H
+#define KOIKOI_RECORD_H
+
+#include <vector>
+#include <random>
+#include <cstddef>
+#include <pthread.h>
+#include "koikoi-engine.hpp"
+
+/*  ========================================
+GAME RECORDS
+A finished game, packed into bytes: the seed its deals came from, then each round's result and each turn's moves,
+with every card written as its 1-byte ID (see CardType::cardId()). A 12-round game takes a few hundred bytes.
+
+The deck is not written down: the deals are replayed from the seed, exactly like playGame() deals them:
+	std::mt19937 rng(seed);  first dealer = rng() % 2;  then every deal (misdeals too) is
+	setup(deck, hands[dealer], hands[1-dealer], table, piles[0], piles[1], rng)
+which lays out the 48 cards in DeckType::initialize()'s order (January's first), shuffles them with DeckType::shuffle(rng):
+	for i = 47 down to 1:  j = a bounded draw of 0..i;  swap cards i & j
+	(a bounded draw of 0..n-1 takes r = rng() until r < 2^32 - (2^32 mod n), and is then r mod n)
+and deals the top (last) 8 cards to the non-dealer, the next 8 to the table, and the next 8 to the dealer, one by one.
+
+Layout (all numbers little-endian):
+	u16 length of the whole record, in bytes
+	u32 seed
+	u8  strategy of seat 0 (low 4 bits) & seat 1 (high 4 bits), as a StrategyKind, or RECORDHUMAN
+	u8  # of rounds
+	u16 final score of seat 0, u16 final score of seat 1
+	then for each round:
+		u8  dealer seat (bit 0), instant win (bit 1), # of misdeals before the deal (bits 2-7)
+		u8  # of turns
+		u8  seat that scored + 1 (0 if nobody did)
+		u8  points scored
+		u16 the combos the scoring seat's pile had, as a ScorePile::comboMask() (0 for an instant win)
+		u8  seat 0's raw score when it first called Koi-Koi this round (0 if it never did), u8 the same for seat 1
+		then for each turn, 3 bytes:
+			u8  hand card ID (bits 0-5), Koi-Koi had to be decided (bit 6), Koi-Koi was called (bit 7)
+			u8  ID of the table card the hand card took, or RECORDNOCARD if it was added to the table
+			u8  ID of the table card the deck card took, or RECORDNOCARD if it was added to the table
+========================================    */
+
+#define RECORDHUMAN		0xF			// strategy # of a human player
+#define RECORDNOCARD	0xFF		// card ID of "no card"
+#define RECORDHEADER	12			// bytes before the first round
+#define RECORDROUND		8			// bytes at the start of each round
+#define RECORDMAXBYTES	65535		// longest possible record (the length is a u16)
+
+// writes a turn as its 3 bytes in a record
+void packTurn(const TurnRecord &turn, unsigned char *bytes);
+
+// builds the record of one game, turn by turn; can be passed to playGame() as its observer
+class GameRecorder {
+private:
+	std::vector<unsigned char>	bytes;
+	size_t						roundStart;		// where the current round's RECORDROUND bytes go
+	bool						inRound;		// whether the current round's bytes have been set aside yet
+	int							turns;			// turns so far this round
+	int							rawAtCall[2];	// raw score at the first Koi-Koi call this round, of the dealer [0] & the other seat [1]
+	int							rounds;
+	void startRound();
+public:
+	GameRecorder();
+
+	void begin(unsigned int seed, int strategy0, int strategy1);		// starts a new record (strategies are StrategyKind or RECORDHUMAN)
+	void addTurn(const TurnRecord &turn);								// records one turn (in the order they are played)
+	void addRound(int dealer, const RoundResult &result, unsigned int combos);	// records the end of a round (combos: the scoring seat's comboMask())
+	void finish(int score0, int score1);								// writes the final scores; the record is then complete
+
+	const unsigned char *data() const { return bytes.data(); }
+	size_t length() const { return bytes.size(); }
+
+	// so that a GameRecorder can watch playGame() (begin() and finish() still have to be called around it)
+	void onTurn(const GameState &, int, const TurnRecord &turn) { addTurn(turn); }
+	void onRound(const GameState &game, const RoundResult &result) {
+		addRound(game.dealer, result, (result.winner != -1 && !result.instantWin) ? game.piles[result.winner].comboMask() : 0);
+	}
+};
+
+/* =====================================
+READING RECORDS
+===================================== */
+
+inline unsigned int recordU16(const unsigned char *p) { return p[0] | (p[1] << 8); }
+inline unsigned int recordU32(const unsigned char *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<unsigned int>(p[3]) << 24); }
+
+inline size_t       recordLength(const unsigned char *record)         { return recordU16(record); }
+inline unsigned int recordSeed(const unsigned char *record)           { return recordU32(record + 2); }
+inline int          recordStrategy(const unsigned char *record, int seat) { return (record[6] >> (4 * seat)) & 0xF; }
+inline int          recordRounds(const unsigned char *record)         { return record[7]; }
+inline int          recordScore(const unsigned char *record, int seat) { return recordU16(record + 8 + 2 * seat); }
+// (and for the round that starts at "round")
+inline int          roundDealer(const unsigned char *round)           { return round[0] & 1; }
+inline bool         roundInstantWin(const unsigned char *round)       { return (round[0] & 2) != 0; }
+inline int          roundMisdeals(const unsigned char *round)         { return round[0] >> 2; }
+inline int          roundTurns(const unsigned char *round)            { return round[1]; }
+inline int          roundWinner(const unsigned char *round)           { return round[2] - 1; }
+inline int          roundPoints(const unsigned char *round)           { return round[3]; }
+inline unsigned int roundCombos(const unsigned char *round)           { return recordU16(round + 4); }
+inline int          roundRawAtCall(const unsigned char *round, int seat) { return round[6 + seat]; }
+inline size_t       roundLength(const unsigned char *round)           { return RECORDROUND + 3 * roundTurns(round); }
+
+// plays one recorded turn (the 3 bytes at "turn") from the hand & the deck, onto the table or into the pile
+// UPDATE: hand, deck, table, pile, and record (what was played, as playTurn() would have returned it)
+// RETURN: true if the turn could have been played, false if not (hand, deck, table & pile may then be part-way through it)
+bool replayTurn(const unsigned char *turn, Hand &hand, DeckType &deck, Hand &table, ScorePile &pile, TurnRecord &record);
+
+// replays a record through the engine's own setup(), checking every move against the hands & table as it goes, and
+// calls observer.onTurn() & observer.onRound() like playGame() does (game.scores are only updated at the end)
+// RETURN: true if the record describes a game that could have been played, false if not (replay stops there)
+template <class Observer>
+bool replayGame(const unsigned char *record, GameState &game, Observer &observer) {
+	size_t length = recordLength(record);
+	size_t at     = RECORDHEADER;
+	std::mt19937 rng(recordSeed(record));
+
+	game.dealer = rng() % 2;
+	for (int round = 0; round < recordRounds(record); round++) {
+		if (at + RECORDROUND > length) {
+			return false;
+		}
+		RoundResult result;
+		int dealer        = roundDealer(record + at);
+		result.instantWin = roundInstantWin(record + at);
+		result.misdeals   = roundMisdeals(record + at);
+		result.turns      = roundTurns(record + at);
+		result.winner     = roundWinner(record + at);
+		result.points     = roundPoints(record + at);
+		at += RECORDROUND;
+		if (dealer != game.dealer || at + 3 * result.turns > length) {
+			return false;
+		}
+		for (int deal = 0; deal <= result.misdeals; deal++) {
+			setup(game.deck, game.hands[dealer], game.hands[1-dealer], game.table, game.piles[0], game.piles[1], rng);
+		}
+		game.calledKK[0] = game.calledKK[1] = false;
+
+		int seat = dealer;
+		for (int t = 0; t < result.turns; t++, at += 3, seat = 1 - seat) {
+			TurnRecord turn;
+			if (!replayTurn(record + at, game.hands[seat], game.deck, game.table, game.piles[seat], turn)) {
+				return false;
+			}
+			game.calledKK[seat] = game.calledKK[seat] || turn.calledKK;
+			if (turn.calledKK) {
+				if (result.koikoiCalls[seat] == 0) {
+					result.rawScoreAtCall[seat] = turn.rawScore;
+				}
+				result.koikoiCalls[seat]++;
+			}
+			observer.onTurn(game, seat, turn);
+		}
+		observer.onRound(game, result);
+		if (result.winner != -1 && !result.instantWin) {		// winner deals next, like playGame()
+			game.dealer = result.winner;
+		}
+	}
+	game.scores[0] = recordScore(record, 0);
+	game.scores[1] = recordScore(record, 1);
+	return at == length;
+}
+
+/* =====================================
+STORING RECORDS
+A record store is two files, both memory-mapped:
+	the segment (path), a 64-byte header followed by every record, back to back, in the order they were added
+	the index (path + ".idx"), the offset of each record in the segment, as a u64
+Records are only ever appended. A record counts once the # of games in the segment's header says so, and that is
+written last, so a crash part-way through adding a record leaves the store as it was before (the index is rebuilt
+from the segment if it comes up short). The files grow by STOREGROWTH bytes at a time.
+===================================== */
+
+#define STOREMAGIC		"KOIKOIGR"
+#define STOREVERSION	3			// (3: deals from DeckType::shuffle()'s own Fisher-Yates)
+#define STOREHEADER		64
+#define STOREGROWTH		(16 * 1024 * 1024)
+
+class RecordStore {
+private:
+	int				segfd, idxfd;
+	unsigned char	*seg;			// the whole segment, mapped
+	size_t			segSize;		// bytes mapped (= the segment file's size)
+	unsigned long long	*idx;		// the whole index, mapped
+	size_t			idxSize;
+	bool			writable;
+	pthread_mutex_t	appendLock;		// appends from different threads take turns
+
+	bool grow(int fd, void *&map, size_t &size, size_t needed);
+	void rebuildIndex();
+public:
+	RecordStore();
+	~RecordStore();
+
+	bool open(const char *path, bool forWriting);				// opens (or, for writing, creates) the store; returns false (with errno set) if it can't
+	void close();
+	bool append(const unsigned char *record, size_t length);	// adds a record; returns false if the files could not grow
+
+	long count() const;											// # of records in the store
+	size_t bytes() const;										// # of bytes of records in the store
+	const unsigned char *record(long i) const { return seg + idx[i]; }	// the i-th record (0 = oldest)
+	const unsigned char *begin() const { return seg + STOREHEADER; }	// all of the records, back to back, for scanning
+	const unsigned char *end() const { return seg + STOREHEADER + bytes(); }
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include "koikoi-rules.hpp"
+#include <vector>
+
+/*  TYPES USED:
+CardType		models a card, with comparison and name-printing functionality
+DeckType		models a deck of cards, with drawing and shuffling functionality
+Hand			models a hand, with card-checking, sorting, drawing, and playing functionality (also used to model the table, since the table needs no extra functionality not provided by Hand)
+ScorePile		derived from Hand class, models a score pile with scoring functionality
+*/
+
+
+/* =====================================
+MATCHING FUNCTIONS
+===================================== */
+// returns true if "tablecard" on the table can be matched by the card "matcher"
+bool theseCardsMatch(const CardType &matcher, const CardType &tablecard) {
+	if (matcher.isLightning()) {									// Lightning card can match anything (but can only *be matched* by other NOV cards)
+		return true;
+	} else if (matcher.getMonth() == tablecard.getMonth()) {		// "match" means to have the same month
+		return true;
+	}
+	// otherwise
+	return false;
+}
+
+// searches through the table and looks for all cards that can be matched by "matcher"
+// UPDATE: the integer list "validTableCards" will be updated by reference with the list of indices of cards on the table that can be matched by "matcher"
+// RETURN: boolean of whether any matchable cards on the table were found (i.e., whether "validTableCards" has any entries or not)
+bool findMatches(const CardType &matcher, const Hand &table, std::vector<int> &validTableCards) {
+	validTableCards.clear();										// make sure the list of valid cards is empty
+	int tablesize = table.cardCount();								// increase efficiency with local variable
+
+	for (int i=0; i < tablesize; i++) {								// for each card on the table
+		if ( theseCardsMatch(matcher, table.getCard(i)) ) {			// if the chosen card matches card i on the table
+			validTableCards.push_back(i);							// then add i to the list (updated by reference)
+		}
+	}
+	return !validTableCards.empty();								// return whether the process above actually found any matches (true = match found, false = no matches found)
+}
+
+// returns true if findMatches(...) would return false for EVERY card in the hand; otherwise returns false
+// "short-circuit"s if the hand or the table is empty, since of course nothing can be matched in those cases
+bool noCardsToPlay(const Hand &hand, const Hand &table) {
+	int handsize = hand.cardCount();
+
+	if (table.isEmpty() || hand.isEmpty()) {		// if either the hand or table are devoid of cards, we can't play anything this phase
+		return true;
+	}
+
+	for (int i=0; i < handsize; i++) {
+		if (hasMatches(hand.getCard(i), table)) {					// if we ever find a card that can match something on the table
+			return false;											// then we DO have a card to play, so return false
+		}
+	}
+
+	// if we reach here, then no playable cards ever found, so return true
+	return true;
+}
+
+// returns true if there findMatches(...) would return true
+// (without building the list of matches, so it never allocates)
+bool hasMatches(const CardType &matcher, const Hand &table) {
+	int tablesize = table.cardCount();
+
+	for (int i=0; i < tablesize; i++) {
+		if ( theseCardsMatch(matcher, table.getCard(i)) ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// the IDs of a month's 4 cards are consecutive (see CardType::cardId()), so each month is one nibble of a CardMask
+static CardMask monthMask(MonthType m) {
+	return 0xFULL << (4 * (static_cast<int>(m) - JAN));
+}
+
+// every card of every month that has at least one card in the set
+static CardMask wholeMonths(CardMask cards) {
+	cards |= cards >> 1;
+	cards |= cards >> 2;								// (the lowest bit of each nibble now says whether the month has any card)
+	return (cards & 0x111111111111ULL) * 0xF;
+}
+
+// the set of table cards that "matcher" can match (the same cards findMatches() lists, without building the list)
+CardMask matchableCards(const CardType &matcher, const Hand &table) {
+	if (matcher.isLightning()) {						// Lightning can match anything
+		return table.cardMask();
+	}
+	return table.cardMask() & monthMask(matcher.getMonth());
+}
+
+// the set of hand cards that can match at least one table card
+CardMask playableCards(const Hand &hand, const Hand &table) {
+	static const CardMask lightning = CardType::maskOf(&CardType::isLightning);
+
+	if (table.isEmpty()) {
+		return 0;
+	}
+	return hand.cardMask() & (wholeMonths(table.cardMask()) | lightning);
+}
+
+/* =====================================
+MOVING CARDS BETWEEN HANDS & TABLE & SCORE PILE
+===================================== */
+
+// deal n cards from the deck to the given hand
+void dealCards(DeckType &deck, Hand &hand, int n) {
+	int decksize = deck.cardCount();	// loop optimization
+
+	// if the deck doesn't have enough cards to deal that many cards, then we've done something wrong, so crash here:
+	if (n > decksize) {
+		// std::cerr << "ERROR: Cannot draw " << n << " cards, as deck has only " << decksize << "cards." << std::endl;
+		throw "ERROR: Tried to draw more cards than the deck has available.";
+		return;
+	}
+
+	// otherwise, draw n cards from the deck and add them to the given hand (by reference)
+	for (int i=0; i < n; i++) {			// this loop will occur 8 times
+		hand.addCard(deck.drawCard());	// take a card from the deck and add it to the chosen hand
+	}
+	return;
+}
+
+// deal 8 cards to non-dealer, then 8 to table, then 8 to dealer, from a deck that has just been shuffled
+static void dealRound(DeckType &deck, Hand &dealer, Hand &nondealer, Hand &table) {
+	dealCards(deck, nondealer,	8);
+	dealCards(deck, table, 		8);
+	dealCards(deck, dealer,		8);
+	// at this point, the deck should have 24 cards left
+	if (deck.cardCount() != 24) {
+		throw "ERROR: Something went wrong with the dealing process! Deck does not have 24 cards.";
+	}
+	return;
+}
+
+// deal 8 cards to non-dealer, then 8 to table, then 8 to dealer
+void setup(DeckType &deck, Hand &dealer, Hand &nondealer, Hand &table, ScorePile &playerPile, ScorePile &cpuPile) {
+	TRACE_SCOPE("setup");
+	// first, run cleanup() to initialize everything appropriately
+	cleanup(deck, dealer, nondealer, table, playerPile, cpuPile);	// empties deck, both hands, and table
+	// reset the deck and shuffle it
+	deck.initialize();							// deck gets all 48 cards
+	deck.shuffle();
+	// finally, deal to non-dealer, then table, then dealer
+	dealRound(deck, dealer, nondealer, table);
+	return;
+}
+
+// same as setup() above, but the shuffle only uses the given generator, so that a seed reproduces the deal
+void setup(DeckType &deck, Hand &dealer, Hand &nondealer, Hand &table, ScorePile &playerPile, ScorePile &cpuPile, std::mt19937 &rng) {
+	TRACE_SCOPE("setup");
+	cleanup(deck, dealer, nondealer, table, playerPile, cpuPile);	// empties deck, both hands, and table
+	deck.initialize();							// deck gets all 48 cards
+	deck.shuffle(rng);
+	dealRound(deck, dealer, nondealer, table);
+	return;
+}
+
+// resets & shuffles the deck, clears everyone's hands and score piles and the table
+void cleanup(DeckType &deck, Hand &dealer, Hand &nondealer, Hand &table, ScorePile &playerPile, ScorePile &cpuPile) {
+	// reset everyone's hands
+	dealer.destroy();
+	nondealer.destroy();
+	table.destroy();
+	// and score piles
+	playerPile.destroy();
+	cpuPile.destroy();
+	// and the deck
+	deck.destroy();
+	return;
+}
@@ -0,0 +1,32 @@
+#ifndef KOIKOI_RULES_H
+#define KOIKOI_RULES_H
+
+#include <vector>
+#include <random>
+#include "hanafuda-hands.hpp"
+#include "hanafuda-deck.hpp"
+
+/*  The rules of Koi-Koi that do not depend on who is playing or how the game is shown to them.
+	Nothing in here does any I/O, so it can be shared by the server, the CPU strategies, and any offline tools.
+*/
+
+/* =====================================
+MATCHING FUNCTIONS
+===================================== */
+bool theseCardsMatch(const CardType &matcher, const CardType &tablecard);												// returns true if the two cards match (= have the same month)
+bool findMatches(const CardType &matcher, const Hand &table, std::vector<int> &validTableCards);						// find if there are any matches on the table for the matcher card
+bool noCardsToPlay(const Hand &hand, const Hand &table);                                                                // find if a hand has any cards that can match a table card
+bool hasMatches(const CardType &matcher, const Hand &table);                                                            // find if a card will have any matches from findMatches()
+CardMask matchableCards(const CardType &matcher, const Hand &table);													// the table cards that findMatches() would find, as a set of card IDs
+CardMask playableCards(const Hand &hand, const Hand &table);															// the hand cards that have at least one match on the table, as a set of card IDs
+
+/* =====================================
+MOVING CARDS BETWEEN HANDS & TABLE & SCORE PILE
+===================================== */
+void dealCards(DeckType &deck, Hand &hand, int n);                       												// deal n cards from the deck to the given hand
+void setup(DeckType &deck, Hand &dealer, Hand &nondealer, Hand &table, ScorePile &playerPile, ScorePile &cpuPile);		// deal 8 cards to non-dealer, then 8 to table, then 8 to dealer
+void setup(DeckType &deck, Hand &dealer, Hand &nondealer, Hand &table, ScorePile &playerPile, ScorePile &cpuPile,		// same as above, but shuffles with the given generator
+           std::mt19937 &rng);
+void cleanup(DeckType &deck, Hand &dealer, Hand &nondealer, Hand &table, ScorePile &playerPile, ScorePile &cpuPile);	// resets & shuffles the deck, clears everyone's hands and
+
+#endif
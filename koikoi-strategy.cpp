@@ -0,0 +1,389 @@
+#include "koikoi-strategy.hpp"
+#include "koikoi-rules.hpp"
+#include <vector>
+#include <strings.h>	//strcasecmp()
+
+/* =====================================
+RANDOM STRATEGY
+===================================== */
+
+// simulates the computer choosing a card in their hand to match to one on the table
+// 		hand_choice:  -1 if no can do, otherwise index of hand card to match  (update by reference)
+// 		table_choice: -1 if no can do, otherwise index of table card to match (return value)
+int RandomStrategy::chooseHandCardToPlay(const TurnView &view, int &hand_choice) {
+	int table_choice;						// return value: index of table card to match (-1 if not possible)
+	int handsize  = view.hand.cardCount();	// # of cards in hand
+
+	// first, try to match a card from the table
+	if (noCardsToPlay(view.hand, view.table)) {
+		hand_choice  = -1;
+		table_choice = -1;
+	} else {
+		// first, randomly choose a card in hand to play
+		while (true) {
+			hand_choice = rng() % handsize;	// generate a valid index for a card in the CPU's hand
+			if (findMatches(view.hand.getCard(hand_choice), view.table, matching_cards)) {	// if that card can match something on the table
+				break;
+			}
+			// continue until we get a good card for hand_choice
+		}
+
+		// next, randomly choose a table card from matching_cards to match it to
+		table_choice = rng() % matching_cards.size();	// grab a random index from matching_cards
+		table_choice = matching_cards[table_choice];	// grab and grab the *table card* index stored at that matching_cards index
+	}
+
+	// hand_choice:  -1 if no can do, otherwise index of hand card to match  (update by reference)
+	// table_choice: -1 if no can do, otherwise index of table card to match (return value)
+	return table_choice;
+}
+
+// takes a card from the deck & the table, and returns the index of the card on the table to be matched to
+int RandomStrategy::chooseTableCardToMatch(const TurnView &view, const CardType matcher) {
+	int table_choice;						// return value: index of table card to match (-1 if not possible)
+
+	if (view.table.isEmpty()) {				// if no cards in the table, then CPU can hardly match anything on it
+		table_choice = -1;
+		return table_choice;
+	}
+
+	// first, try to match a card from the table
+	if (!findMatches(matcher, view.table, matching_cards)) {		// if no matchable cards on table
+		table_choice = -1;
+	} else {	// if there are matchable cards on the table, their indices are now in matching_cards
+		table_choice = matching_cards[rng() % matching_cards.size()];		// and grab a table card index stored in a random element of matching_cards
+	}
+
+	// table_choice: -1 if no can do, otherwise index of table card to match (return value)
+	return table_choice;
+}
+
+// randomly choose a card from the hand to give up to the table
+int RandomStrategy::chooseHandCard4Table(const TurnView &view) {
+	return rng() % view.hand.cardCount();		// return the index of a random card in the hand
+}
+
+// randomly choose whether or not to call Koi-Koi, based on current # of points
+// the higher the computer's score, the more likely it will be to call Koi-Koi
+bool RandomStrategy::callKoiKoi(const TurnView &view, const int rawscore) {
+	int chance = rng() % 100;				// generate a random number 0-99
+
+	if (rawscore < 3 ) {
+		return chance < 25;	// 25% chance of calling Koi-Koi
+	} else if (rawscore < 7) {
+		return chance < 50;	// 50% chance of calling Koi-Koi
+	} else if (rawscore < 11) {
+		return chance < 75;	// 75% chance of calling Koi-Koi
+	} else {	// if rawscore >= 11
+		return chance < 90;	// 90% chance of calling Koi-Koi
+	}
+}
+
+/* =====================================
+GREEDY STRATEGY
+===================================== */
+
+// the card sets that every combo is built from, worked out once from the card-identifying functions in "hanafuda-card.hpp"
+struct ComboMasks {
+	CardMask all, lights, rainMan, seeds, ribbons, chaff, lightning, poetry, blue, inoshikacho, sakura, moon, rainy;
+	CardMask months[13];				// months[m] = the four cards of month m (index 0 unused)
+	CardMask sameCard[NUMCARDS];		// sameCard[id] = every ID of the card with that ID (more than one for plain chaff)
+
+	ComboMasks() {
+		all         = (1ULL << NUMCARDS) - 1;
+		lights      = CardType::maskOf(&CardType::isLight);
+		rainMan     = CardType::maskOf(&CardType::isRainMan);
+		seeds       = CardType::maskOf(&CardType::isSeed);
+		ribbons     = CardType::maskOf(&CardType::isRibbon);
+		chaff       = CardType::maskOf(&CardType::isChaff);
+		lightning   = CardType::maskOf(&CardType::isLightning);
+		poetry      = CardType::maskOf(&CardType::isPoetryRibbon);
+		blue        = CardType::maskOf(&CardType::isBlueRibbon);
+		inoshikacho = CardType::maskOf(&CardType::isBoar) | CardType::maskOf(&CardType::isDeer) | CardType::maskOf(&CardType::isButterflies);
+		sakura      = CardType::maskOf(&CardType::isSakeCup) | (CardType::maskOf(&CardType::isDryLight) & (0xFULL << 8));		// Sake Cup & Curtain (MAR)
+		moon        = CardType::maskOf(&CardType::isSakeCup) | (CardType::maskOf(&CardType::isDryLight) & (0xFULL << 28));	// Sake Cup & Moon (AUG)
+		rainy       = CardType::maskOf(&CardType::isRainy);
+		months[0]   = 0;
+		for (int m = JAN; m <= DEC; m++) {
+			months[m] = 0xFULL << ((m - JAN) * 4);
+		}
+		for (int id = 0; id < NUMCARDS; id++) {
+			CardType card = CardType::fromId(id);
+			sameCard[id] = ((1ULL << card.cardIdCount()) - 1) << card.cardId();
+		}
+	}
+};
+
+static const ComboMasks &comboMasks() {
+	static const ComboMasks masks;		// built on first use
+	return masks;
+}
+
+static inline int countOf(CardMask cards) {
+	return __builtin_popcountll(cards);
+}
+
+// running counts of the cards in a score pile that matter for its combos; a greedy decision counts the pile once,
+// then only adds the one or two cards each candidate move would capture
+struct ComboCounts {
+	int		lights, seeds, ribbons, chaff;
+	int		inoshikacho, poetry, blue, sakura, moon;
+	bool	rainMan, rainy;
+
+	explicit ComboCounts(CardMask pile) {
+		const ComboMasks &m = comboMasks();
+		lights      = countOf(pile & m.lights);
+		seeds       = countOf(pile & m.seeds);
+		ribbons     = countOf(pile & m.ribbons);
+		chaff       = countOf(pile & m.chaff);
+		inoshikacho = countOf(pile & m.inoshikacho);
+		poetry      = countOf(pile & m.poetry);
+		blue        = countOf(pile & m.blue);
+		sakura      = countOf(pile & m.sakura);
+		moon        = countOf(pile & m.moon);
+		rainMan     = (pile & m.rainMan) != 0;
+		rainy       = (pile & m.rainy) != 0;
+	}
+
+	// counts one more card (given as its bit)
+	void add(CardMask card) {
+		const ComboMasks &m = comboMasks();
+		lights      += (card & m.lights) != 0;
+		seeds       += (card & m.seeds) != 0;
+		ribbons     += (card & m.ribbons) != 0;
+		chaff       += (card & m.chaff) != 0;
+		inoshikacho += (card & m.inoshikacho) != 0;
+		poetry      += (card & m.poetry) != 0;
+		blue        += (card & m.blue) != 0;
+		sakura      += (card & m.sakura) != 0;
+		moon        += (card & m.moon) != 0;
+		rainMan      = rainMan || (card & m.rainMan);
+		rainy        = rainy   || (card & m.rainy);
+	}
+};
+
+// "progress" of a score pile towards its combos: the points it is already worth, plus partial credit for each combo it is on the way to
+static double yakuProgress(const ComboCounts &c) {
+	static const double LIGHTCREDIT[6]  = {0.0, 1.0, 2.5, 6.0, 8.0, 15.0};	// (four lights with the Rain Man are worth 7, see below)
+	static const double THREESET[4]     = {0.0, 0.8, 2.2, 5.0};			// Ino-Shika-Cho, Poetry Ribbons, Blue Ribbons
+	static const double VIEWING[3]      = {0.0, 1.0, 5.0};					// Sakura Viewing, Moon Viewing
+	double progress = 0.0;
+
+	progress += (c.lights == 4 && c.rainMan) ? 7.0 : LIGHTCREDIT[c.lights];
+	progress += THREESET[c.inoshikacho] + THREESET[c.poetry] + THREESET[c.blue];
+	if (!c.rainy) {														// a rainy card spoils both viewings
+		progress += VIEWING[c.sakura] + VIEWING[c.moon];
+	}
+	progress += (c.seeds   >= 5) ? c.seeds   - 4 : 0.25 * c.seeds;
+	progress += (c.ribbons >= 5) ? c.ribbons - 4 : 0.25 * c.ribbons;
+	progress += (c.chaff   >= 10) ? c.chaff  - 9 : 0.1  * c.chaff;
+	return progress;
+}
+
+static inline double yakuProgress(CardMask pile) {
+	return yakuProgress(ComboCounts(pile));
+}
+
+// the bit that a card (given by any of its IDs) takes when it is added to the given set (see Hand::addCard())
+static inline CardMask slotIn(int id, CardMask in) {
+	CardMask free = comboMasks().sameCard[id] & ~in;
+	return free & (~free + 1);			// lowest free ID of that card
+}
+
+// the cards the card with the given ID can match on a table (see theseCardsMatch())
+static inline CardMask matchableBy(int id, CardMask table) {
+	const ComboMasks &m = comboMasks();
+	return ((1ULL << id) & m.lightning) ? table : table & m.months[(id >> 2) + JAN];
+}
+
+// index of a card (given by its bit) in a hand, since hands are kept sorted in ID order
+static inline int indexOf(CardMask bit, CardMask in) {
+	return countOf(in & (bit - 1));
+}
+
+static inline int lowestId(CardMask cards) {
+	return __builtin_ctzll(cards);
+}
+
+#define DENYWEIGHT 0.5		// value of keeping a card away from the opponent, relative to taking it for ourselves
+#define FEEDWEIGHT 1.0		// cost of giving the opponent a card, relative to taking it for ourselves
+
+// the cards nobody at the table can see: the opponent's hand, and the deck
+static inline CardMask unseenCards(const TurnView &view) {
+	return comboMasks().all & ~(view.hand.cardMask() | view.table.cardMask() | view.pile.cardMask() | view.oppPile.cardMask());
+}
+
+// everything about the position that does not depend on the move being considered, worked out once per decision
+struct GreedyContext {
+	CardMask	hand, table, pile, opp, unseen;
+	ComboCounts	pileCounts, oppCounts;
+	double		pileProgress, oppProgress;
+	double		oppMatchChance[6];		// chance that the opponent holds at least one of k unseen matching cards, for k = 0 to 5
+
+	explicit GreedyContext(const TurnView &view) : hand(view.hand.cardMask()), table(view.table.cardMask()), pile(view.pile.cardMask()),
+	                                               opp(view.oppPile.cardMask()), unseen(unseenCards(view)), pileCounts(pile), oppCounts(opp) {
+		int total       = countOf(unseen);
+		int oppHandSize = total - view.deckCount;
+		pileProgress = yakuProgress(pileCounts);
+		oppProgress  = yakuProgress(oppCounts);
+		// one minus the chance that none of the k cards are among the opponent's hand: (total-k choose hand) / (total choose hand)
+		double outOf = 1.0;
+		for (int i = 0; i < oppHandSize && i < total; i++) {
+			outOf *= total - i;
+		}
+		for (int k = 0; k < 6; k++) {
+			double none = 1.0;
+			for (int i = 0; i < oppHandSize && i < total; i++) {
+				none *= (total - k - i > 0) ? total - k - i : 0;
+			}
+			oppMatchChance[k] = 1.0 - none / outOf;
+		}
+	}
+
+	// how much the given card(s) would add to our pile / the opponent's pile
+	double gainForUs(CardMask first, CardMask second = 0) const {
+		ComboCounts counts = pileCounts;
+		counts.add(first);
+		if (second) {
+			counts.add(second);
+		}
+		return yakuProgress(counts) - pileProgress;
+	}
+	double gainForOpponent(CardMask card) const {
+		ComboCounts counts = oppCounts;
+		counts.add(card);
+		return yakuProgress(counts) - oppProgress;
+	}
+
+	// rough chance that the opponent holds a card that can match the card with the given ID (one of its month, or the Lightning)
+	double chanceOpponentMatches(int id) const {
+		CardMask lightning = comboMasks().lightning;
+		int matches = countOf((unseen >> (id & ~3)) & 0xF) + ((unseen & lightning) && !((1ULL << id) & lightning) ? 1 : 0);
+		return oppMatchChance[matches];
+	}
+
+	// value of capturing a card together with a table card: what it adds to our pile, plus what it keeps from the opponent
+	double captureValue(int matcher, int target) const {
+		CardMask matcherBit = slotIn(matcher, pile);
+		CardMask targetBit  = slotIn(target, pile | matcherBit);
+		return gainForUs(matcherBit, targetBit)
+		     + DENYWEIGHT * chanceOpponentMatches(target) * gainForOpponent(slotIn(target, opp));
+	}
+};
+
+// picks the hand card & table card whose capture is worth the most
+int GreedyStrategy::chooseHandCardToPlay(const TurnView &view, int &hand_choice) {
+	GreedyContext ctx(view);
+	CardMask best_hand = 0, best_table = 0;
+	double best = -1.0;
+
+	for (CardMask cards = ctx.hand; cards != 0; cards &= cards - 1) {				// for each card in the hand
+		int h = lowestId(cards);
+		for (CardMask targets = matchableBy(h, ctx.table); targets != 0; targets &= targets - 1) {	// for each table card it can match
+			int t = lowestId(targets);
+			double value = ctx.captureValue(h, t);
+			if (value > best) {
+				best       = value;
+				best_hand  = 1ULL << h;
+				best_table = 1ULL << t;
+			}
+		}
+	}
+
+	if (best_hand == 0) {				// nothing in the hand matches anything on the table
+		hand_choice = -1;
+		return -1;
+	}
+	hand_choice = indexOf(best_hand, ctx.hand);
+	return indexOf(best_table, ctx.table);
+}
+
+// picks the table card whose capture with the deck card is worth the most
+int GreedyStrategy::chooseTableCardToMatch(const TurnView &view, const CardType matcher) {
+	GreedyContext ctx(view);
+	int m = matcher.cardId();
+	CardMask best_table = 0;
+	double best = -1.0;
+
+	for (CardMask targets = matchableBy(m, ctx.table); targets != 0; targets &= targets - 1) {
+		int t = lowestId(targets);
+		double value = ctx.captureValue(m, t);
+		if (value > best) {
+			best       = value;
+			best_table = 1ULL << t;
+		}
+	}
+	return (best_table == 0) ? -1 : indexOf(best_table, ctx.table);
+}
+
+// gives up the card that would help the opponent least if they took it, and that we are most likely to win back ourselves
+int GreedyStrategy::chooseHandCard4Table(const TurnView &view) {
+	GreedyContext ctx(view);
+	const ComboMasks &m = comboMasks();
+	CardMask choice = 0;
+	double best_cost = 0.0;
+
+	for (CardMask cards = ctx.hand; cards != 0; cards &= cards - 1) {
+		int h = lowestId(cards);
+		bool canRetake = countOf(ctx.hand & m.months[(h >> 2) + JAN]) > 1;		// we hold another card of this month to take it back with
+		double cost = FEEDWEIGHT * ctx.chanceOpponentMatches(h) * ctx.gainForOpponent(slotIn(h, ctx.opp))
+		            + (canRetake ? 0.0 : ctx.gainForUs(slotIn(h, ctx.pile)));
+		if (choice == 0 || cost < best_cost) {
+			best_cost = cost;
+			choice    = 1ULL << h;
+		}
+	}
+	return indexOf(choice, ctx.hand);
+}
+
+// keeps playing only while the pile is cheap to risk, the opponent is not close to a combo, and there are turns left to improve
+bool GreedyStrategy::callKoiKoi(const TurnView &view, const int rawscore) {
+	if (rawscore >= 7) {									// already doubled: take the points
+		return false;
+	}
+	if (view.hand.cardCount() < 2) {						// no turns left to improve the pile
+		return false;
+	}
+	if (view.oppPile.rawScore() > 0) {						// the opponent can end the round with any new point
+		return false;
+	}
+	if (yakuProgress(view.oppPile.cardMask()) >= 4.0) {		// the opponent is close to a combo
+		return false;
+	}
+	return yakuProgress(view.pile.cardMask()) - rawscore >= 2.0;	// we are close to another combo
+}
+
+/* =====================================
+REGISTRY OF STRATEGIES
+===================================== */
+
+const char *strategyName(StrategyKind kind) {
+	switch (kind) {
+		case CPU_RANDOM:
+			return "Random";
+		case CPU_GREEDY:
+			return "Greedy";
+		default:
+			return "[ERROR in strategyName() in koikoi-strategy.cpp -- Invalid STRATEGY]";
+	}
+}
+
+StrategyKind strategyFromName(const char *name) {
+	for (int k = 0; k < NUMSTRATEGIES; k++) {
+		if (strcasecmp(name, strategyName(static_cast<StrategyKind>(k))) == 0) {
+			return static_cast<StrategyKind>(k);
+		}
+	}
+	return NUMSTRATEGIES;
+}
+
+CPUStrategy *makeStrategy(StrategyKind kind, unsigned int seed) {
+	switch (kind) {
+		case CPU_RANDOM:
+			return new StrategyModel<RandomStrategy, CPU_RANDOM>(seed);
+		case CPU_GREEDY:
+			return new StrategyModel<GreedyStrategy, CPU_GREEDY>(seed);
+		default:
+			return NULL;
+	}
+}
@@ -0,0 +1,146 @@
+#ifndef KOIKOI_STRATEGY_H
+#define KOIKOI_STRATEGY_H
+
+#include <random>
+#include <vector>
+#include "hanafuda-hands.hpp"
+
+/*  ========================================
+CPU STRATEGIES
+A "strategy" is any class that makes the four decisions a CPU player has to make during its turn:
+
+	int  chooseHandCardToPlay(const TurnView &view, int &hand_choice);		// index of the table card to match (or -1), hand_choice updated by reference (or -1)
+	int  chooseTableCardToMatch(const TurnView &view, const CardType matcher);	// index of the table card to match with the card drawn from the deck (or -1)
+	int  chooseHandCard4Table(const TurnView &view);						// index of the hand card to give up to the table
+	bool callKoiKoi(const TurnView &view, const int rawscore);				// true to call Koi-Koi, false to end the round
+
+Each strategy is constructed from a seed, and owns its own random number generator, so that
+strategies in different sessions (or different threads) never share any state.
+
+Code that plays many games in a row should take the concrete strategy as a template parameter,
+so that every decision is an ordinary (inlinable) function call. The server instead picks a
+strategy for each session at runtime, through the CPUStrategy interface at the bottom of this file.
+========================================    */
+
+// everything a strategy is allowed to look at when making a decision
+struct TurnView {
+	const Hand		&hand;			// the deciding player's hand
+	const Hand		&table;			// the cards face-up on the table
+	const ScorePile	&pile;			// the deciding player's score pile
+	const ScorePile	&oppPile;		// the opponent's score pile
+	int				deckCount;		// # of cards left in the draw pile
+	bool			oppCalledKK;	// whether the opponent has called Koi-Koi this round
+};
+
+/*  ========================================
+RANDOM STRATEGY ("easy")
+Plays any legal card at random, and calls Koi-Koi more often the more points it already has.
+========================================    */
+class RandomStrategy {
+private:
+	std::mt19937		rng;
+	std::vector<int>	matching_cards;		// indices of the table cards that can be matched (kept between turns, so it never reallocates)
+public:
+	explicit RandomStrategy(unsigned int seed) : rng(seed) {
+		matching_cards.reserve(NUMCARDS);
+	}
+
+	int  chooseHandCardToPlay(const TurnView &view, int &hand_choice);
+	int  chooseTableCardToMatch(const TurnView &view, const CardType matcher);
+	int  chooseHandCard4Table(const TurnView &view);
+	bool callKoiKoi(const TurnView &view, const int rawscore);
+};
+
+/*  ========================================
+GREEDY STRATEGY ("normal")
+Looks one move ahead: every candidate move is scored by how much closer it brings the score pile to its combos
+(see yakuProgress() in "koikoi-strategy.cpp"), plus how much it keeps away from the opponent's combos.
+A card given up to the table is chosen to feed the opponent as little as possible.
+Everything is computed from the hands' sets of card IDs, so a decision takes a few dozen bit operations per candidate.
+========================================    */
+class GreedyStrategy {
+public:
+	explicit GreedyStrategy(unsigned int seed) {}		// (makes no random choices, so the seed is unused)
+
+	int  chooseHandCardToPlay(const TurnView &view, int &hand_choice);
+	int  chooseTableCardToMatch(const TurnView &view, const CardType matcher);
+	int  chooseHandCard4Table(const TurnView &view);
+	bool callKoiKoi(const TurnView &view, const int rawscore);
+};
+
+/*  ========================================
+REGISTRY OF STRATEGIES
+Add new strategies to StrategyKind, visitStrategy(), and to strategyName() & makeStrategy() (in "koikoi-strategy.cpp").
+========================================    */
+enum StrategyKind {
+	CPU_RANDOM		=0,
+	CPU_GREEDY		=1,
+	NUMSTRATEGIES			// (not a strategy) number of registered strategies
+};
+
+const char *strategyName(StrategyKind kind);			// short human-readable name of the strategy, e.g. "Random"
+StrategyKind strategyFromName(const char *name);		// the strategy with the given name (case-insensitive), or NUMSTRATEGIES if there is none
+
+// constructs a concrete strategy of the given kind and calls visit(strategy) with it, so that template code
+// can pick its strategies at runtime and still make every decision without a virtual call
+template <class Visitor>
+void visitStrategy(StrategyKind kind, unsigned int seed, Visitor &&visit) {
+	switch (kind) {
+		case CPU_RANDOM: {
+			RandomStrategy strategy(seed);
+			visit(strategy);
+			return;
+		}
+		case CPU_GREEDY: {
+			GreedyStrategy strategy(seed);
+			visit(strategy);
+			return;
+		}
+		default:
+			return;
+	}
+}
+
+/*  ========================================
+RUNTIME INTERFACE
+Lets the server hold "some strategy" chosen at runtime. StrategyModel<S> wraps any concrete strategy S,
+and is marked final so that calls made through a StrategyModel<S> directly can still be devirtualized.
+========================================    */
+class CPUStrategy {
+public:
+	virtual ~CPUStrategy() {}
+
+	virtual int  chooseHandCardToPlay(const TurnView &view, int &hand_choice) = 0;
+	virtual int  chooseTableCardToMatch(const TurnView &view, const CardType matcher) = 0;
+	virtual int  chooseHandCard4Table(const TurnView &view) = 0;
+	virtual bool callKoiKoi(const TurnView &view, const int rawscore) = 0;
+	virtual StrategyKind kind() const = 0;
+};
+
+template <class Strategy, StrategyKind KIND>
+class StrategyModel final : public CPUStrategy {
+private:
+	Strategy strategy;
+public:
+	explicit StrategyModel(unsigned int seed) : strategy(seed) {}
+
+	int chooseHandCardToPlay(const TurnView &view, int &hand_choice) override {
+		return strategy.chooseHandCardToPlay(view, hand_choice);
+	}
+	int chooseTableCardToMatch(const TurnView &view, const CardType matcher) override {
+		return strategy.chooseTableCardToMatch(view, matcher);
+	}
+	int chooseHandCard4Table(const TurnView &view) override {
+		return strategy.chooseHandCard4Table(view);
+	}
+	bool callKoiKoi(const TurnView &view, const int rawscore) override {
+		return strategy.callKoiKoi(view, rawscore);
+	}
+	StrategyKind kind() const override {
+		return KIND;
+	}
+};
+
+CPUStrategy *makeStrategy(StrategyKind kind, unsigned int seed);	// returns a new'd strategy of the given kind (caller must delete it), or NULL if kind is invalid
+
+#endif
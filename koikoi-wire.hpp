@@ -0,0 +1,116 @@
+#ifndef KOIKOI_WIRE_H
+#define KOIKOI_WIRE_H
+
+#include "hanafuda-card.hpp"
+
+/*  ========================================
+THE BINARY PROTOCOL
+The server speaks text to a client unless it asks otherwise: a client can start its answer to the name prompt (the
+first thing the server sends) with a handshake byte, made of these flags:
+	WIREHELLO		the binary protocol, from then on
+	WIREDELTAS		only what has changed in the hands, table & score piles since the client was last shown them
+	WIREJSON		the JSON protocol (see "serv-json.hpp"): the same frames, each as a line of JSON (not with WIREHELLO)
+The rest of that line is the name, or "resume <token>", as usual; a client can send the line straight after
+connecting, and skip the server's first line of text. A binary client is then sent WIRE_HELLO, and nothing but frames.
+
+With WIREDELTAS, each of the hands, the table & the score piles is sent in full the first time in each round (and
+after a game is resumed), and after that as a WIRE_DELTA of the cards that have come & gone, or not at all if none
+have. A text client is sent the cards added to the score piles, rather than the whole piles (the hand & table are
+still listed in full, since they are answered by index). A binary client that loses track can send WIRE_REFRESH
+instead of an answer: it is sent everything in full, and the server goes on waiting for its answer.
+
+Every frame is a u8 type and a u8 # of payload bytes, then the payload; each type's payload is always the same size
+(but for the text at the end of some), so a client that doesn't know a type can skip it. Numbers are little-endian.
+Cards are their 1-byte IDs (see CardType::cardId(), or WIRENOCARD for none), and sets of cards are u64 CardMasks.
+Seats are 0 for the client and 1 for its opponent (the CPU, or another client in the arena: see "serv-match.hpp").
+
+The client only ever sends WIRE_ANSWER, once for each WIRE_PROMPT. Prompts for a card are answered with a card ID
+(a hand card to play or give up, or the table card to match), and others with a number (as in the text protocol);
+either way, the answer must be one of the prompt's choices, or the server sends WIRE_REJECT and the prompt again.
+========================================    */
+
+#define WIREHELLO		0x01		// handshake flags
+#define WIREDELTAS		0x02
+#define WIREJSON		0x04
+#define WIREVERSION		1
+#define WIRENOCARD		0xFF
+#define WIREHEADER		2			// bytes before each frame's payload
+#define WIREMAXFRAME	(WIREHEADER + 255)
+
+// server -> client					   payload
+enum WireMessage {
+	WIRE_HELLO		= 1,			// u8 protocol version, u8 the handshake flags in effect
+	WIRE_TOKEN		= 2,			// u64 the game's token (to resume it with)
+	WIRE_RESUMED	= 3,			// (nothing: the game has been resumed, and the state of it follows)
+	WIRE_OPTION		= 4,			// u8 #, then its name (the choices of opponent, before that prompt)
+	WIRE_ROUND		= 5,			// u8 round #
+	WIRE_DEALER		= 6,			// u8 seat that deals this round
+	WIRE_INSTANTWIN	= 7,			// u8 seat dealt an instant win (2 = the table, and the round is dealt again), u8 four of a kind (1) or four pairs (0)
+	WIRE_HAND		= 8,			// u8 seat, u64 the cards in its hand
+	WIRE_TABLE		= 9,			// u64 the cards on the table
+	WIRE_PILE		= 10,			// u8 seat, u64 the cards in its score pile, u8 raw points, u8 points with bonuses
+	WIRE_PLAY		= 11,			// u8 seat, u8 card played from its hand, u8 table card it took (WIRENOCARD: added to the table)
+	WIRE_DRAW		= 12,			// u8 seat, u8 card drawn from the deck, u8 table card it took (WIRENOCARD: added to the table)
+	WIRE_KOIKOI		= 13,			// u8 seat, u8 called Koi-Koi (1) or ended the round (0)
+	WIRE_POINTS		= 14,			// u8 seat that scored (WIRENOCARD: nobody did), u8 points
+	WIRE_STANDINGS	= 15,			// u16 client's score, u16 opponent's score
+	WIRE_FINAL		= 16,			// u16 client's score, u16 opponent's score, u8 # of rounds
+	WIRE_LEADERS	= 17,			// u32 # of players on the leaderboard (the rows follow)
+	WIRE_LEADER		= 18,			// u32 rank, u32 wins, u32 games, u32 points per round x 1000, then the name
+	WIRE_PROMPT		= 19,			// u8 WirePrompt, u8 card being matched (or WIRENOCARD), u64 the choices (card IDs, or numbers)
+	WIRE_REJECT		= 20,			// (nothing: the answer was not one of the choices)
+	WIRE_DELTA		= 21,			// u8 type of the frame it updates (WIRE_HAND, WIRE_TABLE or WIRE_PILE), u8 seat (0 for the table),
+									// u8 raw points, u8 points with bonuses (0 but for a pile), then for each card that changed,
+									// u8 its ID (added) or its ID | WIREREMOVED (removed)
+	WIRE_OPPONENT	= 22,			// u8 # of the opponent (as numbered by WIRE_OPTION), then its name (the CPU strategy's, or
+									// the other client's leaderboard name)
+	WIRE_ABANDONED	= 23,			// (nothing: the opponent's connection was lost, and the game is over, unscored)
+	WIRE_WATCHING	= 24			// u8 # of the featured game being watched (0: none is being played), u8 # of rounds, then the
+									// name of the player whose seat it is watched from (see "serv-watch.hpp")
+};
+#define WIREREMOVED		0x80
+
+// client -> server
+#define WIRE_ANSWER		0x80		// u8 card ID or number (or, for WIREPROMPT_NAME, the text of the answer)
+#define WIRE_REFRESH	0x81		// (nothing: send everything again in full)
+
+// what a WIRE_PROMPT asks for
+enum WirePrompt {
+	WIREPROMPT_NAME		= 1,		// a leaderboard name, or "resume <token>" (no choices: any text)
+	WIREPROMPT_ROUNDS	= 2,		// # of rounds, 1-12
+	WIREPROMPT_STRATEGY	= 3,		// opponent (a CPU strategy, or the arena), as numbered by WIRE_OPTION
+	WIREPROMPT_PLAY		= 4,		// a hand card to match with the table (the choices are the ones that can)
+	WIREPROMPT_MATCH	= 5,		// a table card to match the given card with
+	WIREPROMPT_GIVEUP	= 6,		// a hand card to add to the table, when none of them match
+	WIREPROMPT_KOIKOI	= 7,		// 1 to call Koi-Koi, 2 to end the round
+	WIREPROMPT_AFTER	= 8			// 1 to see the leaderboard, 2 to quit, 3 to play again (with the same settings)
+};
+
+/* =====================================
+BUILDING & READING FRAMES
+===================================== */
+
+// one frame, built up a field at a time
+struct WireFrame {
+	unsigned char	bytes[WIREMAXFRAME];
+	int				length;
+
+	explicit WireFrame(int type) : length(WIREHEADER) { bytes[0] = type; bytes[1] = 0; }
+
+	WireFrame &u8(unsigned int value)		{ bytes[length++] = value; bytes[1]++; return *this; }
+	WireFrame &u16(unsigned int value)		{ return u8(value & 0xFF).u8(value >> 8); }
+	WireFrame &u32(unsigned int value)		{ return u16(value & 0xFFFF).u16(value >> 16); }
+	WireFrame &u64(unsigned long long value){ return u32(value & 0xFFFFFFFF).u32(value >> 32); }
+	WireFrame &text(const char *text, int n) {
+		for (int i = 0; i < n && length < WIREMAXFRAME; i++) {
+			u8(static_cast<unsigned char>(text[i]));
+		}
+		return *this;
+	}
+};
+
+inline unsigned int       wireU16(const unsigned char *p) { return p[0] | (p[1] << 8); }
+inline unsigned int       wireU32(const unsigned char *p) { return wireU16(p) | (wireU16(p + 2) << 16); }
+inline unsigned long long wireU64(const unsigned char *p) { return wireU32(p) | (static_cast<unsigned long long>(wireU32(p + 4)) << 32); }
+
+#endif
@@ -0,0 +1,75 @@
+#include "latency-histogram.hpp"
+#include <cstring>
+
+LatencyHistogram::LatencyHistogram() {
+	clear();
+}
+
+void LatencyHistogram::clear() {
+	memset(counts, 0, sizeof(counts));
+	total    = 0;
+	sum      = 0;
+	maxValue = 0;
+	return;
+}
+
+// the middle of the range of values that fall in the bucket (the inverse of bucketOf())
+unsigned long long LatencyHistogram::bucketMiddle(int bucket) {
+	if (bucket < 2 * LATENCYSUBBUCKETS) {
+		return bucket;
+	}
+	int shift = bucket / LATENCYSUBBUCKETS - 1;
+	unsigned long long low = static_cast<unsigned long long>(bucket - shift * LATENCYSUBBUCKETS) << shift;
+	return low + ((1ULL << shift) >> 1);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+	for (int b = 0; b < LATENCYBUCKETS; b++) {
+		counts[b] += other.counts[b];
+	}
+	total   += other.total;
+	sum     += other.sum;
+	maxValue = (other.maxValue > maxValue) ? other.maxValue : maxValue;
+	return;
+}
+
+double LatencyHistogram::mean() const {
+	return (total == 0) ? 0.0 : static_cast<double>(sum) / total;
+}
+
+unsigned long long LatencyHistogram::percentile(double p) const {
+	if (total == 0) {
+		return 0;
+	}
+	long rank = static_cast<long>(p / 100.0 * total + 0.5);		// # of values that must be at or below the answer
+	rank = (rank < 1) ? 1 : rank;
+	long seen = 0;
+	for (int b = 0; b < LATENCYBUCKETS; b++) {
+		seen += counts[b];
+		if (seen >= rank) {
+			unsigned long long middle = bucketMiddle(b);
+			return (middle < maxValue) ? middle : maxValue;			// never report more than was actually seen
+		}
+	}
+	return maxValue;
+}
+
+AtomicLatencyHistogram::AtomicLatencyHistogram() {
+	for (int b = 0; b < LATENCYBUCKETS; b++) {
+		counts[b].store(0, std::memory_order_relaxed);
+	}
+	total.store(0, std::memory_order_relaxed);
+	sum.store(0, std::memory_order_relaxed);
+	maxValue.store(0, std::memory_order_relaxed);
+}
+
+void AtomicLatencyHistogram::addTo(LatencyHistogram &histogram) const {
+	for (int b = 0; b < LATENCYBUCKETS; b++) {
+		histogram.counts[b] += counts[b].load(std::memory_order_relaxed);
+	}
+	histogram.total += total.load(std::memory_order_relaxed);
+	histogram.sum   += sum.load(std::memory_order_relaxed);
+	unsigned long long largest = maxValue.load(std::memory_order_relaxed);
+	histogram.maxValue = (largest > histogram.maxValue) ? largest : histogram.maxValue;
+	return;
+}
@@ -0,0 +1,82 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+/*  ========================================
+LATENCY HISTOGRAM
+Counts durations (in nanoseconds) in log-linear buckets, like an HDR histogram: every power of two is split
+into 32 equal buckets, so any percentile read back is within about 3% of the true value, from 1 ns up to hours,
+in a fixed 16 KB with no allocation. Recording is a handful of instructions, so each thread can keep its own
+histograms and merge them when somebody asks for the totals.
+========================================    */
+
+#include <atomic>
+
+#define LATENCYSUBBITS 5								// each power of two is split into 2^LATENCYSUBBITS buckets
+#define LATENCYSUBBUCKETS (1 << LATENCYSUBBITS)
+#define LATENCYBUCKETS ((64 - LATENCYSUBBITS) * LATENCYSUBBUCKETS + LATENCYSUBBUCKETS)	// enough for any 64-bit value
+
+class LatencyHistogram {
+	friend class AtomicLatencyHistogram;
+private:
+	long				counts[LATENCYBUCKETS];
+	long				total;					// # of values recorded
+	unsigned long long	sum;					// sum of all values recorded (for the mean)
+	unsigned long long	maxValue;				// largest value recorded
+
+	static unsigned long long bucketMiddle(int bucket);			// the value reported for everything in a bucket
+public:
+	static int bucketOf(unsigned long long ns);					// the bucket that a value goes in
+
+	LatencyHistogram();							// starts out empty
+	void clear();								// empties the histogram
+
+	void record(unsigned long long ns) {		// counts one value (in-line, since it is on every hot path that is measured)
+		counts[bucketOf(ns)]++;
+		total++;
+		sum += ns;
+		maxValue = (ns > maxValue) ? ns : maxValue;
+	}
+	void merge(const LatencyHistogram &other);	// adds every value in the other histogram to this one
+
+	long count() const { return total; }
+	double mean() const;						// mean of all values, or 0 if there are none
+	unsigned long long max() const { return maxValue; }
+	unsigned long long percentile(double p) const;	// the value that p% of all values are at or below (p from 0 to 100), or 0 if there are none
+};
+
+// the same histogram, for exactly one thread to record into while any other thread reads it.
+// Every count is a relaxed atomic that only its owner writes, so recording takes no lock and no read-modify-write.
+class AtomicLatencyHistogram {
+private:
+	std::atomic<long>				counts[LATENCYBUCKETS];
+	std::atomic<long>				total;
+	std::atomic<unsigned long long>	sum;
+	std::atomic<unsigned long long>	maxValue;
+
+	template <class T>
+	static void add(std::atomic<T> &counter, T n) {		// counter += n, for the one thread that writes it
+		counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+public:
+	AtomicLatencyHistogram();					// starts out empty
+
+	void record(unsigned long long ns) {		// counts one value (only ever from the owning thread)
+		add(counts[LatencyHistogram::bucketOf(ns)], 1L);
+		add(total, 1L);
+		add(sum, ns);
+		if (ns > maxValue.load(std::memory_order_relaxed)) {
+			maxValue.store(ns, std::memory_order_relaxed);
+		}
+	}
+	void addTo(LatencyHistogram &histogram) const;	// adds what has been recorded so far into a plain histogram (from any thread)
+};
+
+inline int LatencyHistogram::bucketOf(unsigned long long ns) {
+	if (ns < 2 * LATENCYSUBBUCKETS) {
+		return static_cast<int>(ns);			// small values get a bucket each
+	}
+	int shift = (63 - __builtin_clzll(ns)) - LATENCYSUBBITS;	// how much of the value is below the bucket's resolution
+	return shift * LATENCYSUBBUCKETS + static_cast<int>(ns >> shift);
+}
+
+#endif
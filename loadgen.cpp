@@ -0,0 +1,642 @@
+//loadgen.cpp
+// Load generator for hserver.out: opens several connections at once, and on each one plays whole games by reading the
+// server's prompts and answering them with legal moves, as fast as the server will go. Reports games per second, how long
+// the server takes to come back with its next prompt after each answer, and (given its pid) the server's CPU time per game.
+// It speaks either the text protocol, as a person's client would, or (with -B) the binary one, or (with -J) JSON lines,
+// and can ask (with -D) for only what changes in the listings. With -A, its bots play each other in the server's arena
+// rather than the CPU, game after game on one connection. With -W, more connections watch the featured games as they
+// are played, to load the server's spectator fan-out alongside the players.
+extern "C" {
+#include "csapp.h"
+}
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include "hanafuda-card.hpp"
+#include "koikoi-rules.hpp"
+#include "koikoi-strategy.hpp"
+#include "latency-histogram.hpp"
+#include "koikoi-wire.hpp"
+
+// settings for a load test
+struct LoadConfig {
+    char    *host;
+    char    *port;
+    int     connections;        // # of connections kept open at once (one thread each)
+    long    games;              // total # of games to play
+    int     rounds;             // rounds per game
+    int     strategy;           // CPU strategy to ask for (1 to NUMSTRATEGIES, as numbered in the server's prompt)
+    int     players;            // # of leaderboard names the games are spread over (0 = play unranked)
+    bool    binary;             // whether to speak the binary protocol (see koikoi-wire.hpp)
+    bool    json;               // whether to speak the JSON protocol (see serv-json.hpp)
+    bool    deltas;             // whether to ask for only what changes in the hands, table & piles
+    bool    arena;              // whether to play in the arena (against the other connections), back to back on one connection
+    int     spectators;         // # of connections watching featured games as they are played (one thread each)
+};
+
+// everything one connection thread measures
+struct LoadWorker {
+    const LoadConfig    *config;
+    std::atomic<long>   *nextGame;      // shared: # of games handed out so far
+    LatencyHistogram    latency;        // time from sending an answer to receiving the next prompt
+    long                games;
+    long                prompts;
+    long                retries;        // answers the server turned down (should stay 0)
+    long                failures;       // games cut short by a connection error (the bot's, or in the arena its opponent's)
+    long                unpaired;       // games in the arena played against the CPU, for want of an opponent
+    long                bytesIn, bytesOut;
+
+    LoadWorker() : config(NULL), nextGame(NULL), games(0), prompts(0), retries(0), failures(0), unpaired(0), bytesIn(0), bytesOut(0) {}
+};
+
+/* =====================================
+READING THE SERVER'S TEXT
+The server sends '\t' for every line break except the one that ends a prompt, so one read up to '\n' is
+everything it said since the last answer. Card listings look like " (3)  <card name>".
+===================================== */
+
+// card name (as CardType::cardName() writes it) -> card ID
+static std::map<std::string, int> cardNames;
+
+static void makeCardNames() {
+    for (int id = 0; id < NUMCARDS; id++) {
+        cardNames[CardType::fromId(id).cardName()] = id;
+    }
+    return;
+}
+
+// what the bot knows about the game so far, from the listings the server has sent
+struct BotView {
+    enum Listing { NONE, TABLE, HAND, OPTIONS };
+    Listing             listing;        // the listing currently being read
+    std::vector<int>    table;          // card IDs on the table, in the server's order
+    std::vector<int>    hand;           // card IDs in our hand, in the server's order
+    std::vector<int>    options;        // table indices offered for the current match
+    int                 retry;          // # of answers turned down in a row
+
+    BotView() : listing(NONE), retry(0) {}
+    void readLine(const char *line);
+};
+
+static bool startsWith(const char *text, const char *prefix) {
+    return strncmp(text, prefix, strlen(prefix)) == 0;
+}
+
+void BotView::readLine(const char *line) {
+    int index, chars;
+    if (sscanf(line, " (%d)  %n", &index, &chars) == 1 && listing != NONE) {       // one card of a listing
+        std::map<std::string, int>::const_iterator card = cardNames.find(line + chars);
+        if (listing == OPTIONS) {
+            options.push_back(index);
+        } else if (card != cardNames.end()) {
+            (listing == TABLE ? table : hand).push_back(card->second);
+        }
+        return;
+    }
+    listing = NONE;
+    if (startsWith(line, "These are the cards on the table that you can match:")) {
+        listing = OPTIONS;
+        options.clear();
+    } else if (startsWith(line, "These are the cards on the table:")) {
+        listing = TABLE;
+        table.clear();
+    } else if (startsWith(line, "These are the cards in your hand:")) {
+        listing = HAND;
+        hand.clear();
+    } else if (strstr(line, "Please try again") || strstr(line, "not a valid") || strstr(line, "Please enter a different card")) {
+        retry++;
+    }
+    return;
+}
+
+// the answer to a prompt, given everything the server sent since the last answer; returns false at the end of the game
+static bool answerPrompt(const LoadConfig &config, BotView &view, const char *prompt, char *answer, long game) {
+    int choice = view.retry;                        // if an answer was turned down, step through the others
+    if (strstr(prompt, "or 99 to quit.")) {
+        strcpy(answer, "99\n");
+        return false;
+    } else if (strstr(prompt, "on the leaderboard under?")) {
+        char *name = answer;
+        if (config.deltas) {
+            *name++ = WIREDELTAS;                   // (the handshake byte)
+        }
+        if (config.players > 0) {
+            sprintf(name, "loadgen-%ld\n", game % config.players);
+        } else {
+            strcpy(name, "\n");
+        }
+        return true;
+    } else if (strstr(prompt, "Enter a number 1-12:")) {
+        choice = config.rounds;
+    } else if (strstr(prompt, "Enter a number 1-")) {
+        choice = config.strategy;
+    } else if (strstr(prompt, "to call Koi-Koi, or [2] to end the round")) {
+        choice = 2;                                 // always cash in, so games take a steady # of prompts
+    } else if (strstr(prompt, "use for matching?")) {
+        for (size_t h = 0; h < view.hand.size() && view.retry == 0; h++) {      // the first hand card that matches something
+            for (size_t t = 0; t < view.table.size(); t++) {
+                if (theseCardsMatch(CardType::fromId(view.hand[h]), CardType::fromId(view.table[t]))) {
+                    choice = h;
+                    t = view.table.size();
+                    h = view.hand.size();
+                }
+            }
+        }
+    } else if (strstr(prompt, "index of the table card")) {
+        choice = view.options.empty() ? view.retry : view.options[view.retry % view.options.size()];
+    }
+    sprintf(answer, "%d\n", choice);
+    return true;
+}
+
+/* =====================================
+PLAYING GAMES
+===================================== */
+
+static long nanosSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// plays one whole game (the game-th) on a new connection; returns false if the connection failed partway
+static bool playOneGame(LoadWorker &worker, long game) {
+    const LoadConfig &config = *worker.config;
+    char buf[MAXLINE], answer[32];
+    std::string text;
+    BotView view;
+    rio_t rio;
+
+    int fd = open_clientfd(config.host, config.port);
+    if (fd < 0) {
+        return false;
+    }
+    Rio_readinitb(&rio, fd);
+    std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
+    bool playing = true;
+
+    while (playing) {
+        // read everything up to the next prompt (more than one buffer's worth, if need be)
+        text.clear();
+        do {
+            ssize_t n = rio_readlineb(&rio, buf, sizeof(buf));
+            if (n <= 0) {
+                close(fd);
+                return false;
+            }
+            worker.bytesIn += n;
+            text.append(buf, n);
+        } while (text[text.length()-1] != '\n');
+        worker.latency.record(nanosSince(sent));
+        worker.prompts++;
+
+        // take in every line the server sent, then answer the prompt at the end of them
+        int retries_before = view.retry;
+        size_t start = 0, tab;
+        while ((tab = text.find('\t', start)) != std::string::npos) {
+            text[tab] = '\0';
+            view.readLine(text.c_str() + start);
+            start = tab + 1;
+        }
+        for (size_t c = 0; c < start; c++) {
+            text[c] = (text[c] == '\0') ? '\t' : text[c];     // put the line breaks back, since a prompt can span more than one line
+        }
+        if (view.retry == retries_before) {
+            view.retry = 0;                         // the last answer was accepted
+        } else {
+            worker.retries++;
+        }
+        playing = answerPrompt(config, view, text.c_str(), answer, game);
+
+        sent = std::chrono::steady_clock::now();
+        if (rio_writen(fd, answer, strlen(answer)) < 0) {
+            close(fd);
+            return false;
+        }
+        worker.bytesOut += strlen(answer);
+    }
+
+    while (rio_readlineb(&rio, buf, sizeof(buf)) > 0) {}       // wait for the server to hang up
+    close(fd);
+    return true;
+}
+
+// the answer to the prompt after a game: in the arena, 3 (play again on the same connection) while there are games
+// left to hand out, counting the one just played; otherwise 2 (quit), and the game is counted by loadThread()
+static int playAgain(LoadWorker &worker, bool &abandoned) {
+    if (!worker.config->arena || worker.nextGame->fetch_add(1) >= worker.config->games) {
+        return 2;
+    }
+    if (abandoned) {
+        worker.failures++;
+    } else {
+        worker.games++;
+    }
+    abandoned = false;
+    return 3;
+}
+
+// the same, over the binary protocol: every prompt carries its choices, so the bot needs to keep no view of the game
+static bool playOneGameBinary(LoadWorker &worker, long game) {
+    const LoadConfig &config = *worker.config;
+    unsigned char frame[WIREMAXFRAME], answer[WIREHEADER + 1] = {WIRE_ANSWER, 1, 0};
+    char hello[64];
+    int arenaOption = 0;                            // the arena's # among the opponents (once the bot has picked it)
+    bool abandoned = false;                         // whether the game was cut short by the opponent
+    rio_t rio;
+
+    int fd = open_clientfd(config.host, config.port);
+    if (fd < 0) {
+        return false;
+    }
+    Rio_readinitb(&rio, fd);
+    // ask for the binary protocol along with the name, then skip the text prompt the server sent before it knew
+    int handshake = WIREHELLO | (config.deltas ? WIREDELTAS : 0);
+    if (config.players > 0) {
+        sprintf(hello, "%cloadgen-%ld\n", handshake, game % config.players);
+    } else {
+        sprintf(hello, "%c\n", handshake);
+    }
+    std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
+    if (rio_writen(fd, hello, strlen(hello)) < 0 || rio_readlineb(&rio, reinterpret_cast<char*>(frame), sizeof(frame)) <= 0) {
+        close(fd);
+        return false;
+    }
+    worker.bytesOut += strlen(hello);
+
+    while (true) {
+        if (rio_readnb(&rio, frame, WIREHEADER) != WIREHEADER || rio_readnb(&rio, frame + WIREHEADER, frame[1]) != frame[1]) {
+            close(fd);
+            return false;
+        }
+        worker.bytesIn += WIREHEADER + frame[1];
+        if (frame[0] == WIRE_REJECT) {
+            worker.retries++;
+            continue;
+        } else if (frame[0] == WIRE_OPPONENT) {
+            worker.unpaired += (config.arena && frame[WIREHEADER] != arenaOption);
+            continue;
+        } else if (frame[0] == WIRE_ABANDONED) {
+            abandoned = true;
+            continue;
+        } else if (frame[0] != WIRE_PROMPT) {
+            continue;
+        }
+        worker.latency.record(nanosSince(sent));
+        worker.prompts++;
+
+        const unsigned char *prompt = frame + WIREHEADER;
+        unsigned long long choices = wireU64(prompt + 2);
+        switch (prompt[0]) {
+            case WIREPROMPT_ROUNDS:     answer[2] = config.rounds;          break;
+            case WIREPROMPT_STRATEGY:                                                   // (the arena is the last choice)
+                answer[2] = arenaOption = config.arena ? 63 - __builtin_clzll(choices) : config.strategy;
+                break;
+            case WIREPROMPT_KOIKOI:     answer[2] = 2;                      break;      // always cash in, as the text bot does
+            case WIREPROMPT_AFTER:      answer[2] = playAgain(worker, abandoned); break;
+            default:                    answer[2] = __builtin_ctzll(choices); break;    // the first card that can be played
+        }
+        sent = std::chrono::steady_clock::now();
+        if (rio_writen(fd, answer, sizeof(answer)) < 0) {
+            close(fd);
+            return false;
+        }
+        worker.bytesOut += sizeof(answer);
+        if (prompt[0] == WIREPROMPT_AFTER && answer[2] != 3) {
+            break;
+        }
+    }
+
+    while (rio_readnb(&rio, frame, sizeof(frame)) > 0) {}       // wait for the server to hang up
+    close(fd);
+    return !abandoned;
+}
+
+// the same, over the JSON protocol: like the binary bot, it only looks at prompts (and rejects)
+static bool playOneGameJson(LoadWorker &worker, long game) {
+    const LoadConfig &config = *worker.config;
+    char line[MAXLINE], answer[32];
+    int arenaOption = 0;
+    bool abandoned = false;
+    rio_t rio;
+
+    int fd = open_clientfd(config.host, config.port);
+    if (fd < 0) {
+        return false;
+    }
+    Rio_readinitb(&rio, fd);
+    int handshake = WIREJSON | (config.deltas ? WIREDELTAS : 0);
+    if (config.players > 0) {
+        sprintf(line, "%cloadgen-%ld\n", handshake, game % config.players);
+    } else {
+        sprintf(line, "%c\n", handshake);
+    }
+    std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
+    int length = strlen(line);
+    if (rio_writen(fd, line, length) < 0 || rio_readlineb(&rio, line, sizeof(line)) <= 0) {
+        close(fd);
+        return false;
+    }
+    worker.bytesOut += length;
+
+    while (true) {
+        ssize_t n = rio_readlineb(&rio, line, sizeof(line));
+        if (n <= 0) {
+            close(fd);
+            return false;
+        }
+        worker.bytesIn += n;
+        if (startsWith(line, "{\"event\":\"reject\"")) {
+            worker.retries++;
+            continue;
+        } else if (startsWith(line, "{\"event\":\"opponent\"")) {
+            worker.unpaired += (config.arena && atoi(strstr(line, "\"number\":") + 9) != arenaOption);
+            continue;
+        } else if (startsWith(line, "{\"event\":\"abandoned\"")) {
+            abandoned = true;
+            continue;
+        } else if (!startsWith(line, "{\"event\":\"prompt\"")) {
+            continue;
+        }
+        worker.latency.record(nanosSince(sent));
+        worker.prompts++;
+
+        const char *kind = strstr(line, "\"kind\":\"") + 8;
+        const char *choices = strstr(line, "\"choices\":[") + 11;
+        int choice;
+        if (startsWith(kind, "rounds\"")) {
+            choice = config.rounds;
+        } else if (startsWith(kind, "strategy\"")) {
+            const char *last = strchr(choices, ']');    // (the arena is the last choice)
+            while (last > choices && last[-1] != ',') {
+                last--;
+            }
+            choice = arenaOption = config.arena ? atoi(last) : config.strategy;
+        } else if (startsWith(kind, "koikoi\"")) {
+            choice = 2;                                 // always cash in, as the text bot does
+        } else if (startsWith(kind, "after\"")) {
+            choice = playAgain(worker, abandoned);
+        } else {
+            choice = atoi(choices);                     // the first card that can be played
+        }
+        sprintf(answer, "{\"answer\":%d}\n", choice);
+        sent = std::chrono::steady_clock::now();
+        length = strlen(answer);
+        if (rio_writen(fd, answer, length) < 0) {
+            close(fd);
+            return false;
+        }
+        worker.bytesOut += length;
+        if (startsWith(kind, "after\"") && choice != 3) {
+            break;
+        }
+    }
+
+    while (rio_readlineb(&rio, line, sizeof(line)) > 0) {}       // wait for the server to hang up
+    close(fd);
+    return !abandoned;
+}
+
+static void *loadThread(void *vargp) {
+    LoadWorker *worker = static_cast<LoadWorker*>(vargp);
+    long game;
+    while ((game = worker->nextGame->fetch_add(1)) < worker->config->games) {
+        bool played;
+        if (worker->config->binary) {
+            played = playOneGameBinary(*worker, game);
+        } else if (worker->config->json) {
+            played = playOneGameJson(*worker, game);
+        } else {
+            played = playOneGame(*worker, game);
+        }
+        if (played) {
+            worker->games++;
+        } else {
+            worker->failures++;
+        }
+    }
+    return NULL;
+}
+
+/* =====================================
+SPECTATORS
+===================================== */
+
+// everything one spectator thread counts
+struct LoadWatcher {
+    const LoadConfig    *config;
+    std::atomic<bool>   *done;          // shared: set once the players have played every game
+    long                games;          // games watched to the end
+    long                events;
+    long                bytesIn;
+
+    LoadWatcher() : config(NULL), done(NULL), games(0), events(0), bytesIn(0) {}
+};
+
+// watches featured games one after another, over the binary protocol, until the players are done
+static void *watchThread(void *vargp) {
+    LoadWatcher *watcher = static_cast<LoadWatcher*>(vargp);
+    const LoadConfig &config = *watcher->config;
+    unsigned char frame[WIREMAXFRAME];
+    char hello[16];
+    rio_t rio;
+
+    sprintf(hello, "%cwatch\n", WIREHELLO);
+    while (!watcher->done->load()) {
+        int fd = open_clientfd(config.host, config.port);
+        if (fd < 0) {
+            usleep(1000);
+            continue;
+        }
+        Rio_readinitb(&rio, fd);
+        if (rio_writen(fd, hello, strlen(hello)) < 0 || rio_readlineb(&rio, reinterpret_cast<char*>(frame), sizeof(frame)) <= 0) {
+            close(fd);
+            continue;
+        }
+        bool watching = true;
+        while (rio_readnb(&rio, frame, WIREHEADER) == WIREHEADER && rio_readnb(&rio, frame + WIREHEADER, frame[1]) == frame[1]) {
+            watcher->bytesIn += WIREHEADER + frame[1];
+            if (frame[0] == WIRE_WATCHING) {
+                watching = (frame[WIREHEADER] != 0);
+            } else if (frame[0] != WIRE_HELLO) {
+                watcher->events++;
+                watcher->games += (frame[0] == WIRE_FINAL);
+            }
+        }
+        close(fd);
+        if (!watching) {                                // (no game was being played yet)
+            usleep(1000);
+        }
+    }
+    return NULL;
+}
+
+/* =====================================
+SERVER CPU TIME
+===================================== */
+
+// user + system CPU time used so far by the given process, in seconds (from /proc), or -1 if it can't be read
+static double processCPUSeconds(long pid) {
+    char path[64];
+    unsigned long utime, stime;
+    sprintf(path, "/proc/%ld/stat", pid);
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    // skip "pid (comm) state" and the 10 fields after it; the command name can hold spaces, so find its closing bracket
+    char line[1024];
+    bool ok = (fgets(line, sizeof(line), file) != NULL);
+    fclose(file);
+    char *rest = ok ? strrchr(line, ')') : NULL;
+    if (rest == NULL || sscanf(rest + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2) {
+        return -1;
+    }
+    return static_cast<double>(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+/* =====================================
+MAIN
+===================================== */
+
+// prints how to run the load generator, then exits
+static void usage(const char *progname) {
+    fprintf(stderr, "usage: %s host port [-c connections] [-g games] [-r rounds] [-a strategy] [-n players] [-B | -J] [-D] [-A] [-W spectators] [-P server-pid]\n", progname);
+    fprintf(stderr, "   -c  # of connections playing at once (default 8)\n");
+    fprintf(stderr, "   -g  total # of games to play (default 1000)\n");
+    fprintf(stderr, "   -r  rounds per game, 1-12 (default 12)\n");
+    fprintf(stderr, "   -a  CPU strategy to play against (default Random)\n");
+    fprintf(stderr, "   -n  # of leaderboard names to spread the games over (default 100; 0 to play unranked)\n");
+    fprintf(stderr, "   -B  speak the binary protocol instead of text\n");
+    fprintf(stderr, "   -J  speak the JSON protocol instead of text\n");
+    fprintf(stderr, "   -D  ask for only what changes in the hands, table & score piles\n");
+    fprintf(stderr, "   -A  play the other connections in the arena, game after game on each connection (with -B or -J)\n");
+    fprintf(stderr, "   -W  # of connections watching the featured games as they are played\n");
+    fprintf(stderr, "   -P  pid of the server, to report its CPU time per game\n");
+    exit(1);
+}
+
+static double micros(unsigned long long ns) {
+    return ns / 1000.0;
+}
+
+int main(int argc, char **argv) {
+    LoadConfig config;
+    long serverPid = 0;
+    int opt;
+
+    config.connections = 8;
+    config.games       = 1000;
+    config.rounds      = 12;
+    config.strategy    = CPU_RANDOM + 1;
+    config.players     = 100;
+    config.binary      = false;
+    config.json        = false;
+    config.deltas      = false;
+    config.arena       = false;
+    config.spectators  = 0;
+
+    while ((opt = getopt(argc, argv, "c:g:r:a:n:BJDAW:P:")) != -1) {
+        switch (opt) {
+            case 'c': config.connections = atoi(optarg);                    break;
+            case 'g': config.games       = atol(optarg);                    break;
+            case 'r': config.rounds      = atoi(optarg);                    break;
+            case 'a': config.strategy    = strategyFromName(optarg) + 1;    break;
+            case 'n': config.players     = atoi(optarg);                    break;
+            case 'B': config.binary      = true;                            break;
+            case 'J': config.json        = true;                            break;
+            case 'D': config.deltas      = true;                            break;
+            case 'A': config.arena       = true;                            break;
+            case 'W': config.spectators  = atoi(optarg);                    break;
+            case 'P': serverPid          = atol(optarg);                    break;
+            default:  usage(argv[0]);
+        }
+    }
+    if (argc - optind != 2 || config.connections < 1 || config.games < 1 || config.rounds < 1 || config.rounds > 12
+        || config.strategy > NUMSTRATEGIES || config.players < 0 || config.spectators < 0 || (config.binary && config.json)
+        || (config.arena && !config.binary && !config.json)) {
+        usage(argv[0]);
+    }
+    config.host = argv[optind];
+    config.port = argv[optind+1];
+    makeCardNames();
+
+    std::vector<LoadWorker> workers(config.connections);
+    std::vector<pthread_t> tids(config.connections);
+    std::atomic<long> nextGame(0);
+    std::vector<LoadWatcher> watchers(config.spectators);
+    std::vector<pthread_t> watcherTids(config.spectators);
+    std::atomic<bool> done(false);
+    double cpuBefore = (serverPid > 0) ? processCPUSeconds(serverPid) : -1;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < config.connections; i++) {
+        workers[i].config   = &config;
+        workers[i].nextGame = &nextGame;
+        Pthread_create(&tids[i], NULL, loadThread, &workers[i]);
+    }
+    for (int i = 0; i < config.spectators; i++) {
+        watchers[i].config = &config;
+        watchers[i].done   = &done;
+        Pthread_create(&watcherTids[i], NULL, watchThread, &watchers[i]);
+    }
+    LoadWorker total;
+    for (int i = 0; i < config.connections; i++) {
+        Pthread_join(tids[i], NULL);
+        total.latency.merge(workers[i].latency);
+        total.games    += workers[i].games;
+        total.prompts  += workers[i].prompts;
+        total.retries  += workers[i].retries;
+        total.failures += workers[i].failures;
+        total.unpaired += workers[i].unpaired;
+        total.bytesIn  += workers[i].bytesIn;
+        total.bytesOut += workers[i].bytesOut;
+    }
+    double seconds = nanosSince(start) / 1e9;
+    double cpuAfter = (serverPid > 0) ? processCPUSeconds(serverPid) : -1;
+    done.store(true);
+    LoadWatcher watched;
+    for (int i = 0; i < config.spectators; i++) {
+        Pthread_join(watcherTids[i], NULL);
+        watched.games   += watchers[i].games;
+        watched.events  += watchers[i].events;
+        watched.bytesIn += watchers[i].bytesIn;
+    }
+
+    long games = (total.games > 0) ? total.games : 1;
+    printf("%ld games of %d rounds %s%s, %d connections, %s:%s (%s protocol%s)\n", total.games, config.rounds,
+           config.arena ? "in the arena" : "against ", config.arena ? "" : strategyName(static_cast<StrategyKind>(config.strategy - 1)),
+           config.connections, config.host, config.port, config.binary ? "binary" : (config.json ? "JSON" : "text"), config.deltas ? ", deltas" : "");
+    if (total.unpaired > 0) {
+        printf("(%ld of them against the CPU, for want of an opponent)\n", total.unpaired);
+    }
+    printf("Played in %.3f s: %.1f games/s, %.0f prompts/s\n\n", seconds, total.games / seconds, total.prompts / seconds);
+    printf("PROMPT LATENCY (answer sent -> next prompt received), %ld prompts\n", total.latency.count());
+    printf("  mean %9.1f us\n", micros(total.latency.mean()));
+    printf("  p50  %9.1f us\n", micros(total.latency.percentile(50)));
+    printf("  p99  %9.1f us\n", micros(total.latency.percentile(99)));
+    printf("  p999 %9.1f us\n", micros(total.latency.percentile(99.9)));
+    printf("  max  %9.1f us\n\n", micros(total.latency.max()));
+    printf("PER GAME\n");
+    printf("  prompts:   %8.1f\n", static_cast<double>(total.prompts) / games);
+    printf("  bytes in:  %8.0f\n", static_cast<double>(total.bytesIn) / games);
+    printf("  bytes out: %8.0f\n", static_cast<double>(total.bytesOut) / games);
+    if (cpuBefore >= 0 && cpuAfter >= 0) {
+        printf("  server CPU: %7.3f ms\n", 1000.0 * (cpuAfter - cpuBefore) / games);
+    } else if (serverPid > 0) {
+        printf("  server CPU: (cannot read /proc/%ld/stat)\n", serverPid);
+    }
+    if (config.spectators > 0) {
+        printf("\nSPECTATORS (%d connections)\n", config.spectators);
+        printf("  games watched to the end: %ld\n", watched.games);
+        printf("  events received: %ld, %.0f/s\n", watched.events, watched.events / seconds);
+        printf("  bytes received:  %ld\n", watched.bytesIn);
+    }
+    if (total.retries > 0 || total.failures > 0) {
+        printf("\n%ld answers turned down by the server, %ld games cut short by connection errors\n", total.retries, total.failures);
+    }
+    return (total.failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,217 @@
+//perft.cpp
+// Counts every possible line of play from a fixed set of seeded deals, out to a given # of turns, and times how fast
+// the rules can enumerate them (like "perft" for chess engines). The counts are a checksum of the rules themselves:
+// matching, moving cards between hands, and scoring must all give the same counts after any optimisation.
+#include <unistd.h>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include <random>
+#include <chrono>
+#include "koikoi-engine.hpp"
+
+#define MAXDEPTH 16		// a round never lasts more than 16 turns (8 cards in each hand)
+
+// what the search found at each depth
+struct PerftCounts {
+    long lines[MAXDEPTH+1];         // # of distinct lines of play exactly d turns long
+    long roundEnds[MAXDEPTH+1];     // of those, # whose last turn ended the round (cashed in, or the deck or hands ran out)
+    long koikois[MAXDEPTH+1];       // of those, # whose last turn called Koi-Koi
+    long scoreSum[MAXDEPTH+1];      // sum over those lines of the mover's raw score after the last turn (a checksum for scoring)
+
+    PerftCounts() {
+        for (int d = 0; d <= MAXDEPTH; d++) {
+            lines[d] = roundEnds[d] = koikois[d] = scoreSum[d] = 0;
+        }
+    }
+};
+
+// the search, with the match lists it reuses at each depth so that it does not allocate once it is warmed up
+struct Perft {
+    GameState           game;
+    int                 depth;              // # of turns to search
+    PerftCounts         counts;
+    std::vector<int>    handMatches[MAXDEPTH+1];
+    std::vector<int>    deckMatches[MAXDEPTH+1];
+
+    void search(int seat, int ply);
+    void drawPhase(int seat, int ply, int score_before);
+    void endOfTurn(int seat, int ply, int score_before);
+};
+
+// removes one copy of the given card from a hand (the inverse of Hand::addCard())
+static void removeCard(Hand &hand, const CardType &card) {
+    hand.playCard(hand.findFirstIndex(card.getMonth(), card.getDesign()));
+    return;
+}
+
+// true if the card at index i is the same card as the one before it (identical chaff give the same line of play, so only the first is tried)
+static bool sameAsPrevious(const Hand &hand, int i) {
+    return (i > 0 && hand.getCard(i) == hand.getCard(i-1));
+}
+
+// plays every possible turn for seat, which is turn # ply of the round (PHASE 1: match a hand card, or give one up to the table)
+void Perft::search(int seat, int ply) {
+    Hand &hand = game.hands[seat];
+    ScorePile &pile = game.piles[seat];
+    int score_before = pile.rawScore();
+    int handsize = hand.cardCount();
+
+    if (noCardsToPlay(hand, game.table)) {
+        for (int i = 0; i < handsize; i++) {
+            if (sameAsPrevious(hand, i)) {
+                continue;
+            }
+            CardType card = hand.playCard(i);
+            game.table.addCard(card);
+            drawPhase(seat, ply, score_before);
+            removeCard(game.table, card);
+            hand.addCard(card);
+        }
+        return;
+    }
+
+    std::vector<int> &matches = handMatches[ply];
+    for (int i = 0; i < handsize; i++) {
+        if (sameAsPrevious(hand, i) || !findMatches(hand.getCard(i), game.table, matches)) {
+            continue;
+        }
+        for (size_t m = 0; m < matches.size(); m++) {
+            int t = matches[m];
+            if (sameAsPrevious(game.table, t)) {		// an identical card just before it also matched, and was tried already
+                continue;
+            }
+            CardType card   = hand.playCard(i);
+            CardType target = game.table.playCard(t);
+            pile.addCard(card);
+            pile.addCard(target);
+            drawPhase(seat, ply, score_before);
+            removeCard(pile, target);
+            removeCard(pile, card);
+            game.table.addCard(target);
+            hand.addCard(card);
+        }
+    }
+    return;
+}
+
+// PHASE 2: draws the next card from the deck, and plays every possible match for it
+void Perft::drawPhase(int seat, int ply, int score_before) {
+    ScorePile &pile = game.piles[seat];
+    std::vector<int> &matches = deckMatches[ply];
+    CardType drawn = game.deck.drawCard();
+
+    if (!findMatches(drawn, game.table, matches)) {
+        game.table.addCard(drawn);
+        endOfTurn(seat, ply, score_before);
+        removeCard(game.table, drawn);
+    } else {
+        for (size_t m = 0; m < matches.size(); m++) {
+            int t = matches[m];
+            if (sameAsPrevious(game.table, t)) {		// an identical card just before it also matched, and was tried already
+                continue;
+            }
+            CardType target = game.table.playCard(t);
+            pile.addCard(drawn);
+            pile.addCard(target);
+            endOfTurn(seat, ply, score_before);
+            removeCard(pile, target);
+            removeCard(pile, drawn);
+            game.table.addCard(target);
+        }
+    }
+    game.deck.returnCard(drawn);
+    return;
+}
+
+// PHASE 3: counts the line(s) that end here; if the score pile gained points, both ending the round and calling Koi-Koi are tried
+void Perft::endOfTurn(int seat, int ply, int score_before) {
+    int score = game.piles[seat].rawScore();
+    bool scored = (score != score_before);
+    bool out_of_cards = game.deck.isEmpty() || (game.hands[0].isEmpty() && game.hands[1].isEmpty());
+
+    if (scored) {							// the player cashes in, which ends the round
+        counts.lines[ply]++;
+        counts.roundEnds[ply]++;
+        counts.scoreSum[ply] += score;
+        counts.koikois[ply]++;				// ...or calls Koi-Koi, which is the line counted below
+    }
+    counts.lines[ply]++;
+    counts.scoreSum[ply] += score;
+    if (out_of_cards) {
+        counts.roundEnds[ply]++;
+        return;
+    }
+    if (ply < depth) {
+        bool called_KK = game.calledKK[seat];
+        game.calledKK[seat] = called_KK || scored;
+        search(1 - seat, ply + 1);
+        game.calledKK[seat] = called_KK;
+    }
+    return;
+}
+
+// prints how to run the benchmark, then exits
+static void usage(const char *progname) {
+    fprintf(stderr, "usage: %s [-d turns] [-n deals] [-s seed] [-v]\n", progname);
+    fprintf(stderr, "   -d  # of turns to search from each deal, 1-%d (default 6)\n", MAXDEPTH);
+    fprintf(stderr, "   -n  # of seeded deals to search (default 16)\n");
+    fprintf(stderr, "   -s  base random seed for the deals (default 1)\n");
+    fprintf(stderr, "   -v  also print the # of lines found from each deal\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    Perft perft;
+    long deals = 16;
+    unsigned int seed = 1;
+    bool verbose = false;
+    int opt;
+
+    perft.depth = 6;
+    while ((opt = getopt(argc, argv, "d:n:s:v")) != -1) {
+        switch (opt) {
+            case 'd': perft.depth = atoi(optarg);               break;
+            case 'n': deals       = atol(optarg);               break;
+            case 's': seed        = strtoul(optarg, NULL, 10);  break;
+            case 'v': verbose     = true;                       break;
+            default:  usage(argv[0]);
+        }
+    }
+    if (perft.depth < 1 || perft.depth > MAXDEPTH || deals < 1) {
+        usage(argv[0]);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long deal = 0; deal < deals; deal++) {
+        std::seed_seq dealSeed = {seed, static_cast<unsigned int>(deal)};
+        std::mt19937 rng(dealSeed);
+        GameState &game = perft.game;
+        long before = perft.counts.lines[perft.depth];
+
+        // deal until nobody has an instant win and the table is not a misdeal, so that the round is actually played
+        game.dealer = rng() % 2;
+        do {
+            setup(game.deck, game.hands[game.dealer], game.hands[1-game.dealer], game.table, game.piles[0], game.piles[1], rng);
+            game.calledKK[0] = game.calledKK[1] = false;
+        } while (instantWinner(game) != -1 || game.table.instantWin2222() || game.table.instantWin4());
+
+        perft.counts.lines[0]++;
+        perft.search(game.dealer, 1);
+        if (verbose) {
+            printf("deal %4ld: %ld\n", deal, perft.counts.lines[perft.depth] - before);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    long nodes = 0;
+    printf("%ld deals, seed %u, %d turns deep\n\n", deals, seed, perft.depth);
+    printf("turns            lines     round ends        koi-koi      score sum\n");
+    for (int d = 0; d <= perft.depth; d++) {
+        const PerftCounts &c = perft.counts;
+        printf("%5d  %15ld  %13ld  %13ld  %13ld\n", d, c.lines[d], c.roundEnds[d], c.koikois[d], c.scoreSum[d]);
+        nodes += c.lines[d];
+    }
+    printf("\n%ld nodes in %.3f s: %.0f nodes/s\n", nodes, seconds, nodes / seconds);
+    return 0;
+}
@@ -0,0 +1,362 @@
+#include "serv-checkpoint.hpp"
+#include "serv-log.hpp"
+extern "C" {
+#include "csapp.h"
+}
+#include <unordered_map>
+#include <atomic>
+#include <random>
+#include <cstring>
+#include <ctime>
+#include <sys/socket.h>
+
+/* =====================================
+THE LOG
+A 12-byte header (the magic, then u32 version), then the events. Each event is a 10-byte header (u8 kind, u8 # of
+bytes after the header, u64 token of the game) and then:
+	CHECKPOINT_START	u32 seed, u8 # of rounds, u8 CPU strategy, then the player's name (the rest of the event)
+	CHECKPOINT_TURN		the turn's 3 bytes
+	CHECKPOINT_END		nothing
+The games in a log of another version are given up: their deals may not come out of their seeds the same way.
+===================================== */
+
+#define CHECKPOINTMAGIC		"KOIKOICP"
+#define CHECKPOINTVERSION	2			// (2: deals from DeckType::shuffle()'s own Fisher-Yates, as in record store version 3)
+#define LOGHEADER			12
+
+enum CheckpointEvent {
+	CHECKPOINT_START = 1,
+	CHECKPOINT_TURN  = 2,
+	CHECKPOINT_END   = 3
+};
+
+#define EVENTHEADER		10
+
+// everything kept so far about one unfinished game
+struct CheckpointSession {
+	unsigned long long	token;
+	std::string			start;					// the game's CHECKPOINT_START event
+	unsigned char		turns[CHECKPOINTTURNS][3];		// every turn played so far (written by the thread playing the game alone)
+	std::atomic<int>	played;					// # of turns in turns (each one is written before the count is bumped past it)
+	pthread_mutex_t		owner;					// guards cfd, so that a takeover never lands part-way through a turn
+	int					cfd;					// the connection playing the game, or -1 if the game is parked (changed under logLock too)
+	time_t				parkedAt;				// when the game was parked
+	bool				ended;					// the game is over, or was given up (guarded by logLock)
+	bool				logged;					// whether start is in the log (the commit thread's own, like committed)
+	int					committed;				// # of turns in the log
+	std::atomic<int>	holders;				// the threads using the session, and sessions while it is there
+};
+
+static std::string logPath;
+static int logfd = -1;
+static bool logging = false;									// whether openCheckpoints() has been called
+static pthread_mutex_t logLock = PTHREAD_MUTEX_INITIALIZER;		// guards sessions (but not the turns of the games in it)
+static std::unordered_map<unsigned long long, CheckpointSession*> sessions;		// every unfinished game
+static size_t grownBy = 0;										// bytes written since the log was last rewritten
+static pthread_once_t threadOnce = PTHREAD_ONCE_INIT;
+
+// writes an event into buf, returning its length
+static int makeEvent(char *buf, CheckpointEvent kind, unsigned long long token, const void *payload, int length) {
+	buf[0] = kind;
+	buf[1] = length;
+	memcpy(buf + 2, &token, 8);
+	if (length > 0) {
+		memcpy(buf + EVENTHEADER, payload, length);
+	}
+	return EVENTHEADER + length;
+}
+
+// a session for a game that has just started, or been read back from the log, held by sessions alone
+static CheckpointSession *newSession(unsigned long long token, const char *start, size_t length, int cfd) {
+	CheckpointSession *session = new CheckpointSession;
+	session->token     = token;
+	session->start.assign(start, length);
+	session->played.store(0);
+	pthread_mutex_init(&session->owner, NULL);
+	session->cfd       = cfd;
+	session->parkedAt  = time(NULL);
+	session->ended     = false;
+	session->logged    = false;
+	session->committed = 0;
+	session->holders.store(1);
+	return session;
+}
+
+// lets go of the session, which is deleted once nothing holds it
+static void letGo(CheckpointSession *session) {
+	if (session->holders.fetch_sub(1) == 1) {
+		pthread_mutex_destroy(&session->owner);
+		delete session;
+	}
+	return;
+}
+
+// replaces the log with one holding only the unfinished games, as far as they have been logged (logLock must be held)
+static void rewriteLog() {
+	std::string tmpPath = logPath + ".tmp";
+	std::string events(CHECKPOINTMAGIC, 8);
+	unsigned int version = CHECKPOINTVERSION;
+	char event[EVENTHEADER + 3];
+
+	events.append(reinterpret_cast<const char*>(&version), 4);
+	for (const auto &entry : sessions) {
+		const CheckpointSession *session = entry.second;
+		if (session->logged) {			// (one that isn't yet is logged whole by the next pass)
+			events += session->start;
+			for (int t = 0; t < session->committed; t++) {
+				events.append(event, makeEvent(event, CHECKPOINT_TURN, session->token, session->turns[t], 3));
+			}
+		}
+	}
+	int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+	if (fd < 0 || rio_writen(fd, const_cast<char*>(events.data()), events.length()) != static_cast<ssize_t>(events.length())
+	    || fsync(fd) < 0 || rename(tmpPath.c_str(), logPath.c_str()) < 0) {
+		if (fd >= 0) {
+			close(fd);
+		}
+		logText(LOG_SERVER, "Could not rewrite the checkpoint log");
+		return;
+	}
+	if (logfd >= 0) {
+		close(logfd);
+	}
+	logfd   = fd;
+	grownBy = 0;
+	return;
+}
+
+// gives up on every game that has been parked for more than CHECKPOINTGRACE seconds (logLock must be held)
+static void expireParked() {
+	time_t now = time(NULL);
+
+	for (const auto &entry : sessions) {
+		CheckpointSession *session = entry.second;
+		if (!session->ended && session->cfd == -1 && now - session->parkedAt > CHECKPOINTGRACE) {
+			session->ended = true;
+		}
+	}
+	return;
+}
+
+// adds to batch every event since the last pass: games started, the turns each game has published since, and games
+// ended, which are then let go of (logLock must be held, but the games' turns are read without their threads waiting)
+static void gatherEvents(std::string &batch) {
+	char event[EVENTHEADER + 3];
+
+	for (std::unordered_map<unsigned long long, CheckpointSession*>::iterator entry = sessions.begin(); entry != sessions.end(); ) {
+		CheckpointSession *session = entry->second;
+		if (logging && (session->logged || !session->ended)) {		// (a game over before it was ever logged is left out)
+			if (!session->logged) {
+				batch += session->start;
+				session->logged = true;
+			}
+			int played = session->played.load(std::memory_order_acquire);
+			for (; session->committed < played; session->committed++) {
+				batch.append(event, makeEvent(event, CHECKPOINT_TURN, session->token, session->turns[session->committed], 3));
+			}
+			if (session->ended) {
+				batch.append(event, makeEvent(event, CHECKPOINT_END, session->token, NULL, 0));
+			}
+		}
+		if (session->ended) {
+			entry = sessions.erase(entry);
+			letGo(session);
+		} else {
+			entry++;
+		}
+	}
+	return;
+}
+
+// the group commit: whatever every session played since the last pass goes out in one write & one sync
+// (and, once a second, parked games that have waited too long are given up)
+static void *checkpointThread(void *vargp) {
+	struct timespec nap = {0, CHECKPOINTCOMMIT * 1000 * 1000};
+	std::string batch;
+	time_t lastExpired = time(NULL);
+
+	pthread_detach(pthread_self());
+	while (true) {
+		nanosleep(&nap, NULL);
+		pthread_mutex_lock(&logLock);
+		if (time(NULL) != lastExpired) {
+			lastExpired = time(NULL);
+			expireParked();
+		}
+		gatherEvents(batch);
+		pthread_mutex_unlock(&logLock);
+		if (batch.empty()) {
+			continue;
+		}
+		if (rio_writen(logfd, const_cast<char*>(batch.data()), batch.length()) != static_cast<ssize_t>(batch.length()) || fdatasync(logfd) < 0) {
+			logText(LOG_SERVER, "Could not write to the checkpoint log");
+		}
+		grownBy += batch.length();
+		batch.clear();
+		if (grownBy > CHECKPOINTCOMPACT) {
+			pthread_mutex_lock(&logLock);
+			rewriteLog();
+			pthread_mutex_unlock(&logLock);
+		}
+	}
+	return NULL;
+}
+
+static void startCheckpointThread() {
+	pthread_t tid;
+	Pthread_create(&tid, NULL, checkpointThread, NULL);
+	return;
+}
+
+void openCheckpoints(const char *path) {
+	struct stat st;
+	std::string log;
+
+	logPath = path;
+	int fd = open(path, O_RDONLY);
+	if (fd >= 0) {
+		if (fstat(fd, &st) < 0) {
+			unix_error((char *) "Checkpoint log open error");
+		}
+		log.resize(st.st_size);
+		if (rio_readn(fd, &log[0], log.length()) != static_cast<ssize_t>(log.length())) {
+			unix_error((char *) "Checkpoint log read error");
+		}
+		close(fd);
+	}
+
+	unsigned int version = 0;
+	if (log.length() >= LOGHEADER) {
+		memcpy(&version, &log[8], 4);
+	}
+	if (!log.empty() && (log.length() < LOGHEADER || log.compare(0, 8, CHECKPOINTMAGIC) != 0 || version != CHECKPOINTVERSION)) {
+		logText(LOG_SERVER, "Gave up the games of a checkpoint log of another version");
+		log.clear();
+	}
+
+	// gather up the games that never ended (a torn last event, from a crash part-way through writing it, is left out),
+	// parked as of now
+	size_t at = LOGHEADER;
+	while (at + EVENTHEADER <= log.length() && at + EVENTHEADER + static_cast<unsigned char>(log[at+1]) <= log.length()) {
+		size_t length = EVENTHEADER + static_cast<unsigned char>(log[at+1]);
+		unsigned long long token;
+		memcpy(&token, &log[at+2], 8);
+		std::unordered_map<unsigned long long, CheckpointSession*>::iterator found = sessions.find(token);
+		if (log[at] == CHECKPOINT_START) {
+			if (found != sessions.end()) {
+				letGo(found->second);
+			}
+			sessions[token] = newSession(token, &log[at], length, -1);
+		} else if (log[at] == CHECKPOINT_TURN && found != sessions.end()) {
+			int played = found->second->played.load();
+			if (played < CHECKPOINTTURNS) {
+				memcpy(found->second->turns[played], &log[at + EVENTHEADER], 3);
+				found->second->played.store(played + 1);
+			}
+		} else if (log[at] == CHECKPOINT_END && found != sessions.end()) {
+			letGo(found->second);
+			sessions.erase(found);
+		}
+		at += length;
+	}
+	for (const auto &entry : sessions) {		// (all of it is in the log already)
+		entry.second->logged    = true;
+		entry.second->committed = entry.second->played.load();
+	}
+
+	rewriteLog();
+	if (logfd < 0) {
+		app_error((char *) "Checkpoint log open error");
+	}
+	logging = true;
+	pthread_once(&threadOnce, startCheckpointThread);
+	return;
+}
+
+/* =====================================
+LOGGING GAMES
+===================================== */
+
+CheckpointSession *checkpointStart(int cfd, unsigned int seed, int rounds, int strategy, const std::string &name, unsigned long long &token) {
+	static std::random_device entropy;
+	char payload[255], event[EVENTHEADER + sizeof(payload)];
+
+	pthread_once(&threadOnce, startCheckpointThread);
+	memcpy(payload, &seed, 4);
+	payload[4] = rounds;
+	payload[5] = strategy;
+	size_t nameLength = (name.length() < sizeof(payload) - 6) ? name.length() : sizeof(payload) - 6;
+	memcpy(payload + 6, name.data(), nameLength);
+
+	pthread_mutex_lock(&logLock);
+	do {					// (the token is all that stands between a game & anyone who wants to take it over, so it is random)
+		token = (static_cast<unsigned long long>(entropy()) << 32) | entropy();
+	} while (token == 0 || sessions.count(token) > 0);
+	CheckpointSession *session = newSession(token, event, makeEvent(event, CHECKPOINT_START, token, payload, 6 + nameLength), cfd);
+	session->holders.store(2);			// (sessions, and the calling thread)
+	sessions[token] = session;
+	pthread_mutex_unlock(&logLock);
+	return session;
+}
+
+void checkpointTurn(CheckpointSession *session, int cfd, const unsigned char turn[3]) {
+	pthread_mutex_lock(&session->owner);		// (only ever waited on while the game is being taken over)
+	int played = session->played.load(std::memory_order_relaxed);
+	if (session->cfd == cfd && played < CHECKPOINTTURNS) {
+		memcpy(session->turns[played], turn, 3);
+		session->played.store(played + 1, std::memory_order_release);
+	}
+	pthread_mutex_unlock(&session->owner);
+	return;
+}
+
+void checkpointEnd(CheckpointSession *session, int cfd) {
+	pthread_mutex_lock(&logLock);
+	pthread_mutex_lock(&session->owner);
+	if (session->cfd == cfd) {			// (the commit thread logs its end, and lets go of it)
+		session->ended = true;
+	}
+	pthread_mutex_unlock(&session->owner);
+	pthread_mutex_unlock(&logLock);
+	letGo(session);
+	return;
+}
+
+void parkCheckpoint(CheckpointSession *session, int cfd) {
+	pthread_mutex_lock(&logLock);
+	pthread_mutex_lock(&session->owner);
+	if (session->cfd == cfd && !session->ended) {
+		session->cfd      = -1;
+		session->parkedAt = time(NULL);
+	}
+	pthread_mutex_unlock(&session->owner);
+	pthread_mutex_unlock(&logLock);
+	letGo(session);
+	return;
+}
+
+CheckpointSession *resumeCheckpoint(unsigned long long token, int cfd, GameCheckpoint &game) {
+	CheckpointSession *session = NULL;
+
+	pthread_mutex_lock(&logLock);
+	std::unordered_map<unsigned long long, CheckpointSession*>::iterator found = sessions.find(token);
+	if (token != 0 && found != sessions.end() && !found->second->ended) {
+		session = found->second;
+		const std::string &start = session->start;
+		game.token    = token;
+		memcpy(&game.seed, &start[EVENTHEADER], 4);
+		game.rounds   = static_cast<unsigned char>(start[EVENTHEADER + 4]);
+		game.strategy = static_cast<unsigned char>(start[EVENTHEADER + 5]);
+		game.name.assign(start, EVENTHEADER + 6, std::string::npos);
+		pthread_mutex_lock(&session->owner);
+		game.turns.assign(session->turns[0], session->turns[0] + 3 * session->played.load(std::memory_order_relaxed));
+		if (session->cfd != -1) {		// the connection still playing it must be dead: wake its thread up, so that it ends
+			shutdown(session->cfd, SHUT_RDWR);
+		}
+		session->cfd = cfd;
+		pthread_mutex_unlock(&session->owner);
+		session->holders.fetch_add(1);
+	}
+	pthread_mutex_unlock(&logLock);
+	return session;
+}
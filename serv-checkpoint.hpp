@@ -0,0 +1,60 @@
+#ifndef SERV_CHECKPOINT_H
+#define SERV_CHECKPOINT_H
+
+#include <string>
+#include <vector>
+
+/*  ========================================
+SESSION CHECKPOINTS
+Every game in progress is written down as it is played, so that a client can carry on with it after losing its
+connection, or after the server has gone down and come back. Since every deal comes from the game's seed (see
+"koikoi-record.hpp"), a game needs nothing more than its seed, its settings, and the 3 bytes of each turn played:
+resuming it deals the same cards again and replays those turns.
+
+Each game is owned by the connection playing it. When that connection is lost, the session's thread parks the game
+and ends; the game then waits CHECKPOINTGRACE seconds for a client to present its token, and is given up after that.
+A client that presents the token of a game still owned by a connection (one that died without the server noticing yet)
+takes the game over, and the old connection is shut down.
+
+Each game's turns go into a buffer of its own, big enough for the longest game and written only by the thread playing
+it, which publishes each turn by bumping the buffer's count; so a turn takes no lock but the game's own (which only a
+takeover ever waits on) and costs nothing more than 3 bytes copied.
+
+If openCheckpoints() is called, the checkpoints are also kept in a write-ahead log: one file of small events (a game
+starting, a turn, a game ending), only ever appended to. A background thread gathers up every game's turns since its
+last pass every CHECKPOINTCOMMIT ms, writes them out, and syncs them to disk once for every session at a time. So a
+crash loses at most the last few ms of turns (a game resumes from the last turn that made it to disk). Once the log
+grows by CHECKPOINTCOMPACT bytes, it is rewritten with only the games that are still going. Games left in the log by
+the last run wait to be resumed like parked ones.
+========================================    */
+
+#define CHECKPOINTCOMMIT	5						// ms between syncs of the log
+#define CHECKPOINTCOMPACT	(16 * 1024 * 1024)		// bytes the log can grow by before it is rewritten
+#define CHECKPOINTGRACE		300						// seconds a parked game waits to be resumed
+#define CHECKPOINTTURNS		(12 * 16)				// most turns a game can have (12 rounds, of 8 cards from each hand)
+
+// what a game needs to be resumed
+struct GameCheckpoint {
+	unsigned long long			token;			// what the client presents to resume the game
+	unsigned int				seed;			// the seed the game's deals come from
+	int							rounds;			// # of rounds the game is played to
+	int							strategy;		// the CPU's strategy (see StrategyKind)
+	std::string					name;			// the player's leaderboard name ("" = unranked)
+	std::vector<unsigned char>	turns;			// every turn played so far, 3 bytes each, written as in a game record
+};
+
+struct CheckpointSession;		// one game's checkpoint, as the thread playing the game holds it
+
+void openCheckpoints(const char *path);			// picks up the games left unfinished in the log at path, and logs to it from now on
+
+// (cfd is the connection playing the game: a game taken over by another connection ignores the old one. The session
+// that checkpointStart() or resumeCheckpoint() hands back is the calling thread's to use until it passes it to
+// checkpointEnd() or parkCheckpoint(), both of which let go of it)
+CheckpointSession *checkpointStart(int cfd, unsigned int seed, int rounds, int strategy, const std::string &name, unsigned long long &token);	// starts keeping a new game, and gives its token
+void checkpointTurn(CheckpointSession *session, int cfd, const unsigned char turn[3]);	// keeps a turn of the game
+void checkpointEnd(CheckpointSession *session, int cfd);		// the game is over (it can't be resumed after this)
+void parkCheckpoint(CheckpointSession *session, int cfd);		// the connection is lost: the game waits CHECKPOINTGRACE seconds to be resumed
+
+CheckpointSession *resumeCheckpoint(unsigned long long token, int cfd, GameCheckpoint &game);	// hands the game over to the connection, or returns NULL if there is none with that token
+
+#endif
@@ -0,0 +1,368 @@
+#include "serv-json.hpp"
+#include "koikoi-wire.hpp"
+#include <cstring>
+
+/* =====================================
+EVENTS
+Each frame type is written from a list of its payload's fields, in order, one letter each:
+	n	u8 number				s	u8 seat (WIRENOCARD: null)		c	u8 card ID (WIRENOCARD: null)
+	b	u8 true/false			w	u16 number						l	u32 number
+	f	u32 x 1000, as a decimal	t	u64 token, as a hex string		m	u64 set of cards (or numbers), as an array
+	p	u8 WirePrompt, by name	k	u8 frame type, by name
+	x	the rest of the payload, as a string
+	d	the rest of the payload, as the arrays "added" & "removed" (the field's own name is not used)
+===================================== */
+
+struct JsonEvent {
+	const char	*name;
+	const char	*fields;
+	const char	*names[5];
+};
+
+static const JsonEvent events[] = {
+	{NULL,				"",			{}},
+	{"hello",			"nn",		{"version", "flags"}},								// WIRE_HELLO
+	{"token",			"t",		{"token"}},											// WIRE_TOKEN
+	{"resumed",			"",			{}},												// WIRE_RESUMED
+	{"option",			"nx",		{"number", "name"}},								// WIRE_OPTION
+	{"round",			"n",		{"round"}},											// WIRE_ROUND
+	{"dealer",			"s",		{"seat"}},											// WIRE_DEALER
+	{"instant_win",		"sb",		{"seat", "four_of_a_kind"}},						// WIRE_INSTANTWIN
+	{"hand",			"sm",		{"seat", "cards"}},									// WIRE_HAND
+	{"table",			"m",		{"cards"}},											// WIRE_TABLE
+	{"pile",			"smnn",		{"seat", "cards", "raw", "points"}},				// WIRE_PILE
+	{"play",			"scc",		{"seat", "card", "took"}},							// WIRE_PLAY
+	{"draw",			"scc",		{"seat", "card", "took"}},							// WIRE_DRAW
+	{"koikoi",			"sb",		{"seat", "called"}},								// WIRE_KOIKOI
+	{"points",			"sn",		{"seat", "points"}},								// WIRE_POINTS
+	{"standings",		"ww",		{"you", "opponent"}},								// WIRE_STANDINGS
+	{"final",			"wwn",		{"you", "opponent", "rounds"}},						// WIRE_FINAL
+	{"leaders",			"l",		{"players"}},										// WIRE_LEADERS
+	{"leader",			"lllfx",	{"rank", "wins", "games", "average", "name"}},		// WIRE_LEADER
+	{"prompt",			"pcm",		{"kind", "card", "choices"}},						// WIRE_PROMPT
+	{"reject",			"",			{}},												// WIRE_REJECT
+	{"delta",			"ksnnd",	{"of", "seat", "raw", "points", ""}},				// WIRE_DELTA
+	{"opponent",		"nx",		{"number", "name"}},								// WIRE_OPPONENT
+	{"abandoned",		"",			{}},												// WIRE_ABANDONED
+	{"watching",		"nnx",		{"game", "rounds", "name"}}							// WIRE_WATCHING
+};
+#define JSONEVENTS	(sizeof(events) / sizeof(events[0]))
+
+static const char *promptNames[] = {"", "name", "rounds", "strategy", "play", "match", "giveup", "koikoi", "after"};
+
+static char *put(char *at, const char *text) {
+	while (*text != '\0') {
+		*at++ = *text++;
+	}
+	return at;
+}
+
+static char *putNumber(char *at, unsigned long long n) {
+	char digits[20];
+	int count = 0;
+	do {
+		digits[count++] = '0' + n % 10;
+		n /= 10;
+	} while (n != 0);
+	while (count > 0) {
+		*at++ = digits[--count];
+	}
+	return at;
+}
+
+// a card ID or seat, or null for WIRENOCARD
+static char *putCard(char *at, unsigned char card) {
+	return (card == WIRENOCARD) ? put(at, "null") : putNumber(at, card);
+}
+
+static char *putCards(char *at, unsigned long long cards) {
+	*at++ = '[';
+	for (bool first = true; cards != 0; cards &= cards - 1, first = false) {
+		if (!first) {
+			*at++ = ',';
+		}
+		at = putNumber(at, __builtin_ctzll(cards));
+	}
+	*at++ = ']';
+	return at;
+}
+
+static char *putString(char *at, const unsigned char *text, int length) {
+	static const char hex[] = "0123456789abcdef";
+	*at++ = '"';
+	for (int i = 0; i < length; i++) {
+		if (text[i] == '"' || text[i] == '\\') {
+			*at++ = '\\';
+			*at++ = text[i];
+		} else if (text[i] < 0x20 || text[i] >= 0x7F) {		// (names are meant to be printable ASCII, but aren't trusted to be)
+			at = put(at, "\\u00");
+			*at++ = hex[text[i] >> 4];
+			*at++ = hex[text[i] & 0xF];
+		} else {
+			*at++ = text[i];
+		}
+	}
+	*at++ = '"';
+	return at;
+}
+
+// the IDs in a WIRE_DELTA with (removed) or without WIREREMOVED set
+static char *putDeltaCards(char *at, const unsigned char *ids, int count, bool removed) {
+	bool first = true;
+	*at++ = '[';
+	for (int i = 0; i < count; i++) {
+		if (((ids[i] & WIREREMOVED) != 0) == removed) {
+			if (!first) {
+				*at++ = ',';
+			}
+			at = putNumber(at, ids[i] & ~WIREREMOVED);
+			first = false;
+		}
+	}
+	*at++ = ']';
+	return at;
+}
+
+int frameToJson(const unsigned char *frame, char *line) {
+	const unsigned char *payload = frame + WIREHEADER;
+	const unsigned char *end = payload + frame[1];
+	char *at = line;
+
+	if (frame[0] == 0 || frame[0] >= JSONEVENTS) {
+		at = put(at, "{\"event\":\"unknown\",\"type\":");
+		at = putNumber(at, frame[0]);
+		return put(at, "}\n") - line;
+	}
+	const JsonEvent &event = events[frame[0]];
+	at = put(at, "{\"event\":\"");
+	at = put(at, event.name);
+	*at++ = '"';
+	for (int f = 0; event.fields[f] != '\0'; f++) {
+		char kind = event.fields[f];
+		if (kind != 'd') {
+			at = put(at, ",\"");
+			at = put(at, event.names[f]);
+			at = put(at, "\":");
+		}
+		switch (kind) {
+			case 'n':	at = putNumber(at, payload[0]);										payload += 1;	break;
+			case 's':
+			case 'c':	at = putCard(at, payload[0]);										payload += 1;	break;
+			case 'b':	at = put(at, (payload[0] != 0) ? "true" : "false");					payload += 1;	break;
+			case 'p':	at = put(at, "\"");
+						at = put(at, (payload[0] < sizeof(promptNames) / sizeof(promptNames[0])) ? promptNames[payload[0]] : "");
+						at = put(at, "\"");													payload += 1;	break;
+			case 'k':	at = put(at, "\"");
+						at = put(at, (payload[0] > 0 && payload[0] < JSONEVENTS) ? events[payload[0]].name : "");
+						at = put(at, "\"");													payload += 1;	break;
+			case 'w':	at = putNumber(at, wireU16(payload));								payload += 2;	break;
+			case 'l':	at = putNumber(at, wireU32(payload));								payload += 4;	break;
+			case 'f': {
+				unsigned int thousandths = wireU32(payload);
+				at = putNumber(at, thousandths / 1000);
+				*at++ = '.';
+				*at++ = '0' + thousandths / 100 % 10;
+				*at++ = '0' + thousandths / 10 % 10;
+				*at++ = '0' + thousandths % 10;
+				payload += 4;
+				break;
+			}
+			case 't': {
+				static const char hex[] = "0123456789abcdef";
+				unsigned long long token = wireU64(payload);
+				*at++ = '"';
+				for (int shift = 60; shift >= 0; shift -= 4) {
+					*at++ = hex[(token >> shift) & 0xF];
+				}
+				*at++ = '"';
+				payload += 8;
+				break;
+			}
+			case 'm':	at = putCards(at, wireU64(payload));								payload += 8;	break;
+			case 'x':	at = putString(at, payload, end - payload);							payload = end;	break;
+			case 'd':
+				at = put(at, ",\"added\":");
+				at = putDeltaCards(at, payload, end - payload, false);
+				at = put(at, ",\"removed\":");
+				at = putDeltaCards(at, payload, end - payload, true);
+				payload = end;
+				break;
+		}
+	}
+	return put(at, "}\n") - line;
+}
+
+/* =====================================
+REPLIES
+A reply is read one byte at a time, straight from the line: keys & strings are kept as pointers into it, and numbers
+are added up as their digits go by. Only flat objects are replies; keys other than "answer" & "refresh" are skipped.
+===================================== */
+
+struct JsonCursor {
+	const char	*at;
+	const char	*end;
+
+	void skipSpace() {
+		while (at < end && (*at == ' ' || *at == '\t' || *at == '\r' || *at == '\n')) {
+			at++;
+		}
+	}
+	bool take(char c) {
+		skipSpace();
+		if (at < end && *at == c) {
+			at++;
+			return true;
+		}
+		return false;
+	}
+	// a string: text & length are what is between the quotes, escapes & all
+	bool string(const char *&text, int &length) {
+		if (!take('"')) {
+			return false;
+		}
+		text = at;
+		while (at < end && *at != '"') {
+			if (*at == '\\') {
+				at++;
+			}
+			at++;
+		}
+		if (at >= end) {
+			return false;
+		}
+		length = at - text;
+		at++;
+		return true;
+	}
+	// an integer (a number with a fraction or exponent is not one)
+	bool integer(long &value) {
+		bool negative = (at < end && *at == '-');
+		at += negative ? 1 : 0;
+		if (at >= end || *at < '0' || *at > '9') {
+			return false;
+		}
+		value = 0;
+		for (; at < end && *at >= '0' && *at <= '9'; at++) {
+			if (value > 100000000) {		// (far past any choice, and nowhere near overflowing)
+				return false;
+			}
+			value = value * 10 + (*at - '0');
+		}
+		value = negative ? -value : value;
+		return !(at < end && (*at == '.' || *at == 'e' || *at == 'E'));
+	}
+	bool word(const char *literal) {
+		size_t length = strlen(literal);
+		if (static_cast<size_t>(end - at) < length || memcmp(at, literal, length) != 0) {
+			return false;
+		}
+		at += length;
+		return true;
+	}
+};
+
+static bool keyIs(const char *key, int length, const char *name) {
+	return static_cast<int>(strlen(name)) == length && memcmp(key, name, length) == 0;
+}
+
+bool parseJsonReply(const char *line, int length, JsonReply &reply) {
+	JsonCursor cursor = {line, line + length};
+	reply.refresh    = false;
+	reply.hasNumber  = false;
+	reply.number     = 0;
+	reply.text       = NULL;
+	reply.textLength = 0;
+
+	if (!cursor.take('{')) {
+		return false;
+	}
+	if (!cursor.take('}')) {
+		do {
+			const char *key;
+			int keyLength;
+			if (!cursor.string(key, keyLength) || !cursor.take(':')) {
+				return false;
+			}
+			cursor.skipSpace();
+			if (cursor.at >= cursor.end) {
+				return false;
+			}
+			char first = *cursor.at;
+			if (first == '"') {
+				const char *text;
+				int textLength;
+				if (!cursor.string(text, textLength)) {
+					return false;
+				}
+				if (keyIs(key, keyLength, "answer")) {
+					reply.text       = text;
+					reply.textLength = textLength;
+				}
+			} else if (first == '-' || (first >= '0' && first <= '9')) {
+				long number;
+				if (!cursor.integer(number)) {
+					return false;
+				}
+				if (keyIs(key, keyLength, "answer")) {
+					reply.hasNumber = true;
+					reply.number    = number;
+				}
+			} else if (cursor.word("true")) {
+				reply.refresh = reply.refresh || keyIs(key, keyLength, "refresh");
+			} else if (!cursor.word("false") && !cursor.word("null")) {
+				return false;
+			}
+		} while (cursor.take(','));
+		if (!cursor.take('}')) {
+			return false;
+		}
+	}
+	cursor.skipSpace();
+	return cursor.at == cursor.end;
+}
+
+static int hexDigit(char c) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	c |= 0x20;
+	return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+}
+
+int unescapeJson(const char *text, int length, unsigned char *out, int size) {
+	int n = 0;
+	for (int i = 0; i < length && n < size; i++) {
+		unsigned int c = static_cast<unsigned char>(text[i]);
+		if (c != '\\' || i + 1 >= length) {
+			out[n++] = c;				// (UTF-8 in the reply is copied as it is)
+			continue;
+		}
+		switch (text[++i]) {
+			case 'b':	c = '\b';	break;
+			case 'f':	c = '\f';	break;
+			case 'n':	c = '\n';	break;
+			case 'r':	c = '\r';	break;
+			case 't':	c = '\t';	break;
+			case 'u':
+				c = 0;
+				for (int d = 0; d < 4 && i + 1 < length && hexDigit(text[i+1]) >= 0; d++) {
+					c = (c << 4) | hexDigit(text[++i]);
+				}
+				break;
+			default:	c = static_cast<unsigned char>(text[i]);	break;		// (\" \\ \/)
+		}
+		if (c < 0x80) {
+			out[n++] = c;
+		} else if (c < 0x800 && n + 1 < size) {
+			out[n++] = 0xC0 | (c >> 6);
+			out[n++] = 0x80 | (c & 0x3F);
+		} else if (c >= 0x800 && n + 2 < size) {
+			out[n++] = 0xE0 | (c >> 12);
+			out[n++] = 0x80 | ((c >> 6) & 0x3F);
+			out[n++] = 0x80 | (c & 0x3F);
+		} else {
+			break;
+		}
+	}
+	return n;
+}
@@ -0,0 +1,36 @@
+#ifndef SERV_JSON_H
+#define SERV_JSON_H
+
+/*  ========================================
+THE JSON PROTOCOL
+For bots that would rather not parse frames: a client that asks for it with WIREJSON (see "koikoi-wire.hpp") is sent
+one line of JSON for every frame a binary client would be sent, and answers each prompt with one line of JSON. So the
+two protocols always carry the same events, and everything said about the binary one (the handshake, deltas, choices,
+rejects) holds for this one too. Each event is an object whose "event" names it, e.g.
+	{"event":"hand","seat":0,"cards":[1,6,13,20,21,30,36,44]}
+	{"event":"prompt","kind":"play","card":null,"choices":[6,20,44]}
+	{"event":"points","seat":1,"points":7}
+Cards are their IDs, seats are numbers (null for nobody), and the game's token is a hex string, as it is typed to resume.
+The events and their fields are listed in "serv-json.cpp", beside the frames they come from.
+
+A client answers a prompt with {"answer":6}, or {"answer":"name"} for WIREPROMPT_NAME; {"refresh":true} does what
+WIRE_REFRESH does. Replies are parsed in place, in the buffer they were read into: nothing is copied or allocated.
+========================================    */
+
+#define JSONMAXEVENT	2048		// longest event line (including the '\n') any frame can make
+#define JSONMAXREPLY	512			// longest reply line read from a client
+
+// a client's reply, as parsed (its text still points into the line, escapes & all)
+struct JsonReply {
+	bool		refresh;		// {"refresh":true}
+	bool		hasNumber;		// {"answer":<number>}
+	long		number;
+	const char	*text;			// {"answer":"<text>"} (NULL if the answer wasn't a string)
+	int			textLength;
+};
+
+int  frameToJson(const unsigned char *frame, char *line);								// writes the frame as one line of JSON (at most JSONMAXEVENT bytes), returning its length
+bool parseJsonReply(const char *line, int length, JsonReply &reply);					// parses a reply line, or returns false if it isn't one
+int  unescapeJson(const char *text, int length, unsigned char *out, int size);			// copies a string out of a reply (at most size bytes), unescaped, returning its length
+
+#endif
@@ -1,4 +1,6 @@
 #include "serv-koikoi.hpp"
+#include "serv-json.hpp"
+#include "serv-watch.hpp"
 extern "C" {
 #include "csapp.h"
 }
@@ -6,8 +8,7 @@ extern "C" {
 #include <vector>
 #include <cassert>
 #include <algorithm>
-#include <cstdlib>	//rand(), srand()
-#include <ctime>	//time(), to seed srand()
+#include <cstring>
 using namespace std;
 
 /*  TYPES USED:
@@ -19,447 +20,1187 @@ ScorePile		derived from Hand class, models a score pile with scoring functionali
 
 
 /* =====================================
-MATCHING FUNCTIONS
+SENDING & RECEIVING
 ===================================== */
-// returns true if "tablecard" on the table can be matched by the card "matcher"
-bool theseCardsMatch(const CardType &matcher, const CardType &tablecard) {
-	if (matcher.isLightning()) {									// Lightning card can match anything (but can only *be matched* by other NOV cards)
-		return true;
-	} else if (matcher.getMonth() == tablecard.getMonth()) {		// "match" means to have the same month
-		return true;
-	}
-	// otherwise
-	return false;
-}
-
-// searches through the table and looks for all cards that can be matched by "matcher"
-// UPDATE: the integer list "validTableCards" will be updated by reference with the list of indices of cards on the table that can be matched by "matcher"
-// RETURN: boolean of whether any matchable cards on the table were found (i.e., whether "validTableCards" has any entries or not)
-bool findMatches(const CardType &matcher, const Hand &table, std::vector<int> &validTableCards) {
-	validTableCards.clear();										// make sure the list of valid cards is empty
-	int tablesize = table.cardCount();								// increase efficiency with local variable
-
-	for (int i=0; i < tablesize; i++) {								// for each card on the table
-		if ( theseCardsMatch(matcher, table.getCard(i)) ) {			// if the chosen card matches card i on the table
-			validTableCards.push_back(i);							// then add i to the list (updated by reference)
-		}
+
+// what the client was last shown of each listing (the table, each hand, each score pile), so that only what has changed
+// since needs sending; a listing not shown since the last resync (each round, and after a resumed game catches up)
+// is sent in full
+enum ViewListing {
+	VIEW_TABLE		= 0,
+	VIEW_HAND		= 1,				// (+ seat)
+	VIEW_PILE		= 3,				// (+ seat)
+	VIEWLISTINGS	= 5
+};
+struct ClientView {
+	bool		shown[VIEWLISTINGS];
+	CardMask	cards[VIEWLISTINGS];
+	int			raw[VIEWLISTINGS];		// (piles only)
+	int			final[VIEWLISTINGS];
+};
+
+// how the text protocol speaks of the client's opponent: the CPU, or another player (see printOpponent())
+struct OpponentWords {
+	const char	*name;			// at the start of a sentence
+	const char	*the;			// in the middle of one
+	const char	*actor;			// what the turn descriptions call it
+	const char	*owner;			// as in "<owner> score pile"
+	const char	*label;			// as in "<label> Score:"
+	const char	*It;			// standing for it, at the start of a sentence
+	const char	*it;
+	const char	*its;
+};
+static const OpponentWords cpuWords    = {"The CPU", "the CPU", "Computer", "CPU's", "CPU's", "It", "it", "its"};
+static const OpponentWords playerWords = {"Your opponent", "your opponent", "Your opponent", "your opponent's", "Opponent's",
+                                          "Your opponent", "your opponent", "their"};
+
+#define TEXTMESSAGE	4096		// longest text message put together for a client (a longer one is sent in parts)
+
+// everything kept about a client for as long as its connection lasts, looked up by the connection's fd (so that one
+// thread can play a game with more than one client: see "serv-match.hpp")
+struct ClientState {
+	bool			muted;			// see muteClient()
+	ClientProtocol	protocol;
+	bool			deltas;			// whether the client asked for WIREDELTAS (see "koikoi-wire.hpp")
+	const OpponentWords	*them;
+	Broadcast		*broadcast;		// the spectators of the client's game, while it is featured (see "serv-watch.hpp")
+	ClientView		view;
+	char			text[TEXTMESSAGE];	// the text message being put together for the client (see TextMessage)
+	rio_t			input;			// the read buffer: kept from one answer to the next, so that whatever the client sends
+									// ahead of a prompt (a binary client's first frames, straight after its handshake line,
+									// or a bot's answers sent back to back) is kept for that prompt
+};
+static ClientState *clients[CLIENTFDS];
+
+static ClientState &clientState(int cfd) {
+	return *clients[cfd];
+}
+
+bool openClient(int cfd) {
+	if (cfd < 0 || cfd >= CLIENTFDS) {
+		return false;
 	}
-	return !validTableCards.empty();								// return whether the process above actually found any matches (true = match found, false = no matches found)
+	clients[cfd] = new ClientState();
+	clients[cfd]->protocol = PROTOCOL_TEXT;
+	clients[cfd]->them     = &cpuWords;
+	Rio_readinitb(&clients[cfd]->input, cfd);
+	return true;
 }
 
-// returns true if findMatches(...) would return false for EVERY card in the hand; otherwise returns false
-// "short-circuit"s if the hand or the table is empty, since of course nothing can be matched in those cases
-bool noCardsToPlay(const Hand &hand, const Hand &table) {
-	int handsize = hand.cardCount();
-	std::vector<int> dummy;
+void closeClient(int cfd) {
+	delete clients[cfd];
+	clients[cfd] = NULL;
+	return;
+}
+
+// whether the client is sent frames (binary or JSON) rather than text
+static bool speaksFrames(int cfd) {
+	return clientState(cfd).protocol != PROTOCOL_TEXT;
+}
+
+static void resyncView(int cfd) {
+	memset(clientState(cfd).view.shown, 0, sizeof(clientState(cfd).view.shown));
+	return;
+}
+
+void muteClient(int cfd, bool mute) {
+	clientState(cfd).muted = mute;
+	if (!mute) {
+		resyncView(cfd);				// (nothing the client was sent while muted reached it)
+	}
+	return;
+}
+
+ClientProtocol clientProtocol(int cfd) {
+	return clientState(cfd).protocol;
+}
+
+void featureClient(int cfd, Broadcast *broadcast) {
+	clientState(cfd).broadcast = broadcast;
+	return;
+}
+
+// writes bytes to the client, counting & timing the write
+static void writeToClient(int cfd, const void *bytes, size_t length) {
+	TRACE_SCOPE("Rio_writen");
+	if (clientState(cfd).muted) {
+		return;
+	}
+	SessionMetrics &metrics = sessionMetrics();
+	unsigned long long start = metricsNow();
+	if (rio_writen(cfd, const_cast<void*>(bytes), length) != static_cast<ssize_t>(length)) {
+		throw ClientGone{cfd};
+	}
+	metrics.write.record(metricsNow() - start);
+	countMetric(metrics.bytesOut, length);
+	return;
+}
 
-	if (table.isEmpty() || hand.isEmpty()) {		// if either the hand or table are devoid of cards, we can't play anything this phase
-		return true;
+// writes text to a text client
+static void sendText(int cfd, const char *text, size_t length) {
+	if (speaksFrames(cfd)) {					// (a binary client only gets frames)
+		return;
 	}
+	writeToClient(cfd, text, length);
+	return;
+}
+
+void sendToClient(int cfd, const string &text) {
+	sendText(cfd, text.c_str(), text.length());
+	return;
+}
+
+void sendToClient(int cfd, const char *text) {
+	sendText(cfd, text, strlen(text));
+	return;
+}
+
+// a text message, put together a piece at a time (like a WireFrame) in the client's own buffer, so that nothing is
+// allocated to print a turn; only one can be put together for a client at a time, and send() sends it & starts over
+class TextMessage {
+public:
+	explicit TextMessage(int cfd) : cfd(cfd), buffer(clientState(cfd).text), length(0) {}
 
-	for (int i=0; i < handsize; i++) {
-		if (findMatches(hand.getCard(i), table, dummy)) {			// if we ever find a card that can match something on the table
-			return false;											// then we DO have a card to play, so return false
+	TextMessage &text(const char *text) {
+		for (; *text != '\0'; text++) {
+			if (length == TEXTMESSAGE) {		// (full: what there is so far is sent on ahead)
+				send();
+			}
+			buffer[length++] = *text;
+		}
+		return *this;
+	}
+	TextMessage &number(long n) {
+		char digits[24];
+		snprintf(digits, sizeof(digits), "%ld", n);
+		return text(digits);
+	}
+	TextMessage &decimal(double x) {			// (as to_string() writes it)
+		char digits[64];
+		snprintf(digits, sizeof(digits), "%f", x);
+		return text(digits);
+	}
+	TextMessage &card(const CardType &card) {
+		return text(card.cardNameText());
+	}
+	TextMessage &listed(int index, const CardType &card) {		// a card in a listing, by its index
+		return text(" (").number(index).text(")  ").card(card).text("\t");
+	}
+	void send() {
+		if (length > 0) {
+			sendText(cfd, buffer, length);
+			length = 0;
 		}
+		return;
+	}
+
+private:
+	int		cfd;
+	char	*buffer;
+	int		length;
+};
+
+// whether the client's game is featured, for spectators to watch (see "serv-watch.hpp")
+static bool isFeatured(int cfd) {
+	return clientState(cfd).broadcast != NULL;
+}
+
+// casts an event of the client's game to its spectators, if it is featured (not while the client is muted: that is
+// a resumed game catching up, and its spectators start at the next round anyway)
+static void castFrame(int cfd, const WireFrame &frame) {
+	const ClientState &client = clientState(cfd);
+	if (client.broadcast != NULL && !client.muted) {
+		castEvent(client.broadcast, frame.bytes);
 	}
+	return;
+}
 
-	// if we reach here, then no playable cards ever found, so return true
+// sends an event of the client's game to a binary client, and casts it to its spectators; returns false if the client
+// speaks text (and still needs telling)
+static bool sendEvent(int cfd, const WireFrame &frame) {
+	castFrame(cfd, frame);
+	if (!speaksFrames(cfd)) {
+		return false;
+	}
+	sendFrame(cfd, frame);
 	return true;
 }
 
-// returns true if there findMatches(...) would return true
-bool hasMatches(const CardType &matcher, const Hand &table) {
-	std::vector<int> dummy;
-	return findMatches(matcher, table, dummy);
+void sendFrame(int cfd, const WireFrame &frame) {
+	if (clientState(cfd).protocol == PROTOCOL_JSON) {
+		char line[JSONMAXEVENT];
+		writeToClient(cfd, line, frameToJson(frame.bytes, line));
+		return;
+	}
+	writeToClient(cfd, frame.bytes, frame.length);
+	return;
+}
+
+// times the server's own work since the last answer, and wakes the spectators for what it did (if the game is
+// featured), before waiting on the next one
+static void awaitAnswer() {
+	wakeSpectators();
+	SessionMetrics &metrics = sessionMetrics();
+	if (metrics.answeredAt != 0) {					// everything since the last answer was read is the server's own time
+		metrics.processing.record(metricsNow() - metrics.answeredAt);
+	}
+	return;
+}
+
+// counts an answer of n bytes that has just been read
+static void countAnswer(ssize_t n) {
+	SessionMetrics &metrics = sessionMetrics();
+	metrics.answeredAt = metricsNow();
+	countMetric(metrics.prompts);
+	countMetric(metrics.bytesIn, n);
+	return;
+}
+
+#define TEXTANSWER	32			// longest answer to a prompt for a number that is read (the rest of a longer line is dropped)
+
+// what receiveChoice() returns for an answer that isn't one of the choices
+enum {
+	ANSWER_NOTNUMBER	= -1,
+	ANSWER_OUTOFRANGE	= -2,
+	ANSWER_NOTLEGAL		= -3
+};
+
+void receiveFromClient(int cfd, char *read_buf, int maxlen) {
+	TRACE_SCOPE("Rio_readlineb");
+	rio_t *rio = &clientState(cfd).input;
+	awaitAnswer();
+	ssize_t n = rio_readlineb(rio, read_buf, maxlen);
+	if (n <= 0) {
+		throw ClientGone{cfd};
+	}
+	ssize_t length = n;
+	while (n == maxlen - 1 && read_buf[n-1] != '\n') {			// the line is too long: the rest of it is dropped, rather than read as the next answer
+		char rest[64];
+		n = rio_readlineb(rio, rest, sizeof(rest));
+		if (n <= 0) {
+			break;
+		}
+		length += n;
+		maxlen = sizeof(rest);
+		read_buf = rest;
+	}
+	countAnswer(length);
+	return;
+}
+
+// the number in a line of text, or ANSWER_NOTNUMBER if it holds anything other than decimal digits (and spaces):
+// no signs, no octal or hex, and nothing after the number
+static int parseNumber(const char *line) {
+	const char *at = line;
+	int value = 0;
+
+	while (*at == ' ' || *at == '\t') {
+		at++;
+	}
+	if (*at < '0' || *at > '9') {
+		return ANSWER_NOTNUMBER;
+	}
+	for (; *at >= '0' && *at <= '9'; at++) {
+		if (value > 99999) {			// (far past any choice)
+			return ANSWER_NOTNUMBER;
+		}
+		value = value * 10 + (*at - '0');
+	}
+	while (*at == ' ' || *at == '\t' || *at == '\r' || *at == '\n') {
+		at++;
+	}
+	return (*at == '\0') ? value : ANSWER_NOTNUMBER;
+}
+
+// reads a line from a text client, and returns the number in it (or ANSWER_NOTNUMBER)
+static int receiveNumber(int cfd) {
+	char line[TEXTANSWER];
+	receiveFromClient(cfd, line, sizeof(line));
+	return parseNumber(line);
+}
+
+// reads a number from a text client, and checks it against the prompt's choices (a set of numbers): returns the number
+// if it is one of them, and otherwise ANSWER_NOTNUMBER, ANSWER_OUTOFRANGE (it isn't in range either), or ANSWER_NOTLEGAL
+static int receiveChoice(int cfd, CardMask choices, CardMask range) {
+	int number = receiveNumber(cfd);
+	if (number == ANSWER_NOTNUMBER) {
+		return ANSWER_NOTNUMBER;
+	} else if (number >= 64 || ((range >> number) & 1) == 0) {
+		return ANSWER_OUTOFRANGE;
+	}
+	return (((choices >> number) & 1) != 0) ? number : ANSWER_NOTLEGAL;
+}
+
+// whether an answer is "resume" and something more (a token, well-formed or not)
+static bool asksToResume(const char *line) {
+	while (*line == ' ' || *line == '\t') {
+		line++;
+	}
+	return strncmp(line, "resume", 6) == 0 && (line[6] == ' ' || line[6] == '\t');
+}
+
+// the token in a "resume <token>" answer, or 0 if that isn't what the answer is (the token must be 1-16 hex digits,
+// and nothing but whitespace may follow it, so that a mistyped token is turned down rather than taken for another)
+static unsigned long long parseResume(const char *line) {
+	const char *at = line;
+	unsigned long long token = 0;
+	int digits = 0;
+
+	if (!asksToResume(line)) {
+		return 0;
+	}
+	while (*at == ' ' || *at == '\t') {
+		at++;
+	}
+	for (at += 6; *at == ' ' || *at == '\t'; at++) {}
+	for (; isxdigit(static_cast<unsigned char>(*at)); at++, digits++) {
+		token = (token << 4) | ((*at <= '9') ? *at - '0' : (*at | 0x20) - 'a' + 10);
+	}
+	while (*at == ' ' || *at == '\t' || *at == '\r' || *at == '\n') {
+		at++;
+	}
+	return (digits >= 1 && digits <= 16 && *at == '\0') ? token : 0;
+}
+
+// the game # in a "watch" or "watch <n>" answer (0 for "watch" alone), or -1 if that isn't what the answer is
+static int parseWatch(const char *line) {
+	const char *at = line;
+	int game = 0;
+
+	while (*at == ' ' || *at == '\t') {
+		at++;
+	}
+	if (strncmp(at, "watch", 5) != 0) {
+		return -1;
+	}
+	for (at += 5; *at == ' ' || *at == '\t'; at++) {}
+	for (; isdigit(static_cast<unsigned char>(*at)) && game < 100; at++) {
+		game = game * 10 + (*at - '0');
+	}
+	return (*at == '\0' || *at == '\r' || *at == '\n') ? game : -1;
 }
 
 /* =====================================
-MOVING CARDS BETWEEN HANDS & TABLE & SCORE PILE
+LISTINGS
 ===================================== */
 
-// deal n cards from the deck to the given hand
-void dealCards(DeckType &deck, Hand &hand, int n) {
-	int decksize = deck.cardCount();	// loop optimization
+static int viewListing(int type, int seat) {
+	return (type == WIRE_TABLE) ? VIEW_TABLE : ((type == WIRE_HAND) ? VIEW_HAND : VIEW_PILE) + seat;
+}
 
-	// if the deck doesn't have enough cards to deal that many cards, then we've done something wrong, so crash here:
-	if (n > decksize) {
-		// std::cerr << "ERROR: Cannot draw " << n << " cards, as deck has only " << decksize << "cards." << std::endl;
-		throw "ERROR: Tried to draw more cards than the deck has available.";
+// notes what the client has now been shown of a listing
+static void rememberListing(int cfd, int listing, CardMask cards, int raw, int final) {
+	ClientView &view = clientState(cfd).view;
+	if (clientState(cfd).muted) {
 		return;
 	}
+	view.shown[listing] = true;
+	view.cards[listing] = cards;
+	view.raw[listing]   = raw;
+	view.final[listing] = final;
+	return;
+}
 
-	// otherwise, draw n cards from the deck and add them to the given hand (by reference)
-	for (int i=0; i < n; i++) {			// this loop will occur 8 times
-		hand.addCard(deck.drawCard());	// take a card from the deck and add it to the chosen hand
+// a whole listing, as a frame (type: WIRE_HAND, WIRE_TABLE or WIRE_PILE)
+static WireFrame listingFrame(int type, int seat, CardMask cards, int raw, int final) {
+	if (type == WIRE_TABLE) {
+		return WireFrame(WIRE_TABLE).u64(cards);
+	} else if (type == WIRE_HAND) {
+		return WireFrame(WIRE_HAND).u8(seat).u64(cards);
 	}
+	return WireFrame(WIRE_PILE).u8(seat).u64(cards).u8(raw).u8(final);
+}
+
+// sends a binary client a whole listing
+static void sendFullListing(int cfd, int type, int seat, CardMask cards, int raw, int final) {
+	sendFrame(cfd, listingFrame(type, seat, cards, raw, final));
 	return;
 }
 
-// deal 8 cards to non-dealer, then 8 to table, then 8 to dealer
-void setup(DeckType &deck, Hand &dealer, Hand &nondealer, Hand &table, ScorePile &playerPile, ScorePile &cpuPile) {
-	// first, run cleanup() to initialize everything appropriately
-	cleanup(deck, dealer, nondealer, table, playerPile, cpuPile);	// empties deck, both hands, and table
-	// reset the deck and shuffle it
-	deck.initialize();							// deck gets all 48 cards
-	deck.shuffle();
-	// finally, deal to non-dealer, then table, then dealer
-	dealCards(deck, nondealer,	8);
-	dealCards(deck, table, 		8);
-	dealCards(deck, dealer,		8);
-	// at this point, the deck should have 24 cards left
-	if (deck.cardCount() != 24) {
-		throw "ERROR: Something went wrong with the dealing process! Deck does not have 24 cards.";
+// sends a binary client a listing: in full if it hasn't been shown it since the last resync (or didn't ask for deltas),
+// and otherwise only the cards that have come & gone since it was (or nothing at all, if none have)
+static void sendListing(int cfd, int type, int seat, CardMask cards, int raw = 0, int final = 0) {
+	int listing = viewListing(type, seat);
+	const ClientView &view = clientState(cfd).view;
+	if (clientState(cfd).deltas && view.shown[listing]) {
+		CardMask added   = cards & ~view.cards[listing];
+		CardMask removed = view.cards[listing] & ~cards;
+		if (added == 0 && removed == 0 && raw == view.raw[listing] && final == view.final[listing]) {
+			return;
+		}
+		WireFrame frame(WIRE_DELTA);
+		frame.u8(type).u8(seat).u8(raw).u8(final);
+		for (; added != 0; added &= added - 1) {
+			frame.u8(__builtin_ctzll(added));
+		}
+		for (; removed != 0; removed &= removed - 1) {
+			frame.u8(__builtin_ctzll(removed) | WIREREMOVED);
+		}
+		sendFrame(cfd, frame);
+	} else {
+		sendFullListing(cfd, type, seat, cards, raw, final);
 	}
+	rememberListing(cfd, listing, cards, raw, final);
 	return;
 }
 
-// resets & shuffles the deck, clears everyone's hands and score piles and the table
-void cleanup(DeckType &deck, Hand &dealer, Hand &nondealer, Hand &table, ScorePile &playerPile, ScorePile &cpuPile) {
-	// reset everyone's hands
-	dealer.destroy();
-	nondealer.destroy();
-	table.destroy();
-	// and score piles
-	playerPile.destroy();
-	cpuPile.destroy();
-	// and the deck
-	deck.destroy();
+// sends a binary client everything it has been shown since the last resync again, in full (for WIRE_REFRESH)
+static void resendView(int cfd) {
+	const ClientView &view = clientState(cfd).view;
+	for (int listing = 0; listing < VIEWLISTINGS; listing++) {
+		if (!view.shown[listing]) {
+			continue;
+		}
+		int type = (listing == VIEW_TABLE) ? WIRE_TABLE : ((listing < VIEW_PILE) ? WIRE_HAND : WIRE_PILE);
+		int seat = (listing == VIEW_TABLE) ? 0 : listing - ((listing < VIEW_PILE) ? VIEW_HAND : VIEW_PILE);
+		sendFullListing(cfd, type, seat, view.cards[listing], view.raw[listing], view.final[listing]);
+	}
 	return;
 }
 
+// reads one reply line from a JSON client, as receiveAnswer() does a frame
+static int receiveJsonAnswer(int cfd, unsigned char *payload) {
+	char line[JSONMAXREPLY];
+	JsonReply reply;
+	while (true) {
+		receiveFromClient(cfd, line, sizeof(line));
+		if (!parseJsonReply(line, strlen(line), reply)) {
+			return -1;
+		}
+		if (!reply.refresh) {
+			break;
+		}
+		resendView(cfd);
+	}
+	if (reply.text != NULL) {
+		return unescapeJson(reply.text, reply.textLength, payload, 255);
+	}
+	if (reply.hasNumber && reply.number >= 0 && reply.number <= 255) {
+		payload[0] = reply.number;
+		return 1;
+	}
+	return -1;
+}
+
+int receiveAnswer(int cfd, unsigned char *payload) {
+	TRACE_SCOPE("Rio_readn");
+	unsigned char header[WIREHEADER];
+	if (clientState(cfd).protocol == PROTOCOL_JSON) {
+		return receiveJsonAnswer(cfd, payload);
+	}
+	rio_t *rio = &clientState(cfd).input;
+	awaitAnswer();
+	while (true) {
+		if (rio_readnb(rio, header, WIREHEADER) != WIREHEADER || rio_readnb(rio, payload, header[1]) != header[1]) {
+			throw ClientGone{cfd};
+		}
+		if (header[0] != WIRE_REFRESH) {
+			break;
+		}
+		resendView(cfd);				// (and the prompt the client is answering still stands)
+	}
+	countAnswer(WIREHEADER + header[1]);
+	return (header[0] == WIRE_ANSWER) ? header[1] : -1;
+}
+
+// asks a binary client to pick one of the choices (card IDs, or numbers), until it does, and returns the one it picked
+static int askForChoice(int cfd, WirePrompt prompt, int card, CardMask choices) {
+	unsigned char answer[256];
+	while (true) {
+		sendFrame(cfd, WireFrame(WIRE_PROMPT).u8(prompt).u8(card).u64(choices));
+		int n = receiveAnswer(cfd, answer);
+		if (n >= 1 && answer[0] < 64 && ((choices >> answer[0]) & 1) != 0) {
+			return answer[0];
+		}
+		sendFrame(cfd, WireFrame(WIRE_REJECT));
+	}
+}
+
+// asks a binary client for text, into answer; returns its length, or -1 if the client sent something other than an answer
+static int askForText(int cfd, WirePrompt prompt, unsigned char *answer) {
+	sendFrame(cfd, WireFrame(WIRE_PROMPT).u8(prompt).u8(WIRENOCARD).u64(0));
+	return receiveAnswer(cfd, answer);
+}
+
+// the index in the hand of the card with the given ID
+static int indexOfId(const Hand &hand, int id) {
+	CardType card = CardType::fromId(id);
+	return hand.findFirstIndex(card.getMonth(), card.getDesign());
+}
+
+// every number from first to last, as a set of choices
+static CardMask numberChoices(int first, int last) {
+	return ((2ULL << last) - 1) & ~((1ULL << first) - 1);
+}
+
 /* =====================================
 PRINTING CURRENT GAME STATE
 ===================================== */
 
 // prints a nice header for the round information
 
-/*
-	// send ending message to user
-	write_buf.clear();
-	write_buf += "Press Enter to quit.\n";
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
-	// get response from user
-	Rio_readinitb(&rio, cfd);
-	Rio_readlineb(&rio, read_buf, 20);
-*/
-
 void printRoundHeader(int cfd, int roundNumber) {
-	string write_buf = "";
-
-	write_buf.clear();
-	write_buf += string("-----------------------------------------------\t");
-    write_buf += string("                BEGIN ROUND ") + to_string(roundNumber) + string("\t");
-	write_buf += string("-----------------------------------------------\t");
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+	TRACE_SCOPE("printRoundHeader");
+	resyncView(cfd);					// (every listing starts over with the deal)
+	if (sendEvent(cfd, WireFrame(WIRE_ROUND).u8(roundNumber))) {
+		return;
+	}
+	TextMessage(cfd).text("-----------------------------------------------\t")
+	                .text("                BEGIN ROUND ").number(roundNumber).text("\t")
+	                .text("-----------------------------------------------\t").send();
 	return;
 }
 
 // prints which player is the dealer this round
 void printDealer(int cfd, bool player_dealer) {
-	string write_buf = "";
-	write_buf.clear();
+	TRACE_SCOPE("printDealer");
+	if (sendEvent(cfd, WireFrame(WIRE_DEALER).u8(player_dealer ? 0 : 1))) {
+		return;
+	}
+	TextMessage message(cfd);
 
     if (player_dealer) {
-        write_buf = string("You are the dealer for this round.\t");
+        message.text("You are the dealer for this round.\t");
     } else {
-        write_buf = string("The CPU is the dealer for this round.\t");
+        message.text(clientState(cfd).them->name).text(" is the dealer for this round.\t");
     }
 
 	// newline for spacing
-	write_buf += string("\t");
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+	message.text("\t").send();
     return;
 }
 
 void printGetPoints(int cfd, const int score_to_add, const bool is_player) {
-	string write_buf = "";
-	write_buf.clear();
+	TRACE_SCOPE("printGetPoints");
+	if (sendEvent(cfd, WireFrame(WIRE_POINTS).u8(is_player ? 0 : 1).u8(score_to_add))) {
+		return;
+	}
+	TextMessage message(cfd);
 
 	if (is_player) {
-		write_buf = string("You cash in your score pile and receive ") + to_string(score_to_add) + string(" points.\t");
+		message.text("You cash in your score pile and receive ").number(score_to_add).text(" points.\t");
 	} else {	// it's the CPU's
-		write_buf = string("The CPU cashes in its score pile and receives ") + to_string(score_to_add) + string(" points.\t");
+		const OpponentWords &them = *clientState(cfd).them;
+		message.text(them.name).text(" cashes in ").text(them.its).text(" score pile and receives ").number(score_to_add).text(" points.\t");
 	}
 
 	// newline for spacing
-	write_buf += string("\t");
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+	message.text("\t").send();
 	return;
 }
 
 // print a message that the round has ended w/o anyone scoring points
 void printNoPoints(int cfd) {
-	string write_buf = "";
-	write_buf.clear();
-
-	write_buf = string("This round has ended without any player scoring points!\tProceeding to next round...\t");
-
-	// newline for spacing
-	write_buf += string("\t");
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+	TRACE_SCOPE("printNoPoints");
+	if (sendEvent(cfd, WireFrame(WIRE_POINTS).u8(WIRENOCARD).u8(0))) {
+		return;
+	}
+	sendToClient(cfd, "This round has ended without any player scoring points!\tProceeding to next round...\t\t");
 	return;
 }
 
 // print a message showing both players' points at the end of a round
 void printStandings(int cfd, const int playerScore, const int cpuScore) {
-	string write_buf = "";
-	write_buf.clear();
-
-	write_buf =  string("---CURRENT STANDINGS---\t");
-	write_buf += string("Your Score:  ") + to_string(playerScore) + string("\t");
-	write_buf += string("CPU's Score: ") + to_string(cpuScore) + string("\t");
-
-	// newline for spacing
-	write_buf += string("\t");
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+	TRACE_SCOPE("printStandings");
+	if (sendEvent(cfd, WireFrame(WIRE_STANDINGS).u16(playerScore).u16(cpuScore))) {
+		return;
+	}
+	TextMessage(cfd).text("---CURRENT STANDINGS---\t")
+	                .text("Your Score:  ").number(playerScore).text("\t")
+	                .text(clientState(cfd).them->label).text(" Score: ").number(cpuScore).text("\t")
+	                .text("\t").send();		// (newline for spacing)
 	return;
 }
 
 // print a message at the conclusion of the game
 void printFinalResults(int cfd, const int playerscore, const int cpuscore, const int totalrounds) {
-	string write_buf = "";
-	write_buf.clear();
+	TRACE_SCOPE("printFinalResults");
+	if (sendEvent(cfd, WireFrame(WIRE_FINAL).u16(playerscore).u16(cpuscore).u8(totalrounds))) {
+		return;
+	}
+	TextMessage message(cfd);
+	const OpponentWords &them = *clientState(cfd).them;
 
 	float player_avg = static_cast<float>(playerscore) / static_cast<float>(totalrounds);
 	float cpu_avg    = static_cast<float>(cpuscore)    / static_cast<float>(totalrounds);
 
 
-	write_buf  = string("-----------------------------------------------------\t");
-	write_buf += string("FINAL RESULTS:\t\t");
-	write_buf += string("Total # of Rounds:  ") + to_string(totalrounds) + string("\t");
-	write_buf += string("Your Total Points:  ") + to_string(playerscore) + string(", average of ") + to_string(player_avg) + string(" points per round\t");
-	write_buf += string("CPU's Total Points: ") + to_string(cpuscore)    + string(", average of ") + to_string(cpu_avg)    + string(" points per round\t");
+	message.text("-----------------------------------------------------\t");
+	message.text("FINAL RESULTS:\t\t");
+	message.text("Total # of Rounds:  ").number(totalrounds).text("\t");
+	message.text("Your Total Points:  ").number(playerscore).text(", average of ").decimal(player_avg).text(" points per round\t");
+	message.text(them.label).text(" Total Points: ").number(cpuscore).text(", average of ").decimal(cpu_avg).text(" points per round\t");
 
 	if (playerscore > cpuscore) {
-		write_buf += string("\tYou are the winner! Congratulations!\t");
+		message.text("\tYou are the winner! Congratulations!\t");
 	} else if (playerscore < cpuscore) {
-		write_buf += string("\tThe CPU wins. Better luck next time!\t");
+		message.text("\t").text(them.name).text(" wins. Better luck next time!\t");
 	} else {
-		write_buf += string("\tIt's a tie! How rare!\t");
+		message.text("\tIt's a tie! How rare!\t");
 	}
 
 	// newline for spacing
-	write_buf += string("\t");
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+	message.text("\t").send();
 	return;
 }
 
-// given the table and a list of indices from the table, prints all cards at those indices
-void printMatchOptions(int cfd, const Hand &table, const std::vector<int> &validTableCards) {
-	string write_buf = "";
-	write_buf.clear();
+// prints the best LEADERTOP players, and where the player stands if they aren't among them
+void printLeaderboard(int cfd, const string &name) {
+	TRACE_SCOPE("printLeaderboard");
+	char line[128];
+	Standing mine;
+
+	std::vector<Standing> top = topPlayers(LEADERTOP);
+	int rank = name.empty() ? 0 : playerRank(name, mine);
+
+	if (speaksFrames(cfd)) {
+		sendFrame(cfd, WireFrame(WIRE_LEADERS).u32(leaderboardPlayers()));
+		for (size_t i = 0; i < top.size() || (i == top.size() && rank > LEADERTOP); i++) {
+			const Standing &row = (i < top.size()) ? top[i] : mine;
+			sendFrame(cfd, WireFrame(WIRE_LEADER).u32((i < top.size()) ? i + 1 : rank).u32(row.wins).u32(row.games)
+			                                     .u32(row.average() * 1000).text(row.name.data(), row.name.length()));
+		}
+		return;
+	}
+	TextMessage message(cfd);
+	message.text("---LEADERBOARD--- (").number(leaderboardPlayers()).text(" players)\t");
+	message.text("      Player                    Wins  Games   Points/Round\t");
+	for (size_t i = 0; i < top.size(); i++) {
+		snprintf(line, sizeof(line), " %3d  %-24s %5ld  %5ld   %8.3f\t", static_cast<int>(i + 1), top[i].name.c_str(), top[i].wins, top[i].games, top[i].average());
+		message.text(line);
+	}
+	if (top.empty()) {
+		message.text("Nobody has finished a game yet.\t");
+	}
+	if (rank > LEADERTOP) {
+		snprintf(line, sizeof(line), " ...\t %3d  %-24s %5ld  %5ld   %8.3f\t", rank, mine.name.c_str(), mine.wins, mine.games, mine.average());
+		message.text(line);
+	}
 
-	std::vector<int>::const_iterator listend = validTableCards.end();	// for more efficient end checking
+	// newline for spacing
+	message.text("\t").send();
+	return;
+}
+
+// given the table and a set of indexes of cards on it, prints all cards at those indexes
+void printMatchOptions(int cfd, const Hand &table, CardMask validTableCards) {
+	TRACE_SCOPE("printMatchOptions");
+	if (speaksFrames(cfd)) {		// (the prompt that follows carries the choices)
+		return;
+	}
+	TextMessage message(cfd);
 
 	// print header
-	write_buf = string("These are the cards on the table that you can match:\t");
+	message.text("These are the cards on the table that you can match:\t");
 
-	// loop through all valid card indices given in the list
-	for (std::vector<int>::const_iterator it = validTableCards.begin(); it != listend; it++) {
-		write_buf += string(" (") + to_string(*it) + string(")  ") + table.getCard(*it).cardName() + string("\t"); // print index in parentheses, then card name
+	// loop through all valid card indexes given in the set
+	for (; validTableCards != 0; validTableCards &= validTableCards - 1) {
+		int index = __builtin_ctzll(validTableCards);
+		message.listed(index, table.getCard(index));
 	}
 	// newline for spacing
-	write_buf += string("\t");
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+	message.text("\t").send();
 	return;
 }
 
 // prints the hand of the player or CPU
 void printHandState(int cfd, const Hand &hand, bool is_player) {
-	string write_buf = "";
-	write_buf.clear();
+	TRACE_SCOPE("printHandState");
+	if (isFeatured(cfd)) {			// (spectators are always sent listings in full)
+		castFrame(cfd, listingFrame(WIRE_HAND, is_player ? 0 : 1, hand.cardMask(), 0, 0));
+	}
+	if (speaksFrames(cfd)) {
+		sendListing(cfd, WIRE_HAND, is_player ? 0 : 1, hand.cardMask());
+		return;
+	}
+	TextMessage message(cfd);
 
 	int size = hand.cardCount();
 
 	// print header
-	write_buf = string("These are the cards in ");
-	if (is_player) {
-		write_buf += string("your ");
-	} else {	// it's the CPU's
-		write_buf += string("CPU's ");
-	}
-	write_buf += string("hand:\t");
+	message.text("These are the cards in ").text(is_player ? "your" : clientState(cfd).them->owner).text(" hand:\t");
 
 	for (int i=0; i < size; i++) {	// for all indices of cards in the hand
-		write_buf += string(" (") + to_string(i) + string(")  ") + hand.getCard(i).cardName() + string("\t"); // print index in parentheses, then card name
+		message.listed(i, hand.getCard(i));
 	}
 
 	// newline for spacing
-	write_buf += string("\t");
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+	message.text("\t").send();
 	return;
 }
 
 // prints all the cards on the table
 void printTableState(int cfd, const Hand &table) {
-	string write_buf = "";
-	write_buf.clear();
+	TRACE_SCOPE("printTableState");
+	if (isFeatured(cfd)) {
+		castFrame(cfd, listingFrame(WIRE_TABLE, 0, table.cardMask(), 0, 0));
+	}
+	if (speaksFrames(cfd)) {
+		sendListing(cfd, WIRE_TABLE, 0, table.cardMask());
+		return;
+	}
+	TextMessage message(cfd);
 
 	int size = table.cardCount();
 
 	// print header
-	write_buf = string("These are the cards on the table:\t");
+	message.text("These are the cards on the table:\t");
 
 	for (int i=0; i < size; i++) {	// for all indices of cards on the table
-		write_buf += string(" (") + to_string(i) + string(")  ") + table.getCard(i).cardName() + string("\t"); // print index in parentheses, then card name
+		message.listed(i, table.getCard(i));
 	}
 
 	// newline for spacing
-	write_buf += string("\t");
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+	message.text("\t").send();
 	return;
 }
 
 // print out all the cards in the score pile
 void printScoreState(int cfd, const ScorePile &scorepile, bool opponentKK, bool is_player) {
-	string write_buf = "";
-	write_buf.clear();
+	TRACE_SCOPE("printScoreState");
+	if (isFeatured(cfd)) {
+		castFrame(cfd, listingFrame(WIRE_PILE, is_player ? 0 : 1, scorepile.cardMask(), scorepile.rawScore(), scorepile.finalScore(opponentKK)));
+	}
+	if (speaksFrames(cfd)) {		// (the values go in the same frame)
+		sendListing(cfd, WIRE_PILE, is_player ? 0 : 1, scorepile.cardMask(), scorepile.rawScore(), scorepile.finalScore(opponentKK));
+		return;
+	}
+	TextMessage message(cfd);
+	const char *owner = is_player ? "your" : clientState(cfd).them->owner;
 
 	int size = scorepile.cardCount();
+	int listing = VIEW_PILE + (is_player ? 0 : 1);
 	// scorepile.sortCards();
 
-	// print header
-	write_buf = string("These are the cards in ");
-	if (is_player) {
-		write_buf += string("your ");
-	} else {	// it's the CPU's
-		write_buf += string("CPU's ");
+	const ClientView &view = clientState(cfd).view;
+	if (clientState(cfd).deltas && view.shown[listing]) {		// only the cards added since the pile was last shown (if any)
+		CardMask added = scorepile.cardMask() & ~view.cards[listing];
+		if (added != 0) {
+			message.text("These cards were added to ").text(owner).text(" score pile:\t");
+			for (; added != 0; added &= added - 1) {
+				message.text("      ").card(CardType::fromId(__builtin_ctzll(added))).text("\t");
+			}
+			message.send();
+		}
+		rememberListing(cfd, listing, scorepile.cardMask(), 0, 0);
+		printScoreValue(cfd, scorepile, opponentKK, is_player);
+		return;
 	}
-	write_buf += string("score pile:\t");
+
+	// print header
+	message.text("These are the cards in ").text(owner).text(" score pile:\t");
 
 	for (int i=0; i < size; i++) {	// for all indices of cards in the score pile
-		write_buf += string(" (") + to_string(i) + string(")  ") + scorepile.getCard(i).cardName() + string("\t"); // print index in parentheses, then card name
+		message.listed(i, scorepile.getCard(i));
 	}
 
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+	message.send();
+	rememberListing(cfd, listing, scorepile.cardMask(), 0, 0);
 	printScoreValue(cfd, scorepile, opponentKK, is_player);
 	return; 
 }
 
 // prints current potential points in the given score pile
 void printScoreValue(int cfd, const ScorePile &scorepile, bool opponentKK, bool is_player) {
-	string write_buf = "";
-	write_buf.clear();
-
-	write_buf = string("Raw points in ");
-	if (is_player) {
-		write_buf += string("your ");
-	} else {	// it's the CPU's
-		write_buf += string("CPU's ");
+	TRACE_SCOPE("printScoreValue");
+	if (speaksFrames(cfd)) {
+		sendListing(cfd, WIRE_PILE, is_player ? 0 : 1, scorepile.cardMask(), scorepile.rawScore(), scorepile.finalScore(opponentKK));
+		return;
 	}
+	TextMessage message(cfd);
 
-	write_buf += string("score pile: ")                           + to_string(scorepile.rawScore())             + string("\t");
-	write_buf += string("With bonuses, this would be scored as ") + to_string(scorepile.finalScore(opponentKK)) + string(" points.\t");
+	message.text("Raw points in ").text(is_player ? "your" : clientState(cfd).them->owner).text(" ");
+
+	message.text("score pile: ")                           .number(scorepile.rawScore())             .text("\t");
+	message.text("With bonuses, this would be scored as ").number(scorepile.finalScore(opponentKK)).text(" points.\t");
 	
 	// newline for spacing
-	write_buf += string("\t");
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+	message.text("\t").send();
 	
 	return;
 }
 
+// prints the CPU's choice between calling Koi-Koi and ending the round
+void printComputerKoiKoi(int cfd, bool called_KK) {
+	TRACE_SCOPE("printComputerKoiKoi");
+	if (sendEvent(cfd, WireFrame(WIRE_KOIKOI).u8(1).u8(called_KK))) {
+		return;
+	}
+	TextMessage message(cfd);
+
+	const OpponentWords &them = *clientState(cfd).them;
+	message.text(them.name).text(" has collected a combo in ").text(them.its).text(" score pile, and can end this round or call Koi-Koi.\t");
+	message.text(them.name).text("'s choice is: ");
+	if (called_KK) {
+		message.text("Koi-Koi!\t");
+	} else {
+		message.text("End the round.\t");
+	}
+	message.text("\t").send();
+	return;
+}
+
+// prints that a seat (0 = player, 1 = CPU, 2 = the table) was dealt an instant win
+void printInstantWin(int cfd, int seat, bool fourOfAKind) {
+	TRACE_SCOPE("printInstantWin");
+	if (sendEvent(cfd, WireFrame(WIRE_INSTANTWIN).u8(seat).u8(fourOfAKind))) {
+		return;
+	}
+	TextMessage message(cfd);
+	const OpponentWords &them = *clientState(cfd).them;
+	if (seat == 0) {
+		message.text("You were");
+	} else if (seat == 1) {
+		message.text(them.name).text(" was");
+	} else {
+		message.text("The Table was");
+	}
+	message.text(fourOfAKind ? " dealt four of a kind" : " dealt four pairs of matching cards").text("--an instant-win combo!\t");
+	if (seat == 0) {
+		message.text("You score 6 points, and this round is over.\t");
+	} else if (seat == 1) {
+		message.text(them.name).text(" scores 6 points, and this round is over.\t");
+	} else {
+		message.text("This deal is null and void, and the round will be re-dealt.\t");
+	}
+	message.send();
+	return;
+}
+
+// prints the hand card the player or CPU played this turn, and what it took (a card given up is described by the prompt for it)
+void printPlay(int cfd, const TurnRecord &turn, bool is_player) {
+	TRACE_SCOPE("printPlay");
+	if (sendEvent(cfd, WireFrame(WIRE_PLAY).u8(is_player ? 0 : 1).u8(turn.handCard.cardId()).u8(turn.matchedHand ? turn.handTarget.cardId() : WIRENOCARD))) {
+		return;
+	}
+	TextMessage message(cfd);
+	if (is_player) {
+		if (turn.matchedHand) {
+			message.text("Your reveal this card from your hand:   ").card(turn.handCard)  .text("\t");
+			message.text("You match it to this card on the table: ").card(turn.handTarget).text("\t");
+			message.text("Both cards are put in your score pile.\t\t");
+		}
+	} else if (!turn.matchedHand) {
+		const OpponentWords &them = *clientState(cfd).them;
+		message.text(them.actor).text(" cannot match any card from ").text(them.its).text(" hand with any card on the table,\t");
+		message.text("so instead ").text(them.it).text(" sacrifices this card to the table: ").card(turn.handCard).text("\t\t");
+	} else {
+		const OpponentWords &them = *clientState(cfd).them;
+		message.text(them.actor).text(" reveals this card from ").text(them.its).text(" hand: ").card(turn.handCard)  .text("\t");
+		message.text(them.It).text(" matches it to this card on the table:  ").card(turn.handTarget).text("\t");
+		message.text("Both cards are put in ").text(them.the).text("'s score pile.\t\t");
+	}
+	message.send();					// (nothing, if there is nothing to say)
+	return;
+}
+
+// prints the card the player or CPU drew from the deck this turn, and what it took
+void printDraw(int cfd, const TurnRecord &turn, bool is_player) {
+	TRACE_SCOPE("printDraw");
+	if (sendEvent(cfd, WireFrame(WIRE_DRAW).u8(is_player ? 0 : 1).u8(turn.deckCard.cardId()).u8(turn.matchedDeck ? turn.deckTarget.cardId() : WIRENOCARD))) {
+		return;
+	}
+	TextMessage message(cfd);
+	if (is_player) {
+		message.text("You reveal this card from the deck:      ").card(turn.deckCard).text("\t");
+		if (!turn.matchedDeck) {
+			message.text("You cannot match this card with any card on the table, so it is added to the table.\t\t");
+		} else {
+			message.text("You match this card with the table card: ").card(turn.deckTarget).text("\t");
+			message.text("Both cards are put in your score pile.\t\t");
+		}
+	} else {
+		const OpponentWords &them = *clientState(cfd).them;
+		message.text(them.actor).text(" reveals this card from the deck: ").card(turn.deckCard).text("\t");
+		if (!turn.matchedDeck) {
+			message.text(them.actor).text(" cannot match this card with any card on the table, so it is added to the table.\t\t");
+		} else {
+			message.text(them.actor).text(" matches this card with the table card: ").card(turn.deckTarget).text("\t");
+			message.text("Both cards are put in ").text(them.the).text("'s score pile.\t\t");
+		}
+	}
+	message.send();
+	return;
+}
+
+// prints the token the player can resume the game with
+void printToken(int cfd, unsigned long long token) {
+	TRACE_SCOPE("printToken");
+	if (speaksFrames(cfd)) {
+		sendFrame(cfd, WireFrame(WIRE_TOKEN).u64(token));
+		return;
+	}
+	char message[160];
+	snprintf(message, sizeof(message), "Your game's token is %016llx. If you are cut off, reconnect and enter \"resume %016llx\" to carry on.\t\t", token, token);
+	sendToClient(cfd, message);
+	return;
+}
+
+// prints that the game has been resumed (or that there was none to resume with the token the player gave)
+void printResumed(int cfd, bool resumed) {
+	TRACE_SCOPE("printResumed");
+	if (speaksFrames(cfd)) {
+		sendFrame(cfd, WireFrame(resumed ? WIRE_RESUMED : WIRE_REJECT));
+		return;
+	}
+	if (resumed) {
+		sendToClient(cfd, "Your game has been resumed where it left off.\t");
+	} else {
+		sendToClient(cfd, "There is no game waiting to be resumed with that token.\t");
+	}
+	return;
+}
+
+// prints who the player is up against this game: a CPU strategy, or (OPPONENT_ARENA) another client, by its name
+void printOpponent(int cfd, int opponent, const string &name) {
+	TRACE_SCOPE("printOpponent");
+	clientState(cfd).them = (opponent == OPPONENT_ARENA) ? &playerWords : &cpuWords;
+	if (sendEvent(cfd, WireFrame(WIRE_OPPONENT).u8(opponent+1).text(name.data(), name.length()))) {
+		return;
+	}
+	if (opponent != OPPONENT_ARENA) {
+		TextMessage(cfd).text("You are playing against the ").text(name.c_str()).text(" CPU.\t\t").send();
+	} else if (name.empty()) {
+		sendToClient(cfd, "You are playing against another player, who is unranked.\t\t");
+	} else {
+		TextMessage(cfd).text("You are playing against another player: ").text(name.c_str()).text(".\t\t").send();
+	}
+	return;
+}
+
+// prints that the opponent's connection was lost, which ends the game (unscored)
+void printAbandoned(int cfd) {
+	TRACE_SCOPE("printAbandoned");
+	if (sendEvent(cfd, WireFrame(WIRE_ABANDONED))) {
+		return;
+	}
+	sendToClient(cfd, "Your opponent's connection was lost, so the game is over. It will not be scored.\t\t");
+	return;
+}
+
+// prints what the opponent did on its turn: the card it played from its hand, the one it drew from the deck, and
+// whether it called koi-koi, if it had to choose
+void printOpponentTurn(int cfd, const TurnRecord &turn) {
+	printPlay(cfd, turn, false);
+	printDraw(cfd, turn, false);
+	if (turn.scored) {
+		printComputerKoiKoi(cfd, turn.calledKK);
+	}
+	return;
+}
+
 /* =====================================
 PROMPTING THE USER
 ===================================== */
+// prompt the user for which CPU strategy they want to play against this game, or another player (see "serv-match.hpp")
+int promptOpponent(int cfd) {
+	int user_choice = -1;
+
+	if (speaksFrames(cfd)) {
+		for (int k = 0; k < NUMSTRATEGIES; k++) {
+			const char *name = strategyName(static_cast<StrategyKind>(k));
+			sendFrame(cfd, WireFrame(WIRE_OPTION).u8(k+1).text(name, strlen(name)));
+		}
+		sendFrame(cfd, WireFrame(WIRE_OPTION).u8(OPPONENT_ARENA+1).text("Arena", 5));
+		return askForChoice(cfd, WIREPROMPT_STRATEGY, WIRENOCARD, numberChoices(1, OPPONENT_ARENA+1)) - 1;
+	}
+	TextMessage message(cfd);
+
+	message.text("Which opponent would you like to play against?\t");
+	for (int k = 0; k < NUMSTRATEGIES; k++) {		// list every registered strategy
+		message.text(" [").number(k+1).text("]  ").text(strategyName(static_cast<StrategyKind>(k))).text("\t");
+	}
+	message.text(" [").number(OPPONENT_ARENA+1).text("]  Another player\t").send();
+
+	do {
+		// send prompt
+		message.text("Enter a number 1-").number(OPPONENT_ARENA+1).text(":\n").send();	//newline to end message
+
+		// receive & interpret response
+		user_choice = receiveChoice(cfd, numberChoices(1, OPPONENT_ARENA+1), numberChoices(1, OPPONENT_ARENA+1));
+
+		// break if user entered a valid choice
+		if (user_choice >= 1)
+			break;
+		// else
+		message.text("You must enter a number between 1 and ").number(OPPONENT_ARENA+1).text(", inclusive.\t").send();
+	} while (true);
+
+	// newline for spacing
+	message.text("\t").send();
+
+	return user_choice - 1;
+}
+
+// prompt the user for the name their games go on the leaderboard under (returns "" if they'd rather not be on it),
+// or for the token of a game to resume (returned in resume_token, which is otherwise 0), or for a featured game to
+// watch (returned in watch_game, which is otherwise -1)
+string promptPlayerName(int cfd, unsigned long long &resume_token, int &watch_game) {
+	char read_buf[256];					// (the longest answer a binary client can send, and its '\0')
+	char *answer;
+
+	while (true) {
+		answer = read_buf;
+		if (speaksFrames(cfd)) {
+			int n;
+			while ((n = askForText(cfd, WIREPROMPT_NAME, reinterpret_cast<unsigned char*>(read_buf))) < 0) {}
+			read_buf[n] = '\0';
+		} else {
+			TextMessage(cfd).text("What name should your games go on the leaderboard under? (Leave it blank to play unranked.)\t")
+			                .text("(Or, to carry on with a game that was cut off, enter \"resume\" and the game's token.)\t")
+			                .text("Enter a name:\n").send();
+			receiveFromClient(cfd, read_buf, LEADERNAME + 8);
+			unsigned char hello = read_buf[0];
+			bool handshake = (hello != 0 && (hello & ~(WIREHELLO | WIREDELTAS | WIREJSON)) == 0
+			                  && (hello & (WIREHELLO | WIREJSON)) != (WIREHELLO | WIREJSON));
+			if (handshake) {		// a handshake byte (see "koikoi-wire.hpp")
+				clientState(cfd).deltas = (hello & WIREDELTAS) != 0;
+				if ((hello & (WIREHELLO | WIREJSON)) != 0) {
+					clientState(cfd).protocol = ((hello & WIREJSON) != 0) ? PROTOCOL_JSON : PROTOCOL_BINARY;
+					sendFrame(cfd, WireFrame(WIRE_HELLO).u8(WIREVERSION).u8(hello));
+				}
+				answer++;
+			}
+		}
+		resume_token = parseResume(answer);
+		if (resume_token != 0 || !asksToResume(answer)) {
+			break;
+		}
+		printResumed(cfd, false);		// (a mistyped token is turned down, rather than taken as a name, and the client asked again)
+	}
+	watch_game = parseWatch(answer);
+	if (resume_token != 0 || watch_game >= 0) {
+		return string("");
+	}
+	return leaderName(answer);
+}
+
+// prompt the user for how many rounds to play (1-12)
+int promptRounds(int cfd) {
+	int rounds = 0;
+
+	if (speaksFrames(cfd)) {
+		return askForChoice(cfd, WIREPROMPT_ROUNDS, WIRENOCARD, numberChoices(1, 12));
+	}
+
+	sendToClient(cfd, "How many rounds of koi-koi would you like to play?\t");
+	do {	//infinite loop until the user cooperates
+		// send message to client
+		sendToClient(cfd, "Enter a number 1-12:\n");							// newline to end this message
+		// read client's response
+		rounds = receiveChoice(cfd, numberChoices(1, 12), numberChoices(1, 12));
+		// if invalid response, prompt client to insert again
+		if (rounds < 1) {
+			sendToClient(cfd, "You must enter a number between 1 and 12, inclusive.\t");
+		}
+	} while (rounds < 1);
+	return rounds;
+}
+
+// prompt the user, once the game is over, to see the leaderboard, quit, or play again
+AfterGame promptAfterGame(int cfd) {
+	if (speaksFrames(cfd)) {
+		return static_cast<AfterGame>(askForChoice(cfd, WIREPROMPT_AFTER, WIRENOCARD, numberChoices(AFTER_LEADERBOARD, AFTER_AGAIN)));
+	}
+
+	sendToClient(cfd, "Enter 97 to play again, 98 to see the leaderboard, or 99 to quit.\n");
+	// get response from user
+	switch (receiveNumber(cfd)) {
+		case 97:
+			return AFTER_AGAIN;
+		case 98:
+			return AFTER_LEADERBOARD;
+		default:						// (any other response ends the session)
+			return AFTER_QUIT;
+	}
+}
+
 // prompt the user to call Koi-Koi or not, returing true if they did choose to call it
 bool promptKoiKoi(int cfd, const ScorePile &playerPile, const int cpuScore, bool cpuCalledKK) {
-	rio_t rio;
-	string write_buf = "";
-	char read_buf[MAXLINE];
-	write_buf.clear();
-
 	int user_choice = -1;
 	bool to_return;
 
-	write_buf  = string("You have made a new combo in your score pile! You can choose to end the game now, if you wish.\t");
-	write_buf += string("If you do, then you will score ") + to_string(playerPile.finalScore(cpuCalledKK)) + string(" points. If you do not, then you must call \"Koi-Koi\".\t");
-	write_buf += string("Calling \"Koi-Koi\" will continue the game so you can try to get more combos.\t");
-	write_buf += string("However, if your opponent ends the round after this, you will score 0 points,\t");
-	write_buf += string("and your opponent will score double their raw amount of points.\t");
-	write_buf += string("If the CPU ended the round immediately, they would gain at least ") + to_string(cpuScore) + string(" points.\t");
-	write_buf += string("\tWould you like to call \"Koi-Koi\", or end the round?\t");
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+	if (speaksFrames(cfd)) {
+		to_return = (askForChoice(cfd, WIREPROMPT_KOIKOI, WIRENOCARD, numberChoices(1, 2)) == 1);
+		sendEvent(cfd, WireFrame(WIRE_KOIKOI).u8(0).u8(to_return));
+		return to_return;
+	}
+	TextMessage message(cfd);
+
+	message.text("You have made a new combo in your score pile! You can choose to end the game now, if you wish.\t");
+	message.text("If you do, then you will score ").number(playerPile.finalScore(cpuCalledKK)).text(" points. If you do not, then you must call \"Koi-Koi\".\t");
+	message.text("Calling \"Koi-Koi\" will continue the game so you can try to get more combos.\t");
+	message.text("However, if your opponent ends the round after this, you will score 0 points,\t");
+	message.text("and your opponent will score double their raw amount of points.\t");
+	message.text("If ").text(clientState(cfd).them->the).text(" ended the round immediately, they would gain at least ").number(cpuScore).text(" points.\t");
+	message.text("\tWould you like to call \"Koi-Koi\", or end the round?\t").send();
 
-	write_buf.clear();
 	do {
 		// send prompt
-		write_buf = string("Please enter [1] to call Koi-Koi, or [2] to end the round: \n");	//newline to end message
-		Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+		sendToClient(cfd, "Please enter [1] to call Koi-Koi, or [2] to end the round: \n");	//newline to end message
 
 		// receive & interpret response
-		Rio_readinitb(&rio, cfd);
-		Rio_readlineb(&rio, read_buf, 20);
-		sscanf(read_buf, "%i", &user_choice);
+		user_choice = receiveChoice(cfd, numberChoices(1, 2), numberChoices(1, 2));
 
 		// break if user entered a valid choice
-		if (user_choice == 1 || user_choice == 2)
+		if (user_choice >= 1)
 			break;
 		// else
-		write_buf.clear();
-		write_buf = string("Your choice must be [1] for Koi-Koi, or [2] to end the round.\t");
-		Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+		sendToClient(cfd, "Your choice must be [1] for Koi-Koi, or [2] to end the round.\t");
 	} while (true);
 
 
 	if (user_choice == 1) {				// if they call "Koi-Koi"
-		write_buf.clear();
-		write_buf = string("You say: \"Koi-Koi!\"\t");
-		Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+		sendToClient(cfd, "You say: \"Koi-Koi!\"\t");
 		to_return = true;
 	}
 	else { // if (user_choice == 2)		// if they end the round
-		write_buf.clear();
-		write_buf = string("You choose to end the round.\t");
-		Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+		sendToClient(cfd, "You choose to end the round.\t");
 		to_return = false;
 	}
 
 	// newline for spacing
-	write_buf.clear();
-	write_buf = string("\t");
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+	sendToClient(cfd, "\t");
 
+	castFrame(cfd, WireFrame(WIRE_KOIKOI).u8(0).u8(to_return));
 	return to_return;
 }
 
 // prompt the user for which card in their hand they want to play
 // ASSUMES THAT THE PLAYER HAS A MATCHABLE CARD!
 int promptHandCardToPlay(int cfd, const Hand &hand, const Hand &table) {
-	rio_t rio;
-	string write_buf = "";
-	char read_buf[MAXLINE];
-	write_buf.clear();
-
 	int chosen_index = -1;
 	int handsize = hand.cardCount();
-	std::vector<int> dummy;
 
 	printTableState(cfd, table);		// print cards on the table
 	printHandState(cfd, hand, true);	// print cards in player's hand
+	if (speaksFrames(cfd)) {
+		return indexOfId(hand, askForChoice(cfd, WIREPROMPT_PLAY, WIRENOCARD, playableCards(hand, table)));
+	}
+	TextMessage message(cfd);
+
+	CardMask playable = 0;				// (the indexes of the cards that can match)
+	for (int i = 0; i < handsize; i++) {
+		playable |= (matchableCards(hand.getCard(i), table) != 0) ? 1ULL << i : 0;
+	}
 
 	// ask which one they want to match, not letting them continue until we get a satisfactory answer
 	while (true) {
-		// send prompt
-		write_buf += string("Which card from your hand would you like to use for matching?\tEnter the index of the card: \n");	//newline to end message
-		Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+		// send prompt (after what was wrong with the last answer, if anything)
+		message.text("Which card from your hand would you like to use for matching?\tEnter the index of the card: \n").send();	//newline to end message
 
 		// get client input
-		Rio_readinitb(&rio, cfd);
-		Rio_readlineb(&rio, read_buf, 20);
-		sscanf(read_buf, "%i", &chosen_index);		// try converting it to an integer
+		chosen_index = receiveChoice(cfd, playable, numberChoices(0, handsize - 1));
 
 		// spacing
-		write_buf.clear();
-		write_buf = string("\t");
-		Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
-
-		write_buf.clear();
-		if (read_buf[0] < '0' || read_buf[0] > '9') {			// if not a valid integer input
-			write_buf = string("That is not a valid number. Please enter a digit.\t");
-		} else if (chosen_index < 0 || chosen_index >= handsize) {	// if valid integer, but invalid card index
-			write_buf = string("That is not a valid index for the cards in your hand. Please try again.\t");
-		} else if (!findMatches(hand.getCard(chosen_index), table, dummy)) {	// if valid index, but no matching cards
-			write_buf = string("The table has no cards that can match that one. Please enter a different card.\t");
+		message.text("\t").send();
+
+		if (chosen_index == ANSWER_NOTNUMBER) {			// if not a valid integer input
+			message.text("That is not a valid number. Please enter a digit.\t");
+		} else if (chosen_index == ANSWER_OUTOFRANGE) {	// if valid integer, but invalid card index
+			message.text("That is not a valid index for the cards in your hand. Please try again.\t");
+		} else if (chosen_index == ANSWER_NOTLEGAL) {	// if valid index, but no matching cards
+			message.text("The table has no cards that can match that one. Please enter a different card.\t");
 		} else {	// valid index, and there is at least one matching card
 			break;
 		}
@@ -471,44 +1212,37 @@ int promptHandCardToPlay(int cfd, const Hand &hand, const Hand &table) {
 // prompt the user for which card on the table they want to match with their card
 // ASSUMES THAT THERE IS A VALID MATCH!
 int promptTableCardToMatch(int cfd, const CardType matcher, const Hand &table) {
-	rio_t rio;
-	string write_buf = "";
-	char read_buf[MAXLINE];
-	write_buf.clear();
-
 	int chosen_index = -1;
 	int tablesize = table.cardCount();
 
-	std::vector<int> matchingCards;
-	findMatches(matcher, table, matchingCards);
-	printMatchOptions(cfd, table, matchingCards);
+	if (speaksFrames(cfd)) {
+		return indexOfId(table, askForChoice(cfd, WIREPROMPT_MATCH, matcher.cardId(), matchableCards(matcher, table)));
+	}
+
+	CardMask matching = 0;				// (the indexes of the table cards it can match)
+	for (int i = 0; i < tablesize; i++) {
+		matching |= theseCardsMatch(matcher, table.getCard(i)) ? 1ULL << i : 0;
+	}
+	printMatchOptions(cfd, table, matching);
+	TextMessage message(cfd);
 
 	while (true) {
 		// send prompt
-		write_buf  = string("You are matching the card: ") + matcher.cardName() + string("\t");
-		write_buf += string("Which card from the table would you like to match with that card?\tEnter the index of the table card:\n");
-		Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+		message.text("You are matching the card: ").card(matcher).text("\t");
+		message.text("Which card from the table would you like to match with that card?\tEnter the index of the table card:\n").send();
 
 		// get client input
-		Rio_readinitb(&rio, cfd);
-		Rio_readlineb(&rio, read_buf, 20);
-		sscanf(read_buf, "%i", &chosen_index);		// try converting it to an integer
+		chosen_index = receiveChoice(cfd, matching, numberChoices(0, tablesize - 1));
 
 		// spacing
-		write_buf.clear();
-		write_buf = string("\t");
-		Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
-
-		write_buf.clear();
-		if (read_buf[0] < '0' || read_buf[0] > '9') {									// if not a valid integer input
-			write_buf = string("That is not a valid number. Please enter a digit.\t");
-			Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
-		} else if (chosen_index < 0 || chosen_index >= tablesize) {							// if valid integer, but invalid card index
-			write_buf = string("That is not a valid index for the cards on the table. Please try again.\t");
-			Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
-		} else if ( std::find(matchingCards.begin(), matchingCards.end(), chosen_index) == matchingCards.end()) {	// if valid card index, but not matching
-			write_buf = string("That card cannot be matched by your card. Please try again.\t");
-			Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+		message.text("\t").send();
+
+		if (chosen_index == ANSWER_NOTNUMBER) {									// if not a valid integer input
+			message.text("That is not a valid number. Please enter a digit.\t").send();
+		} else if (chosen_index == ANSWER_OUTOFRANGE) {							// if valid integer, but invalid card index
+			message.text("That is not a valid index for the cards on the table. Please try again.\t").send();
+		} else if (chosen_index == ANSWER_NOTLEGAL) {	// if valid card index, but not matching
+			message.text("That card cannot be matched by your card. Please try again.\t").send();
 		} else {	// if valid card
 			break;
 		}
@@ -518,168 +1252,50 @@ int promptTableCardToMatch(int cfd, const CardType matcher, const Hand &table) {
 }
 
 int promptGiveUpCard(int cfd, const Hand &hand) {
-	rio_t rio;
-	string write_buf = "";
-	char read_buf[MAXLINE];
-	write_buf.clear();
-
 	int chosen_index = -1;
 	int handsize = hand.cardCount();
+
+	if (speaksFrames(cfd)) {
+		printHandState(cfd, hand, true);
+		return indexOfId(hand, askForChoice(cfd, WIREPROMPT_GIVEUP, WIRENOCARD, hand.cardMask()));
+	}
 	
 	// send prompt
-	write_buf  = string("You cannot match any card from you hand with any card on the table,\t");
-	write_buf += string("so instead, you must choose a card to give up to the table.\t");
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+	sendToClient(cfd, "You cannot match any card from you hand with any card on the table,\tso instead, you must choose a card to give up to the table.\t");
 
 	printHandState(cfd, hand, true);	// print player's hand
 
 	while (true) {
 		// send prompt part 2
-		write_buf.clear();
-		write_buf = string("Which card to you choose to give up? Enter the index of the card: \n");
+		sendToClient(cfd, "Which card to you choose to give up? Enter the index of the card: \n");
 
 		// get client input
-		Rio_readinitb(&rio, cfd);
-		Rio_readlineb(&rio, read_buf, 20);
-		sscanf(read_buf, "%i", &chosen_index);		// try converting it to an integer
+		chosen_index = receiveChoice(cfd, numberChoices(0, handsize - 1), numberChoices(0, handsize - 1));
 		
-		write_buf.clear();
-		if (read_buf[0] < '0' || read_buf[0] > '9') {									// if not a valid integer input
-			write_buf = string("\tThat is not a valid number. Please enter a digit.\t");
-			Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
-		} else if (chosen_index < 0 || chosen_index >= handsize) {							// if valid integer, but invalid card index
-			write_buf = string("\tThat is not a valid index for the cards in your hand. Please try again.\t");
-			Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+		if (chosen_index == ANSWER_NOTNUMBER) {									// if not a valid integer input
+			sendToClient(cfd, "\tThat is not a valid number. Please enter a digit.\t");
+		} else if (chosen_index < 0) {											// if valid integer, but invalid card index
+			sendToClient(cfd, "\tThat is not a valid index for the cards in your hand. Please try again.\t");
 		} else {	// if valid card
-			write_buf = string("You add the card to the table.\t");
-			Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+			sendToClient(cfd, "You add the card to the table.\t");
 			break;
 		}
 	}
 
 	// newline for spacing
-	write_buf.clear();
-	write_buf = string("\t");
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+	sendToClient(cfd, "\t");
 
 	return chosen_index;
 }
 
-/* =====================================
-SIMULATING THE COMPUTER PLAYER
-===================================== */
-
-// simulates the computer choosing a card in their hand to match to one on the table
-// 		hand_choice:  -1 if no can do, otherwise index of hand card to match  (update by reference)
-// 		table_choice: -1 if no can do, otherwise index of table card to match (return value)
-int computerChooseHandCardToPlay(const Hand &hand, const Hand &table, int &hand_choice) {
-	int table_choice;					// return value: index of table card to match (-1 if not possible)
-	int handsize  = hand.cardCount();	// # of cards in hand
-	std::vector<int> matching_cards;		// list of indices of cards on the table that can be matched
-
-	// randomize seed
-	std::srand(std::time(NULL));
-
-	// first, try to match a card from the table
-	if (noCardsToPlay(hand, table)) {
-		// printf("Computer has no cards in hand to match a table card.\tContinuing to next phase.\t");
-		hand_choice  = -1;
-		table_choice = -1;
-		// printf("\t");
-	} else {
-		// first, randomly choose a card in hand to play
-		while (true) {
-			hand_choice = std::rand() % handsize;	// generate a valid index for a card in the CPU's hand
-			if (findMatches(hand.getCard(hand_choice), table, matching_cards)) {	// if that card can match something on the table
-				break;
-			}
-			// continue until we get a good card for hand_choice
-		}
-
-		// next, randomly choose a table card from matching_cards to match it to
-		table_choice = std::rand() % matching_cards.size();	// grab a random index from matching_cards
-		table_choice = matching_cards[table_choice];		// grab and grab the *table card* index stored at that matching_cards index
-	}
-
-	// hand_choice:  -1 if no can do, otherwise index of hand card to match  (update by reference)
-	// table_choice: -1 if no can do, otherwise index of table card to match (return value)
-	return table_choice;
-}
-
-
-// takes a card from the deck & the table, and returns the index of the card on the table to be matched to
-int computerChooseTableCardToMatch(const CardType matcher, const Hand &table) {
-	int table_choice;					// return value: index of table card to match (-1 if not possible)
-	std::vector<int> matching_cards;		// list of indices of cards on the table that can be matched
-
-	// randomize seed
-	std::srand(std::time(NULL));
-
-	if (table.isEmpty()) {				// if no cards in the table, then CPU can hardly match anything on it
-		table_choice = -1;
-		return table_choice;
-	}
-
-	// first, try to match a card from the table
-	if (!findMatches(matcher, table, matching_cards)) {		// if no matchable cards on table
-	//	printf("The CPU's card from the deck cannot match any card on the table.\tContinuing to next phase.\t");
-		table_choice = -1;
-	} else {	// if there are matchable cards on the table, their indices are now in matching_cards
-		table_choice = matching_cards[std::rand() % matching_cards.size()];		// and grab a table card index stored in a random element of matching_cards
-	}
-
-	// table_choice: -1 if no can do, otherwise index of table card to match (return value)
-	return table_choice;
-}
-
-// randomly choose a card from the hand to give up to the table
-int computerChooseHandCard4Table(const Hand &hand) {
-	std::srand(std::time(NULL));
-	return rand() % hand.cardCount();		// return the index of a random card in the hand
-}
-
-// randomly choose whether or not to call Koi-Koi, based on current # of points
-// the higher the computer's score, the more likely it will be to call Koi-Koi
-bool computerCallKoiKoi(int cfd, const int rawscore) {
-	string write_buf = "";
-	write_buf.clear();
-
-	std::srand(std::time(NULL));
-	int chance = rand() % 100;				// generate a random number 0-99
-	bool call_it = false;
-
-	if (rawscore < 3 ) {
-		call_it = chance < 25;	// 25% chance of calling Koi-Koi
-	} else if (rawscore < 7) {
-		call_it = chance < 50;	// 50% chance of calling Koi-Koi
-	} else if (rawscore < 11) {
-		call_it = chance < 75;	// 75% chance of calling Koi-Koi
-	} else {	// if rawscore >= 11
-		call_it = chance < 90;	// 90% chance of calling Koi-Koi
-	}
-
-	write_buf  = string("The CPU has collected a combo in its score pile, and it can end this round or call Koi-Koi.\t");
-	write_buf += string("The CPU's choice is: ");
-	if (call_it) {
-		write_buf += string("Koi-Koi!\t");
-	} else {
-		write_buf += string("End the round.\t");
-	}
-	write_buf += string("\t");
-
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
-
-	return call_it;
-}
-
 /* =====================================
 WRAPPER FUNCTIONS FOR PLAYER & COMPUTER TURNS
 ===================================== */
 
 // runs all the functions for the player's turn
-void doPlayerTurn(int cfd, Hand &hand, DeckType &deck, Hand &table, ScorePile &pile, bool &called_KK, bool &end_round, const bool cpu_KK, const int cpu_score) {
-	string write_buf = "";
-	write_buf.clear();
+TurnRecord doPlayerTurn(int cfd, Hand &hand, DeckType &deck, Hand &table, ScorePile &pile, bool &called_KK, bool &end_round, const bool cpu_KK, const int cpu_score, int seat) {
+	TRACE_SCOPE("doPlayerTurn");
+	TurnRecord turn;
 
 	int score_before = pile.rawScore();		// starting score in the score pile
 	int score_after  = score_before;
@@ -690,113 +1306,90 @@ void doPlayerTurn(int cfd, Hand &hand, DeckType &deck, Hand &table, ScorePile &p
 	// PHASE 1: if no matches, then choose a card to put on the table
 	if (noCardsToPlay(hand, table)) {
 		hand_index = promptGiveUpCard(cfd, hand);
-		table.addCard(hand.playCard(hand_index));
+		turn.handCard = hand.playCard(hand_index);
+		table.addCard(turn.handCard);
+		logEvent(LOG_TOTABLE, seat, turn.handCard.cardId());
 	}
 	// PHASE 1: if there is a possible match choose a hand card & table card, then put both in the score pile
 	else {
 		hand_index = promptHandCardToPlay(cfd, hand, table);
 		table_index = promptTableCardToMatch(cfd, hand.getCard(hand_index), table);
-		write_buf  = string("Your reveal this card from your hand:   ") + hand.getCard(hand_index).cardName()   + string("\t");
-		write_buf += string("You match it to this card on the table: ") + table.getCard(table_index).cardName() + string("\t");
-		write_buf += string("Both cards are put in your score pile.\t\t");
-		Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
 
-		pile.addCard(hand.playCard(hand_index));			// take matched card from hand and put it in score pile
-		pile.addCard(table.playCard(table_index));			// take matched card from table and put it in score pile
+		turn.matchedHand = true;
+		turn.handCard    = hand.playCard(hand_index);		// take matched card from hand and put it in score pile
+		turn.handTarget  = table.playCard(table_index);		// take matched card from table and put it in score pile
+		pile.addCard(turn.handCard);
+		pile.addCard(turn.handTarget);
+		logEvent(LOG_MATCH, seat, turn.handCard.cardId(), turn.handTarget.cardId());
 	}
+	printPlay(cfd, turn, true);
 	
-	write_buf.clear();
 	// PHASE 2: draw a card from the deck
 	CardType deck_card = deck.drawCard();
-	write_buf = string("You reveal this card from the deck:      ") + deck_card.cardName() + string("\t");
+	turn.deckCard = deck_card;
 	// PHASE 2: if no matches, then put the deck card onto the table
 	if (!hasMatches(deck_card, table)) {
-		write_buf += string("You cannot match this card with any card on the table, so it is added to the table.\t\t");
 		table.addCard(deck_card);
+		logEvent(LOG_TOTABLE, seat, deck_card.cardId());
 	}
 	// PHASE 2: if it matches something on the table, choose a table card, then put both in the score pile
 	else {
 		table_index = promptTableCardToMatch(cfd, deck_card, table);
-		write_buf += string("You match this card with the table card: ") + table.getCard(table_index).cardName() + string("\t");
-		write_buf += string("Both cards are put in your score pile.\t\t");
+		turn.matchedDeck = true;
+		turn.deckTarget  = table.playCard(table_index);
 		pile.addCard(deck_card);
-		pile.addCard(table.playCard(table_index));
+		pile.addCard(turn.deckTarget);
+		logEvent(LOG_MATCH, seat, deck_card.cardId(), turn.deckTarget.cardId());
 	}
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
+	printDraw(cfd, turn, true);
 
 	// PHASE 3: check score pile for koi-koi
 	score_after = pile.rawScore();										// get the current score points
+	turn.rawScore = score_after;
 	if (score_before != score_after) {									// if score points have changed
+		turn.scored = true;
 		end_round = !promptKoiKoi(cfd, pile, cpu_score, cpu_KK);				// determine if player wants to call Koi-Koi or not; if he doesn't, the round ends
+		turn.calledKK = !end_round;
+		if (!end_round) {
+			countMetric(sessionMetrics().koikoiPlayer);
+			logEvent(LOG_KOIKOI, seat, score_after);
+		}
 		called_KK = called_KK || !end_round;							// if player hasn't called Koi-Koi before, then update it to be so, if the player did so
 	} else {
 		end_round = false;												// if no update to score pile, then no koi-koi vs. end game decision
 	}
 
-	write_buf.clear();
+	turn.endRound = end_round;
 
-	return;
+	return turn;
 }
 
-// automates all the functions for the computer's turn
-void doComputerTurn(int cfd, Hand &hand, DeckType &deck, Hand &table, ScorePile &pile, bool &called_KK, bool &end_round) {
-	string write_buf = "";
-	write_buf.clear();
+// automates all the functions for the computer's turn (the moves are made by playTurn() in "koikoi-engine.hpp"), then describes them to the player
+TurnRecord doComputerTurn(int cfd, CPUStrategy &cpu, Hand &hand, DeckType &deck, Hand &table, ScorePile &pile, bool &called_KK, bool &end_round, const ScorePile &opp_pile, const bool opp_KK) {
+	TRACE_SCOPE("doComputerTurn");
 
-	int score_before = pile.rawScore();		// starting score in the score pile
-	int score_after  = score_before;
-	int hand_index  = -1;
-	int table_index = -1;
-
-	// PHASE 1: check cards in the hand to match to the table
-	table_index = computerChooseHandCardToPlay(hand, table, hand_index);
-	// PHASE 1: if no matches, then choose a card to put on the table
-	if (table_index == -1) {
-		hand_index = computerChooseHandCard4Table(hand);	// select card from hand to add to the table
-		write_buf  = string("Computer cannot match any card from its hand with any card on the table,\t");
-		write_buf += string("so instead it sacrifices this card to the table: ") + hand.getCard(hand_index).cardName() + string("\t\t");
-		table.addCard(hand.playCard(hand_index));			// take card from hand and give it to the table
+	unsigned long long start = metricsNow();
+	TurnRecord turn = playTurn(cpu, hand, deck, table, pile, called_KK, end_round, opp_pile, opp_KK);
+	sessionMetrics().cpuTurn.record(metricsNow() - start);
+	if (turn.calledKK) {
+		countMetric(sessionMetrics().koikoiCPU);
 	}
-	// PHASE 1: if it matches something on the table, choose a hand card & table card, then put both in the score pile
-	else {
-		write_buf  = string("Computer reveals this card from its hand: ") + hand.getCard(hand_index).cardName()   + string("\t");
-		write_buf += string("It matches it to this card on the table:  ") + table.getCard(table_index).cardName() + string("\t");
-		write_buf += string("Both cards are put in the CPU's score pile.\t\t");
-		pile.addCard(hand.playCard(hand_index));			// take matched card from hand and put it in score pile
-		pile.addCard(table.playCard(table_index));			// take matched card from table and put it in score pile
+	if (turn.matchedHand) {
+		logEvent(LOG_MATCH, 1, turn.handCard.cardId(), turn.handTarget.cardId());
+	} else {
+		logEvent(LOG_TOTABLE, 1, turn.handCard.cardId());
 	}
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
-
-	// PHASE 2: draw a card from the deck
-	write_buf.clear();
-	CardType deck_card = deck.drawCard();
-	write_buf = string("Computer reveals this card from the deck: ") + deck_card.cardName() + string("\t");
-
-	// PHASE 2: if no matches, then put the deck card onto the table
-	table_index = computerChooseTableCardToMatch(deck_card, table);
-	if (table_index == -1) {
-		write_buf += string("Computer cannot match this card with any card on the table, so it is added to the table.\t\t");
-		table.addCard(deck_card);
+	if (turn.matchedDeck) {
+		logEvent(LOG_MATCH, 1, turn.deckCard.cardId(), turn.deckTarget.cardId());
+	} else {
+		logEvent(LOG_TOTABLE, 1, turn.deckCard.cardId());
 	}
-	// PHASE 2: if it matches something on the table, choose a table card, then put both in the score pile
-	else {
-		write_buf += string("Computer matches this card with the table card: ") + table.getCard(table_index).cardName() + string("\t");
-		write_buf += string("Both cards are put in the CPU's score pile.\t\t");
-		pile.addCard(deck_card);
-		pile.addCard(table.playCard(table_index));
+	if (turn.calledKK) {
+		logEvent(LOG_KOIKOI, 1, turn.rawScore);
 	}
 
-	Rio_writen(cfd, strdup(write_buf.c_str()), write_buf.length());
-	write_buf.clear();
+	// PHASES 1, 2 & 3: the cards it played & drew, and whether it called koi-koi
+	printOpponentTurn(cfd, turn);
 
-	// PHASE 3: check score pile for koi-koi
-	score_after = pile.rawScore();									// get the current score points
-	if (score_before != score_after) {								// if score points have changed
-		end_round = !computerCallKoiKoi(cfd, score_after);				// determine if computer wants to call Koi-Koi or not; if it doesn't, the round ends
-		called_KK = called_KK || !end_round;						// if computer hasn't called Koi-Koi before, then update it to be so, if the CPU kept the round going
-	} else {
-		end_round = false;											// if no update to score pile, then no koi-koi vs. end game decision
-	}
-
-	return;
+	return turn;
 }
\ No newline at end of file
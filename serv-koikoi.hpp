@@ -5,6 +5,15 @@
 #include <string>
 #include "hanafuda-hands.hpp"
 #include "hanafuda-deck.hpp"
+#include "koikoi-rules.hpp"
+#include "koikoi-strategy.hpp"
+#include "koikoi-engine.hpp"
+#include "koikoi-wire.hpp"
+#include "serv-metrics.hpp"
+#include "serv-log.hpp"
+#include "serv-leaderboard.hpp"
+#include "serv-checkpoint.hpp"
+#include "trace.hpp"
 extern "C" {
 #include "csapp.h"
 }
@@ -17,19 +26,37 @@ ScorePile		derived from Hand class, models a score pile with scoring functionali
 */
 
 /* =====================================
-MATCHING FUNCTIONS
+SENDING & RECEIVING
+Every write to and read from the client goes through these, so that they can be counted & timed (see "serv-metrics.hpp").
+If the connection is lost, they throw ClientGone (with the connection's fd, since a game in the arena is played with two
+clients from one thread), which unwinds the session back to serviceKoiKoi().
+A client speaks text until it asks for the binary protocol (see "koikoi-wire.hpp") when it gives its name; from then on,
+every print & prompt function below sends it frames instead of text, and sendToClient() drops any text. A JSON client
+(see "serv-json.hpp") is handled exactly like a binary one: sendFrame() and receiveAnswer() just speak JSON lines to it.
 ===================================== */
-bool theseCardsMatch(const CardType &matcher, const CardType &tablecard);												// returns true if the two cards match (= have the same month)
-bool findMatches(const CardType &matcher, const Hand &table, std::vector<int> &validTableCards);						// find if there are any matches on the table for the matcher card
-bool noCardsToPlay(const Hand &hand, const Hand &table);                                                                // find if a hand has any cards that can match a table card
-bool hasMatches(const CardType &matcher, const Hand &table);                                                            // find if a card will have any matches from findMatches()
+struct ClientGone {
+	int cfd;
+};
+enum ClientProtocol {
+	PROTOCOL_TEXT,
+	PROTOCOL_BINARY,
+	PROTOCOL_JSON
+};
+#define CLIENTFDS	65536		// connections with an fd at least this high can't be served
 
-/* =====================================
-MOVING CARDS BETWEEN HANDS & TABLE & SCORE PILE
-===================================== */
-void dealCards(DeckType &deck, Hand &hand, int n);                       												// deal n cards from the deck to the given hand
-void setup(DeckType &deck, Hand &dealer, Hand &nondealer, Hand &table, ScorePile &playerPile, ScorePile &cpuPile);		// deal 8 cards to non-dealer, then 8 to table, then 8 to dealer
-void cleanup(DeckType &deck, Hand &dealer, Hand &nondealer, Hand &table, ScorePile &playerPile, ScorePile &cpuPile);	// resets & shuffles the deck, clears everyone's hands and
+bool openClient(int cfd);																										// starts keeping the state of the client on the connection (false if it can't be served)
+void closeClient(int cfd);																										// forgets the client (before its connection is closed)
+ClientProtocol clientProtocol(int cfd);																							// the protocol the client speaks
+void sendToClient(int cfd, const std::string &text);																			// writes the text to the client
+void sendToClient(int cfd, const char *text);
+void sendFrame(int cfd, const WireFrame &frame);																				// writes a frame to a binary client (as a line of JSON, to a JSON client)
+void receiveFromClient(int cfd, char *read_buf, int maxlen);																	// reads one line (at most maxlen-1 characters; the rest of a longer line is dropped) from the client
+int  receiveAnswer(int cfd, unsigned char *payload);																			// reads one frame (at most 255 bytes of payload) from a binary client (or a reply line from a JSON one), returning the # of payload bytes (-1 if it wasn't an answer)
+void muteClient(int cfd, bool mute);																							// while muted, everything sent to the client is dropped, e.g. while a resumed game catches up
+struct Broadcast;
+void featureClient(int cfd, Broadcast *broadcast);																				// from now on, the events of the client's game are cast to the broadcast's spectators (NULL: no longer)
+
+#define LEADERTOP	10			// # of players printLeaderboard() lists
 
 /* =====================================
 PRINTING CURRENT GAME STATE
@@ -41,34 +68,52 @@ void printGetPoints(int cfd, const int score_to_add, const bool is_player);
 void printNoPoints(int cfd);																									// prints a message for when no points are scored this round
 void printStandings(int cfd, const int playerScore, const int cpuScore);                                                         // prints out a message for the score at the end of a round
 void printFinalResults(int cfd, const int playerscore, const int cpuscore, const int totalrounds);								// prints out a message declaring the final winner
+void printLeaderboard(int cfd, const std::string &name);																		// prints out the top of the leaderboard (and the named player's place, if lower)
+void printInstantWin(int cfd, int seat, bool fourOfAKind);																		// prints out that a seat (0 = player, 1 = CPU, 2 = the table) was dealt an instant win
+void printPlay(int cfd, const TurnRecord &turn, bool is_player);																// prints out the card played from the hand this turn, and what it took
+void printDraw(int cfd, const TurnRecord &turn, bool is_player);																// prints out the card drawn from the deck this turn, and what it took
+void printToken(int cfd, unsigned long long token);																				// prints out the token the game can be resumed with
+void printResumed(int cfd, bool resumed);																						// prints out that the game was resumed (or that there was none with that token)
+void printOpponent(int cfd, int opponent, const std::string &name);																// prints out who the player is up against (a StrategyKind, or OPPONENT_ARENA and the other client's name)
+void printAbandoned(int cfd);																									// prints out that the opponent's connection was lost, and the game is over
+void printOpponentTurn(int cfd, const TurnRecord &turn);																		// prints out what the opponent (the CPU, or another client) did on its turn
 
 // printing lists of cards
-void printMatchOptions(int cfd, const Hand &table, const std::vector<int> &validTableCards);										// prints out the list of matchable table cards
-void printHandState(int cfd, const Hand &hand);																					// prints out all the cards in the hand
+void printMatchOptions(int cfd, const Hand &table, CardMask validTableCards);													// prints out the matchable table cards (a set of their indexes)
+void printHandState(int cfd, const Hand &hand, bool is_player);																					// prints out all the cards in the hand
 void printTableState(int cfd, const Hand &table);																				// prints out all the cards on the table
 void printScoreState(int cfd, const ScorePile &scorepile, bool opponentKK, bool is_player);										// prints out all the cards in the score pile
 void printScoreValue(int cfd, const ScorePile &scorepile, bool opponentKK, bool is_player);										// prints out how much the cards in the score pile are worth
+void printComputerKoiKoi(int cfd, bool called_KK);																				// prints out whether the CPU called Koi-Koi or ended the round
 
 /* =====================================
 INTERACTING WITH THE USER
 ===================================== */
+#define OPPONENT_ARENA	NUMSTRATEGIES		// what promptOpponent() returns for a game against another client (see "serv-match.hpp")
+
+// what the player can do once a game is over (as numbered for WIREPROMPT_AFTER)
+enum AfterGame {
+	AFTER_LEADERBOARD	= 1,
+	AFTER_QUIT			= 2,
+	AFTER_AGAIN			= 3			// play another game, with the same name, # of rounds & opponent
+};
+
+std::string  promptPlayerName(int cfd, unsigned long long &resume_token, int &watch_game);										// prompts the user for a name to be ranked under on the leaderboard (or a game to resume, or to watch)
+int  promptRounds(int cfd);																										// prompts the user for the # of rounds to play
+int  promptOpponent(int cfd);																									// prompts the user to choose which CPU strategy to play against (a StrategyKind), or OPPONENT_ARENA
 bool promptKoiKoi(int cfd, const ScorePile &playerPile, const int cpuScore, bool cpuCalledKK);		                            // prompts the user to call Koi-Koi or not (returns true if they call KK)
 int  promptHandCardToPlay(int cfd, const Hand &hand, const Hand &table);															// prompts the user to choose a card in their hand to play
 int  promptTableCardToMatch(int cfd, const CardType matcher, const Hand &table);													// prompts the user to match a deck card to a table card
-
-/* =====================================
-SIMULATING THE COMPUTER PLAYER
-===================================== */
-int computerChooseHandCardToPlay(const Hand &hand, const Hand &table, int &hand_choice);							    // has the computer match a hand card to a table card
-int computerChooseTableCardToMatch(const CardType matcher, const Hand &table);										    // has the computer match a deck card to a table card
-int computerChooseHandCard4Table(const Hand &hand);                                                                     // has the computer choose a card to give up to the table
-bool computerCallKoiKoi(int cfd, const int rawscore);                                                                            // has the computer choose whether to call Koi-Koi or not
+AfterGame promptAfterGame(int cfd);																							// prompts the user, after the game, to see the leaderboard, quit or play again
 
 /* =====================================
 WRAPPERS FOR BOTH PLAYERS' TURNS
 ===================================== */
-void doPlayerTurn  (int cfd, Hand &hand, DeckType &deck, Hand &table, ScorePile &pile, bool &called_KK, bool &end_round,         // wrapper for all stuff the player does on his turn
-                        const bool cpu_KK, const int cpu_score);    // extra things needed for promptKoiKoi()
-void doComputerTurn(int cfd, Hand &hand, DeckType &deck, Hand &table, ScorePile &pile, bool &called_KK, bool &end_round);	    // wrapper for all stuff the cpu does on its turn
+// (both return a record of what was played, like playTurn() in "koikoi-engine.hpp")
+TurnRecord doPlayerTurn  (int cfd, Hand &hand, DeckType &deck, Hand &table, ScorePile &pile, bool &called_KK, bool &end_round,         // wrapper for all stuff the player does on his turn
+                        const bool cpu_KK, const int cpu_score,    // extra things needed for promptKoiKoi()
+                        int seat = 0);                             // the player's seat, for the log
+TurnRecord doComputerTurn(int cfd, CPUStrategy &cpu, Hand &hand, DeckType &deck, Hand &table, ScorePile &pile, bool &called_KK, bool &end_round,	// wrapper for all stuff the cpu does on its turn
+                        const ScorePile &opp_pile, const bool opp_KK);	// extra things the strategy may look at
 
 #endif
\ No newline at end of file
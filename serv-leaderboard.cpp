@@ -0,0 +1,371 @@
+#include "serv-leaderboard.hpp"
+#include "serv-log.hpp"
+extern "C" {
+#include "csapp.h"
+}
+#include <unordered_map>
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+/* =====================================
+THE TOTALS
+===================================== */
+
+struct PlayerTotals {
+	long	games;
+	long	wins;
+	long	rounds;
+	long	points;
+};
+
+// whether player a ranks above player b: more wins, then more points per round, then by name
+static bool ranksAbove(const std::string &aName, const PlayerTotals &a, const std::string &bName, const PlayerTotals &b) {
+	if (a.wins != b.wins) {
+		return a.wins > b.wins;
+	}
+	double aAvg = (a.rounds == 0) ? 0.0 : static_cast<double>(a.points) / a.rounds;
+	double bAvg = (b.rounds == 0) ? 0.0 : static_cast<double>(b.points) / b.rounds;
+	if (aAvg != bAvg) {
+		return aAvg > bAvg;
+	}
+	return aName < bName;
+}
+
+// a player's place in their shard's ranking (the name is the key of the player's entry in the shard's map)
+struct RankKey {
+	const std::string	*name;
+	PlayerTotals		totals;
+};
+
+struct RankOrder {
+	bool operator()(const RankKey &a, const RankKey &b) const { return ranksAbove(*a.name, a.totals, *b.name, b.totals); }
+};
+
+// the shard's players, best first, which can also tell how many of them rank above any given totals
+typedef __gnu_pbds::tree<RankKey, __gnu_pbds::null_type, RankOrder, __gnu_pbds::rb_tree_tag,
+                         __gnu_pbds::tree_order_statistics_node_update> RankIndex;
+
+struct alignas(64) LeaderShard {		// (one per cache line, so that locking one shard doesn't slow down its neighbours)
+	pthread_mutex_t									lock;
+	std::unordered_map<std::string, PlayerTotals>	players;
+	RankIndex										ranked;			// (the same players, kept in order as their totals change)
+
+	LeaderShard() { pthread_mutex_init(&lock, NULL); }
+};
+
+static LeaderShard shards[LEADERSHARDS];
+static std::atomic<long> playerCount(0);
+
+static LeaderShard &shardOf(const std::string &name) {
+	return shards[std::hash<std::string>()(name) % LEADERSHARDS];
+}
+
+static void addTotals(const std::string &name, long games, long wins, long rounds, long points) {
+	LeaderShard &shard = shardOf(name);
+	pthread_mutex_lock(&shard.lock);
+	std::unordered_map<std::string, PlayerTotals>::iterator found = shard.players.find(name);
+	if (found == shard.players.end()) {
+		found = shard.players.emplace(name, PlayerTotals()).first;		// (a new player starts at all zeroes)
+	} else {
+		shard.ranked.erase(RankKey{&found->first, found->second});
+	}
+	PlayerTotals &totals = found->second;
+	if (totals.games == 0 && games > 0) {
+		playerCount.fetch_add(1, std::memory_order_relaxed);
+	}
+	totals.games  += games;
+	totals.wins   += wins;
+	totals.rounds += rounds;
+	totals.points += points;
+	shard.ranked.insert(RankKey{&found->first, totals});
+	pthread_mutex_unlock(&shard.lock);
+	return;
+}
+
+/* =====================================
+ON DISK
+The snapshot (path) and each journal (path + ".journal." + its #) are a header followed by fixed-size entries.
+A snapshot holds one entry per player, and its header gives the # of the last journal it covers.
+A journal holds one entry per game, and its header gives its own #.
+===================================== */
+
+#define LEADERMAGIC		"KOIKOILB"
+#define LEADERVERSION	1
+
+struct LeaderFileHeader {
+	char			magic[8];
+	unsigned int	version;
+	unsigned int	journal;
+};
+
+struct LeaderEntry {
+	char				name[LEADERNAME];
+	unsigned int		games;
+	unsigned int		wins;
+	unsigned int		rounds;
+	unsigned int		unused;
+	unsigned long long	points;
+};
+
+static std::string boardPath;
+static int journalfd = -1;								// the current journal (-1 if the leaderboard isn't kept on disk)
+static unsigned int journalNum = 0;						// ...and its #
+static std::atomic<long> journaled(0);					// # of games in the current journal
+static pthread_rwlock_t journalLock = PTHREAD_RWLOCK_INITIALIZER;		// submissions share it; starting a new journal takes it alone
+
+static std::string journalPath(unsigned int num) {
+	return boardPath + ".journal." + std::to_string(num);
+}
+
+static LeaderEntry makeEntry(const std::string &name, long games, long wins, long rounds, long points) {
+	LeaderEntry entry;
+	memset(&entry, 0, sizeof(entry));
+	strncpy(entry.name, name.c_str(), LEADERNAME - 1);
+	entry.games  = games;
+	entry.wins   = wins;
+	entry.rounds = rounds;
+	entry.points = points;
+	return entry;
+}
+
+// adds every entry of a leaderboard file to the totals
+// RETURN: false if there is no such file, or it is not a leaderboard file; otherwise, the header's journal # & # of whole entries read
+static bool loadFile(const std::string &path, unsigned int &journal, long &entries) {
+	LeaderFileHeader header;
+	LeaderEntry batch[256];
+	ssize_t n;
+
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	if (rio_readn(fd, &header, sizeof(header)) != sizeof(header) || memcmp(header.magic, LEADERMAGIC, 8) != 0 || header.version != LEADERVERSION) {
+		close(fd);
+		return false;
+	}
+	journal = header.journal;
+	entries = 0;
+	while ((n = rio_readn(fd, batch, sizeof(batch))) > 0) {
+		for (size_t i = 0; i < n / sizeof(LeaderEntry); i++) {		// (a torn last entry is left out)
+			batch[i].name[LEADERNAME - 1] = '\0';
+			addTotals(batch[i].name, batch[i].games, batch[i].wins, batch[i].rounds, batch[i].points);
+		}
+		entries += n / sizeof(LeaderEntry);
+	}
+	close(fd);
+	return true;
+}
+
+// writes a header-only file, returning it open for appending (or -1 if it can't be made)
+static int createFile(const std::string &path, unsigned int journal, int extraFlags) {
+	LeaderFileHeader header;
+	memcpy(header.magic, LEADERMAGIC, 8);
+	header.version = LEADERVERSION;
+	header.journal = journal;
+
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | extraFlags, 0644);
+	if (fd >= 0 && rio_writen(fd, &header, sizeof(header)) != sizeof(header)) {
+		close(fd);
+		fd = -1;
+	}
+	return fd;
+}
+
+// starts a new journal, then writes a snapshot that covers every journal before it, and deletes those
+static void compact() {
+	std::vector<LeaderEntry> entries;
+
+	// games from here on go to the new journal, and the totals (as of the old one) are copied before any of those arrive
+	pthread_rwlock_wrlock(&journalLock);
+	int fd = createFile(journalPath(journalNum + 1), journalNum + 1, O_APPEND);
+	if (fd < 0) {
+		pthread_rwlock_unlock(&journalLock);
+		logText(LOG_SERVER, "Could not start a new leaderboard journal");
+		return;
+	}
+	close(journalfd);
+	journalfd = fd;
+	unsigned int covered = journalNum++;
+	journaled.store(0);
+	entries.reserve(playerCount.load());
+	for (int s = 0; s < LEADERSHARDS; s++) {
+		pthread_mutex_lock(&shards[s].lock);
+		for (const auto &player : shards[s].players) {
+			entries.push_back(makeEntry(player.first, player.second.games, player.second.wins, player.second.rounds, player.second.points));
+		}
+		pthread_mutex_unlock(&shards[s].lock);
+	}
+	pthread_rwlock_unlock(&journalLock);
+
+	// the new snapshot replaces the old one in one rename, so a reader (or a restart) sees one or the other whole
+	std::string tmpPath = boardPath + ".tmp";
+	fd = createFile(tmpPath, covered, 0);
+	size_t bytes = entries.size() * sizeof(LeaderEntry);
+	if (fd < 0 || rio_writen(fd, entries.data(), bytes) != static_cast<ssize_t>(bytes) || fsync(fd) < 0 || rename(tmpPath.c_str(), boardPath.c_str()) < 0) {
+		if (fd >= 0) {
+			close(fd);
+		}
+		logText(LOG_SERVER, "Could not write the leaderboard snapshot");
+		return;
+	}
+	close(fd);
+	for (unsigned int num = covered; num > 0 && unlink(journalPath(num).c_str()) == 0; num--) {}
+	return;
+}
+
+static void *compactThread(void *vargp) {
+	pthread_detach(pthread_self());
+	while (true) {
+		sleep(LEADERCOMPACT);
+		if (journaled.load() > 0) {
+			compact();
+		}
+	}
+	return NULL;
+}
+
+void openLeaderboard(const char *path) {
+	unsigned int covered = 0, num, journal;
+	long entries = 0, lastEntries = -1;
+	pthread_t tid;
+
+	boardPath = path;
+	if (!loadFile(boardPath, covered, entries) && access(path, F_OK) == 0) {
+		app_error((char *) "Leaderboard open error: not a leaderboard file");
+	}
+	for (num = covered + 1; loadFile(journalPath(num), journal, entries); num++) {		// replay every journal the snapshot doesn't cover
+		lastEntries = entries;
+	}
+	if (lastEntries >= 0) {				// carry on with the last journal, cut back to its last whole entry
+		journalNum = num - 1;
+		journalfd  = open(journalPath(journalNum).c_str(), O_WRONLY | O_APPEND);
+		if (journalfd < 0 || ftruncate(journalfd, sizeof(LeaderFileHeader) + lastEntries * sizeof(LeaderEntry)) < 0) {
+			unix_error((char *) "Leaderboard journal open error");
+		}
+		journaled.store(lastEntries);
+	} else {
+		journalNum = covered + 1;
+		journalfd  = createFile(journalPath(journalNum), journalNum, O_APPEND);
+		if (journalfd < 0) {
+			unix_error((char *) "Leaderboard journal open error");
+		}
+	}
+	Pthread_create(&tid, NULL, compactThread, NULL);
+	return;
+}
+
+/* =====================================
+SUBMITTING & QUERYING
+===================================== */
+
+std::string leaderName(const char *text) {
+	std::string name;
+	while (*text == ' ' || *text == '\t') {
+		text++;
+	}
+	for (; *text != '\0' && *text != '\n' && *text != '\r' && name.length() < LEADERNAME - 1; text++) {
+		name += (*text >= ' ' && *text <= '~') ? *text : '_';		// (a tab or newline would break up the server's messages)
+	}
+	while (!name.empty() && name[name.length()-1] == ' ') {
+		name.erase(name.length() - 1);
+	}
+	return name;
+}
+
+void submitGame(const std::string &name, int points, int rounds, bool won) {
+	if (name.empty()) {
+		return;
+	}
+	LeaderEntry entry = makeEntry(name, 1, won ? 1 : 0, rounds, points);
+	pthread_rwlock_rdlock(&journalLock);
+	if (journalfd >= 0) {				// (an append this small is written all at once, so threads don't need to take turns)
+		if (rio_writen(journalfd, &entry, sizeof(entry)) == sizeof(entry)) {
+			journaled.fetch_add(1);
+		} else {
+			logText(LOG_SERVER, "Could not add a game to the leaderboard journal");
+		}
+	}
+	addTotals(entry.name, 1, entry.wins, rounds, points);
+	pthread_rwlock_unlock(&journalLock);
+	return;
+}
+
+static Standing makeStanding(const std::string &name, const PlayerTotals &totals) {
+	Standing standing;
+	standing.name   = name;
+	standing.games  = totals.games;
+	standing.wins   = totals.wins;
+	standing.rounds = totals.rounds;
+	standing.points = totals.points;
+	return standing;
+}
+
+// merges the best k of each shard (each shard's ranking being kept as games are added, no shard is locked for long)
+std::vector<Standing> topPlayers(int k) {
+	typedef std::pair<std::string, PlayerTotals> Entry;
+	std::vector<Entry> best;
+	auto above = [](const Entry &a, const Entry &b) { return ranksAbove(a.first, a.second, b.first, b.second); };
+
+	for (int s = 0; s < LEADERSHARDS && k > 0; s++) {
+		pthread_mutex_lock(&shards[s].lock);
+		int taken = 0;
+		for (RankIndex::const_iterator player = shards[s].ranked.begin(); player != shards[s].ranked.end() && taken < k; ++player, taken++) {
+			best.push_back(Entry(*player->name, player->totals));
+		}
+		pthread_mutex_unlock(&shards[s].lock);
+	}
+	size_t kept = std::min(best.size(), static_cast<size_t>(std::max(k, 0)));
+	std::partial_sort(best.begin(), best.begin() + kept, best.end(), above);
+
+	std::vector<Standing> standings;
+	for (size_t i = 0; i < kept; i++) {
+		standings.push_back(makeStanding(best[i].first, best[i].second));
+	}
+	return standings;
+}
+
+int playerRank(const std::string &name, Standing &standing) {
+	PlayerTotals totals;
+	int rank = 1;
+
+	LeaderShard &shard = shardOf(name);
+	pthread_mutex_lock(&shard.lock);
+	std::unordered_map<std::string, PlayerTotals>::const_iterator found = shard.players.find(name);
+	bool known = (found != shard.players.end());
+	if (known) {
+		totals = found->second;
+	}
+	pthread_mutex_unlock(&shard.lock);
+	if (!known) {
+		return 0;
+	}
+
+	RankKey key = {&name, totals};
+	for (int s = 0; s < LEADERSHARDS; s++) {		// (each shard counts the players above in its ranking, in log time)
+		pthread_mutex_lock(&shards[s].lock);
+		rank += shards[s].ranked.order_of_key(key);
+		pthread_mutex_unlock(&shards[s].lock);
+	}
+	standing = makeStanding(name, totals);
+	return rank;
+}
+
+bool playerStanding(const std::string &name, Standing &standing) {
+	LeaderShard &shard = shardOf(name);
+	pthread_mutex_lock(&shard.lock);
+	std::unordered_map<std::string, PlayerTotals>::const_iterator found = shard.players.find(name);
+	bool known = (found != shard.players.end());
+	if (known) {
+		standing = makeStanding(name, found->second);
+	}
+	pthread_mutex_unlock(&shard.lock);
+	return known;
+}
+
+long leaderboardPlayers() {
+	return playerCount.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,43 @@
+#ifndef SERV_LEADERBOARD_H
+#define SERV_LEADERBOARD_H
+
+#include <string>
+#include <vector>
+
+/*  ========================================
+LEADERBOARD
+Every finished game adds to its player's totals, by the name the player gave at the start of the session. Players are
+spread over LEADERSHARDS shards by a hash of their name, each with its own lock, so session threads only wait on each
+other when their players share a shard.
+
+On disk (if openLeaderboard() was called) the leaderboard is a snapshot of everyone's totals, plus numbered journals
+of the games played since. Each game is one fixed-size entry appended to the current journal. Every LEADERCOMPACT
+seconds a background thread starts a new journal, writes a fresh snapshot covering the ones before it, and deletes
+them; so a restart reads one snapshot and at most a couple of short journals. A crash at any point loses no game that
+reached the journal: the snapshot says which journal it covers, and every later journal is replayed on top of it.
+========================================    */
+
+#define LEADERNAME		24			// longest player name (including the '\0') kept
+#define LEADERSHARDS	64			// # of separately-locked shards the players are spread over
+#define LEADERCOMPACT	60			// seconds between compactions of the journal into the snapshot
+
+// one player's totals, as returned by the queries
+struct Standing {
+	std::string		name;
+	long			games;
+	long			wins;
+	long			rounds;
+	long			points;
+
+	double average() const { return (rounds == 0) ? 0.0 : static_cast<double>(points) / rounds; }		// points per round
+};
+
+void openLeaderboard(const char *path);		// loads the leaderboard kept at path (& its journals), and keeps it there from now on
+std::string leaderName(const char *text);	// the player name to use for the text a client sent ("" if there is none)
+void submitGame(const std::string &name, int points, int rounds, bool won);		// adds a finished game to the player's totals
+std::vector<Standing> topPlayers(int k);	// the k best players, best first (ranked by wins, then points per round)
+int playerRank(const std::string &name, Standing &standing);		// the player's rank (1 = best) & totals, or 0 if the player has no games yet
+bool playerStanding(const std::string &name, Standing &standing);		// the player's totals, or false if the player has no games yet (unlike playerRank(), this only looks at the player's shard)
+long leaderboardPlayers();					// # of players with at least one game
+
+#endif
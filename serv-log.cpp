@@ -0,0 +1,291 @@
+#include "serv-log.hpp"
+#include "hanafuda-card.hpp"
+#include "koikoi-strategy.hpp"
+extern "C" {
+#include "csapp.h"
+}
+#include <atomic>
+#include <string>
+#include <cstdio>
+#include <ctime>
+
+/* =====================================
+THE RING
+A bounded multi-producer, multi-consumer queue: every slot carries a sequence # that says whose turn it is to use it
+(producer when seq == position, consumer when seq == position + 1), so producers & consumers never need a lock.
+===================================== */
+
+struct LogRecord {
+	unsigned long long	time;				// wall-clock time, in nanoseconds since the epoch
+	long				session;
+	LogEvent			event;
+	int					a, b, c;
+	char				text[LOGTEXT];
+};
+
+struct LogSlot {
+	std::atomic<unsigned long>	seq;
+	LogRecord					record;
+};
+
+static LogSlot ring[LOGRECORDS];
+static std::atomic<unsigned long> enqueuePos(0);
+static std::atomic<unsigned long> dequeuePos(0);
+static std::atomic<long> dropped(0);				// # of events dropped because the ring was full
+static std::atomic<bool> started(false);
+static int logfd = STDOUT_FILENO;
+static thread_local long currentSession = 0;
+
+// claims a slot to fill in, or returns NULL if the ring is full
+static LogSlot *claimSlot(unsigned long &pos) {
+	pos = enqueuePos.load(std::memory_order_relaxed);
+	while (true) {
+		LogSlot *slot = &ring[pos % LOGRECORDS];
+		long diff = static_cast<long>(slot->seq.load(std::memory_order_acquire)) - static_cast<long>(pos);
+		if (diff == 0) {
+			if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				return slot;
+			}
+		} else if (diff < 0) {
+			return NULL;
+		} else {
+			pos = enqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+// takes the oldest record out of the ring; returns false if there is none
+static bool takeRecord(LogRecord &record) {
+	unsigned long pos = dequeuePos.load(std::memory_order_relaxed);
+	while (true) {
+		LogSlot *slot = &ring[pos % LOGRECORDS];
+		long diff = static_cast<long>(slot->seq.load(std::memory_order_acquire)) - static_cast<long>(pos + 1);
+		if (diff == 0) {
+			if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				record = slot->record;
+				slot->seq.store(pos + LOGRECORDS, std::memory_order_release);		// hand the slot back to the producers
+				return true;
+			}
+		} else if (diff < 0) {
+			return false;
+		} else {
+			pos = dequeuePos.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+static void putRecord(LogEvent event, int a, int b, int c, const char *text) {
+	struct timespec now;
+	unsigned long pos;
+
+	if (!started.load(std::memory_order_relaxed)) {
+		return;
+	}
+	LogSlot *slot = claimSlot(pos);
+	if (slot == NULL) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	clock_gettime(CLOCK_REALTIME, &now);
+	LogRecord &record = slot->record;
+	record.time    = now.tv_sec * 1000000000ULL + now.tv_nsec;
+	record.session = currentSession;
+	record.event   = event;
+	record.a       = a;
+	record.b       = b;
+	record.c       = c;
+	if (text != NULL) {
+		strncpy(record.text, text, LOGTEXT - 1);
+		record.text[LOGTEXT - 1] = '\0';
+	} else {
+		record.text[0] = '\0';
+	}
+	slot->seq.store(pos + 1, std::memory_order_release);		// now the consumer may take it
+	return;
+}
+
+void logSession(long session) {
+	currentSession = session;
+	return;
+}
+
+long loggedSession() {
+	return currentSession;
+}
+
+void logEvent(LogEvent event, int a, int b, int c) {
+	putRecord(event, a, b, c, NULL);
+	return;
+}
+
+void logText(LogEvent event, const char *text) {
+	putRecord(event, 0, 0, 0, text);
+	return;
+}
+
+/* =====================================
+WRITING THE LOG
+===================================== */
+
+static const char *seatName(int seat) {
+	switch (seat) {
+		case 0:
+			return "player";
+		case 1:
+			return "CPU";
+		default:
+			return "nobody";
+	}
+}
+
+static std::string cardNameOf(int id) {
+	return (id >= 0 && id < NUMCARDS) ? CardType::fromId(id).cardName() : std::string("?");
+}
+
+// appends one record as a line of text
+static void formatRecord(std::string &out, const LogRecord &r) {
+	char line[512];
+	char stamp[32];
+	time_t seconds = r.time / 1000000000ULL;
+	struct tm local;
+	int n;
+
+	localtime_r(&seconds, &local);
+	strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+	n = snprintf(line, sizeof(line), "%s.%03llu ", stamp, (r.time / 1000000ULL) % 1000);
+	if (r.session != 0) {
+		n += snprintf(line + n, sizeof(line) - n, "[session %ld] ", r.session);
+	}
+
+	switch (r.event) {
+		case LOG_SERVER:
+			snprintf(line + n, sizeof(line) - n, "%s", r.text);
+			break;
+		case LOG_CONNECT:
+			snprintf(line + n, sizeof(line) - n, "connected to %s", r.text);
+			break;
+		case LOG_DISCONNECT:
+			snprintf(line + n, sizeof(line) - n, "connection to %s closed", r.text);
+			break;
+		case LOG_GAMESTART:
+			snprintf(line + n, sizeof(line) - n, "game of %d rounds against the %s CPU", r.a, strategyName(static_cast<StrategyKind>(r.b)));
+			break;
+		case LOG_RESUME:
+			snprintf(line + n, sizeof(line) - n, "resuming a game from its checkpoint, %d turns in", r.a);
+			break;
+		case LOG_PARK:
+			snprintf(line + n, sizeof(line) - n, "connection lost: the game waits %d s to be resumed", r.a);
+			break;
+		case LOG_DEAL:
+			snprintf(line + n, sizeof(line) - n, "round %d dealt by %s", r.a, seatName(r.b));
+			break;
+		case LOG_MISDEAL:
+			snprintf(line + n, sizeof(line) - n, "round %d misdealt, dealing again", r.a);
+			break;
+		case LOG_INSTANTWIN:
+			snprintf(line + n, sizeof(line) - n, "round %d: %s was dealt an instant win", r.a, seatName(r.b));
+			break;
+		case LOG_MATCH:
+			snprintf(line + n, sizeof(line) - n, "%s matches %s with %s", seatName(r.a), cardNameOf(r.b).c_str(), cardNameOf(r.c).c_str());
+			break;
+		case LOG_TOTABLE:
+			snprintf(line + n, sizeof(line) - n, "%s adds %s to the table", seatName(r.a), cardNameOf(r.b).c_str());
+			break;
+		case LOG_KOIKOI:
+			snprintf(line + n, sizeof(line) - n, "%s calls Koi-Koi on %d points", seatName(r.a), r.b);
+			break;
+		case LOG_ROUNDEND:
+			snprintf(line + n, sizeof(line) - n, "round %d over: %s scores %d", r.a, seatName(r.b), r.c);
+			break;
+		case LOG_GAMEEND:
+			snprintf(line + n, sizeof(line) - n, "game over: player %d, CPU %d", r.a, r.b);
+			break;
+		case LOG_ARENA:
+			snprintf(line + n, sizeof(line) - n, "game of %d rounds in the arena, against session %d (as the CPU)", r.a, r.b);
+			break;
+		case LOG_ABANDON:
+			snprintf(line + n, sizeof(line) - n, "%s's connection lost: the game is over, unscored", seatName(r.a));
+			break;
+		case LOG_WATCH:
+			snprintf(line + n, sizeof(line) - n, "watched featured game %d: sent %d events, skipped ahead %d times", r.a, r.b, r.c);
+			break;
+		default:
+			snprintf(line + n, sizeof(line) - n, "[unknown event %d]", static_cast<int>(r.event));
+			break;
+	}
+	out += line;
+	out += '\n';
+	return;
+}
+
+static void writeAll(const std::string &text) {
+	size_t done = 0;
+	while (done < text.length()) {
+		ssize_t n = write(logfd, text.c_str() + done, text.length() - done);
+		if (n <= 0) {
+			return;			// nowhere to write the log; there is nothing better to do than to lose it
+		}
+		done += n;
+	}
+	return;
+}
+
+static pthread_mutex_t drainLock = PTHREAD_MUTEX_INITIALIZER;	// the logger thread & drainAtExit() take turns (only they take it)
+
+// takes everything out of the ring, and writes it in one go; returns the # of records written
+static int drainRing() {
+	static std::string batch;
+	LogRecord record;
+	int count = 0;
+
+	pthread_mutex_lock(&drainLock);
+	long lost = dropped.exchange(0, std::memory_order_relaxed);
+	batch.clear();
+	if (lost > 0) {
+		char line[128];
+		snprintf(line, sizeof(line), "(%ld log events dropped: the log could not keep up)\n", lost);
+		batch += line;
+	}
+	while (count < LOGRECORDS && takeRecord(record)) {		// (stop after one ring's worth, so that a batch can't grow forever)
+		formatRecord(batch, record);
+		count++;
+	}
+	writeAll(batch);
+	pthread_mutex_unlock(&drainLock);
+	return count;
+}
+
+static void *loggerThread(void *vargp) {
+	struct timespec nap = {0, 10 * 1000 * 1000};		// 10 ms between looks at an empty ring
+	pthread_detach(pthread_self());
+	while (true) {
+		if (drainRing() == 0) {
+			nanosleep(&nap, NULL);
+		}
+	}
+	return NULL;
+}
+
+// whatever is still in the ring when the process exits gets written too
+static void drainAtExit() {
+	drainRing();
+	return;
+}
+
+void startLogger(const char *path) {
+	pthread_t tid;
+
+	if (path != NULL) {
+		logfd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+		if (logfd < 0) {
+			unix_error((char *) "Log file open error");
+		}
+	}
+	for (unsigned long i = 0; i < LOGRECORDS; i++) {
+		ring[i].seq.store(i, std::memory_order_relaxed);
+	}
+	started.store(true);
+	atexit(drainAtExit);
+	Pthread_create(&tid, NULL, loggerThread, NULL);
+	return;
+}
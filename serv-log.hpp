@@ -0,0 +1,45 @@
+#ifndef SERV_LOG_H
+#define SERV_LOG_H
+
+/*  ========================================
+SERVER LOG
+Session threads never format or write the log themselves. Each event goes into one ring of fixed-size records shared
+by every thread, with no lock: a producer claims a slot with one compare-and-swap, and fills it in. A background thread
+turns the records into lines of text and writes them out in batches. If the ring is ever full, new events are
+dropped (and the # dropped is logged later) rather than making a game wait.
+
+Events are logged with plain numbers (card IDs, seats, scores), so that logging one costs about as much as a clock read.
+Seats are numbered like the engine's: 0 is the player, 1 is the CPU (or, in a game in the arena, the other client),
+and -1 is nobody.
+========================================    */
+
+#define LOGRECORDS	4096		// # of events the ring can hold before new ones are dropped
+#define LOGTEXT		64			// longest text (including the '\0') kept with an event
+
+enum LogEvent {
+	LOG_SERVER,			// text: a message from the server itself
+	LOG_CONNECT,		// text: "(host, port)" of the client
+	LOG_DISCONNECT,		// text: "(host, port)" of the client
+	LOG_GAMESTART,		// a: # of rounds, b: CPU strategy (see StrategyKind)
+	LOG_RESUME,			// a: # of turns replayed to catch the game up
+	LOG_PARK,			// a: # of seconds the game waits to be resumed
+	LOG_DEAL,			// a: round, b: seat that deals
+	LOG_MISDEAL,		// a: round
+	LOG_INSTANTWIN,		// a: round, b: seat that was dealt the instant win
+	LOG_MATCH,			// a: seat, b: ID of the card played (from the hand or the deck), c: ID of the table card it took
+	LOG_TOTABLE,		// a: seat, b: ID of the card added to the table
+	LOG_KOIKOI,			// a: seat, b: raw score it was called on
+	LOG_ROUNDEND,		// a: round, b: seat that scored, c: points scored
+	LOG_GAMEEND,		// a: player's score, b: CPU's score
+	LOG_ARENA,			// a: # of rounds, b: session # of the other client (see "serv-match.hpp")
+	LOG_ABANDON,		// a: seat whose connection was lost, ending a game in the arena
+	LOG_WATCH			// a: # of the featured game watched, b: # of events the spectator was sent, c: # of times it was skipped ahead (see "serv-watch.hpp")
+};
+
+void startLogger(const char *path);									// starts the thread that writes the log, to the file at path (appended to), or to stdout if path is NULL
+void logSession(long session);										// tags the calling thread's events with a session # (0 = none)
+long loggedSession();												// the session # the calling thread's events are tagged with
+void logEvent(LogEvent event, int a = 0, int b = 0, int c = 0);		// logs an event with up to 3 numbers (see LogEvent)
+void logText(LogEvent event, const char *text);						// logs an event with some text (longer text is cut short)
+
+#endif
@@ -0,0 +1,214 @@
+#include "serv-match.hpp"
+#include "serv-koikoi.hpp"
+#include "serv-playgame.hpp"
+#include <deque>
+#include <atomic>
+#include <algorithm>
+#include <cerrno>
+#include <ctime>
+#include <sys/socket.h>
+
+enum WaiterState {
+	WAITER_WAITING,			// in its queue, for anyone to claim
+	WAITER_LOOKING,			// in its queue, but looking for an opponent itself (so not to be claimed for now)
+	WAITER_CLAIMED			// another thread has claimed it, and plays the game with it
+};
+
+// a client waiting for an opponent (on its own thread's stack)
+struct Waiter {
+	int					cfd;
+	std::string			name;
+	long				session;		// (for the log)
+	int					band;
+	unsigned long long	since;			// when it started waiting (ms, on the monotonic clock)
+	int					wait;			// ms it waits at most
+	std::atomic<int>	state;
+	bool				done;			// the game is over (guarded by the waiter's queue's lock, like result)
+	ArenaResult			result;
+	pthread_cond_t		wake;
+
+	// how many bands away from its own it will take an opponent from, by now
+	int reach(unsigned long long now) const { return static_cast<int>((now - since) * MATCHBANDS / wait); }
+};
+
+struct alignas(64) MatchQueue {		// (one per cache line, like the leaderboard's shards)
+	pthread_mutex_t		lock;
+	std::deque<Waiter*>	waiting;		// longest-waiting first
+	std::atomic<int>	count;			// # in waiting, for reading without the lock
+
+	MatchQueue() : count(0) { pthread_mutex_init(&lock, NULL); }
+};
+
+static MatchQueue queues[13][MATCHBANDS];		// by # of rounds, then band
+
+static unsigned long long nowMillis() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000ULL + now.tv_nsec / 1000000;
+}
+
+// the player's rating band, from the share of their games they have won
+static int ratingBand(const std::string &name) {
+	Standing standing;
+	if (name.empty() || !playerStanding(name, standing) || standing.games < MATCHPROVEN) {
+		return MATCHBANDS / 2;
+	}
+	return std::min<long>(standing.wins * MATCHBANDS / standing.games, MATCHBANDS - 1);
+}
+
+// whether the client has hung up (or its connection has failed), without taking anything it sent
+static bool connectionLost(int cfd) {
+	char byte;
+	ssize_t n = recv(cfd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+	return n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+}
+
+// hands a claimed waiter how its game went, and wakes it (its queue's lock must be held)
+static void release(Waiter *waiter, ArenaResult result) {
+	waiter->done   = true;
+	waiter->result = result;
+	pthread_cond_signal(&waiter->wake);
+	return;
+}
+
+// claims the longest-waiting client in the queue that is no further than distance bands from what either it or the
+// claimer will reach to; returns NULL if there is none
+static Waiter *claimFrom(MatchQueue &queue, int distance, int reach, unsigned long long now) {
+	pthread_mutex_lock(&queue.lock);
+	for (Waiter *waiter : queue.waiting) {
+		int expected = WAITER_WAITING;
+		if (distance <= std::max(reach, waiter->reach(now)) && waiter->state.compare_exchange_strong(expected, WAITER_CLAIMED)) {
+			pthread_mutex_unlock(&queue.lock);
+			return waiter;
+		}
+	}
+	pthread_mutex_unlock(&queue.lock);
+	return NULL;
+}
+
+// claims the longest-waiting client that will play a client in the given band, that has waited reach bands' worth,
+// nearest bands first; returns NULL if there is none
+static Waiter *claimOpponent(int rounds, int band, int reach) {
+	unsigned long long now = nowMillis();
+	for (int distance = 0; distance < MATCHBANDS; distance++) {
+		for (int b = band - distance; b <= band + distance; b += std::max(2 * distance, 1)) {
+			if (b < 0 || b >= MATCHBANDS || queues[rounds][b].count.load(std::memory_order_relaxed) == 0) {
+				continue;
+			}
+			MatchQueue &queue = queues[rounds][b];
+			Waiter *waiter;
+			while ((waiter = claimFrom(queue, distance, reach, now)) != NULL) {
+				if (!connectionLost(waiter->cfd)) {		// (checked with the queue's lock let go, the waiter being claimed)
+					return waiter;
+				}
+				pthread_mutex_lock(&queue.lock);		// (it hung up while it waited: it is told so, and ends)
+				release(waiter, ARENA_ABANDONED);
+				pthread_mutex_unlock(&queue.lock);
+			}
+		}
+	}
+	return NULL;
+}
+
+// plays the game between this client (seat 0) and the one it claimed (seat 1), on this thread
+static ArenaResult hostGame(int cfd, const std::string &name, Waiter *other, int rounds) {
+	const int cfds[2] = {cfd, other->cfd};
+	const std::string names[2] = {name, other->name};
+	ArenaResult result = ARENA_PLAYED;
+	bool lost = false;				// whether it was this client's connection that was lost
+	MatchQueue &queue = queues[rounds][other->band];
+
+	logEvent(LOG_ARENA, rounds, other->session);
+	try {
+		playMatch(cfds, names, rounds);
+	} catch (const ClientGone &gone) {
+		lost   = (gone.cfd == cfd);
+		result = ARENA_ABANDONED;
+		logEvent(LOG_ABANDON, lost ? 0 : 1);
+	}
+	pthread_mutex_lock(&queue.lock);
+	release(other, result);			// (other is gone as soon as the lock is let go)
+	pthread_mutex_unlock(&queue.lock);
+	if (lost) {
+		throw ClientGone{cfd};
+	}
+	return result;
+}
+
+// takes the waiter out of its queue (whose lock must be held)
+static void leaveQueue(MatchQueue &queue, Waiter *waiter) {
+	queue.waiting.erase(std::find(queue.waiting.begin(), queue.waiting.end(), waiter));
+	queue.count.fetch_sub(1, std::memory_order_relaxed);
+	return;
+}
+
+ArenaResult playInArena(int cfd, const std::string &name, int rounds, int wait) {
+	int band = ratingBand(name);
+
+	// anyone already waiting in this band, or waiting long enough to take this one?
+	Waiter *other = claimOpponent(rounds, band, 0);
+	if (other != NULL) {
+		return hostGame(cfd, name, other, rounds);
+	}
+
+	// no: wait to be claimed, looking a band further afield every wait / MATCHBANDS ms
+	Waiter self;
+	pthread_condattr_t attr;
+	MatchQueue &queue = queues[rounds][band];
+	self.cfd     = cfd;
+	self.name    = name;
+	self.session = loggedSession();
+	self.band    = band;
+	self.since   = nowMillis();
+	self.wait    = wait;
+	self.state.store(WAITER_WAITING);
+	self.done    = false;
+	self.result  = ARENA_UNPAIRED;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&self.wake, &attr);
+	pthread_condattr_destroy(&attr);
+
+	pthread_mutex_lock(&queue.lock);
+	queue.waiting.push_back(&self);
+	queue.count.fetch_add(1, std::memory_order_relaxed);
+	int reach = 0;
+	while (self.state.load() != WAITER_CLAIMED) {
+		unsigned long long now = nowMillis();
+		if (now - self.since >= static_cast<unsigned long long>(wait)) {
+			int expected = WAITER_WAITING;
+			if (self.state.compare_exchange_strong(expected, WAITER_LOOKING)) {		// (or it has just been claimed after all)
+				break;
+			}
+			continue;
+		}
+		if (self.reach(now) > reach) {			// a band further: look there for someone to claim
+			reach = self.reach(now);
+			int expected = WAITER_WAITING;
+			if (self.state.compare_exchange_strong(expected, WAITER_LOOKING)) {
+				pthread_mutex_unlock(&queue.lock);
+				other = claimOpponent(rounds, band, reach);
+				pthread_mutex_lock(&queue.lock);
+				if (other != NULL) {
+					leaveQueue(queue, &self);
+					pthread_mutex_unlock(&queue.lock);
+					pthread_cond_destroy(&self.wake);
+					return hostGame(cfd, name, other, rounds);
+				}
+				self.state.store(WAITER_WAITING);
+			}
+			continue;
+		}
+		unsigned long long next = std::min(self.since + (reach + 1ULL) * wait / MATCHBANDS + 1, self.since + wait);
+		struct timespec until = {static_cast<time_t>(next / 1000), static_cast<long>(next % 1000) * 1000000L};
+		pthread_cond_timedwait(&self.wake, &queue.lock, &until);
+	}
+	while (self.state.load() == WAITER_CLAIMED && !self.done) {
+		pthread_cond_wait(&self.wake, &queue.lock);
+	}
+	leaveQueue(queue, &self);
+	pthread_mutex_unlock(&queue.lock);
+	pthread_cond_destroy(&self.wake);
+	sessionMetrics().answeredAt = 0;		// (the time spent waiting, or watching the other thread play, isn't this one's work)
+	return self.result;
+}
@@ -0,0 +1,49 @@
+#ifndef SERV_MATCH_H
+#define SERV_MATCH_H
+
+#include <string>
+#include "koikoi-strategy.hpp"
+
+/*  ========================================
+MATCHMAKING
+Clients can play each other, rather than the CPU: every client is offered another player as one more choice of
+opponent (the arena, as bots know it). A client that picks it is paired with another that wants a game of the same
+# of rounds, and that plays about as well. Players are put in one of MATCHBANDS rating bands by the share of their games
+they have won on the leaderboard; those with fewer than MATCHPROVEN games (or unranked) go in the middle one. A client
+is paired at once with whoever has waited longest in its own band, if anyone has. Otherwise it waits; and the longer it
+waits, the further from its own band it will take an opponent, a band at a time, until by the end of its wait it will
+take anyone. A client still unpaired at the end of its wait (ARENAWAIT for a bot, MATCHWAIT for a person, i.e. a text
+client) plays ARENAFALLBACK instead.
+
+The clients waiting are kept in one queue for each # of rounds & band, each with its own lock, so threads only hold
+each other up when they look in the same queue at the same moment; and since each queue's count of waiting clients is
+kept where it can be read without the lock, a queue with nobody in it costs a thread looking for an opponent one read.
+A waiting client is claimed with one compare-and-swap, so that if two threads go for the same client at once, one
+gets it, and neither ever holds more than one lock.
+
+The game is then played by the thread that found the other client, which prompts both clients in turn and shows each
+one the game from its own seat (it is seat 0, the other client seat 1), never the other's hand. The other client's
+thread just waits for the game to be over. So a game between two clients costs the server no more than a game against
+the CPU: one thread at work, reading an answer and writing what it did, with no hand-offs between threads. Along with
+the choice to play again after a game (see AfterGame), a bot can play game after game on one connection.
+
+A game between two clients has no checkpoint: if either client's connection is lost, the game is over for both,
+unscored.
+========================================    */
+
+#define ARENAWAIT		1000			// ms a bot waits for an opponent
+#define MATCHWAIT		60000			// ms a person waits for an opponent
+#define ARENAFALLBACK	CPU_GREEDY		// who a client plays if none comes
+#define MATCHBANDS		10				// # of rating bands (each 10% of games won wide)
+#define MATCHPROVEN		5				// # of games a player needs to be rated
+
+// how a client's turn in matchmaking went
+enum ArenaResult {
+	ARENA_PLAYED,			// it played a game with another client, to the end
+	ARENA_UNPAIRED,			// no other client came: it plays ARENAFALLBACK instead
+	ARENA_ABANDONED			// the other client's connection was lost, and the game with it is over
+};
+
+ArenaResult playInArena(int cfd, const std::string &name, int rounds, int wait);		// pairs the client with another (waiting at most wait ms), and plays their game (throws ClientGone if the client's own connection is lost)
+
+#endif
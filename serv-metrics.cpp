@@ -0,0 +1,223 @@
+#include "serv-metrics.hpp"
+#include "trace.hpp"
+extern "C" {
+#include "csapp.h"
+}
+#include <poll.h>
+#include <string>
+#include <cstdio>
+
+/* =====================================
+REGISTRY OF SESSIONS
+The lock is only taken when a session starts or ends, and when the admin thread reads the totals;
+it is never taken while a game is being played.
+===================================== */
+
+static pthread_mutex_t registryLock = PTHREAD_MUTEX_INITIALIZER;
+static SessionMetrics *liveSessions = NULL;				// every session that is still running
+
+// everything counted by sessions that have already ended
+static struct {
+	LatencyHistogram	processing, cpuTurn, write;
+	long				prompts, bytesIn, bytesOut, rounds, misdeals, koikoiPlayer, koikoiCPU;
+} ended;
+
+static std::atomic<long> activeSessions(0);
+static std::atomic<long> totalSessions(0);
+static unsigned long long startedAt = metricsNow();
+
+static thread_local SessionMetrics *current = NULL;	// the calling thread's session, if it is running one
+static SessionMetrics unattached;						// recorded into by threads that are not running a session (and never read)
+
+SessionMetrics::SessionMetrics() : prompts(0), bytesIn(0), bytesOut(0), rounds(0), misdeals(0), koikoiPlayer(0), koikoiCPU(0), answeredAt(0), next(NULL) {}
+
+void metricsStartSession() {
+	SessionMetrics *metrics = new SessionMetrics;
+	pthread_mutex_lock(&registryLock);
+	metrics->next = liveSessions;
+	liveSessions  = metrics;
+	pthread_mutex_unlock(&registryLock);
+	activeSessions++;
+	totalSessions++;
+	current = metrics;
+	return;
+}
+
+void metricsEndSession() {
+	SessionMetrics *metrics = current;
+	if (metrics == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&registryLock);
+	for (SessionMetrics **link = &liveSessions; *link != NULL; link = &(*link)->next) {		// unlink it from the live list
+		if (*link == metrics) {
+			*link = metrics->next;
+			break;
+		}
+	}
+	metrics->processing.addTo(ended.processing);
+	metrics->cpuTurn.addTo(ended.cpuTurn);
+	metrics->write.addTo(ended.write);
+	ended.prompts      += metrics->prompts;
+	ended.bytesIn      += metrics->bytesIn;
+	ended.bytesOut     += metrics->bytesOut;
+	ended.rounds       += metrics->rounds;
+	ended.misdeals     += metrics->misdeals;
+	ended.koikoiPlayer += metrics->koikoiPlayer;
+	ended.koikoiCPU    += metrics->koikoiCPU;
+	pthread_mutex_unlock(&registryLock);
+	activeSessions--;
+	current = NULL;
+	delete metrics;
+	return;
+}
+
+SessionMetrics &sessionMetrics() {
+	return (current != NULL) ? *current : unattached;
+}
+
+/* =====================================
+ADMIN ENDPOINT
+===================================== */
+
+static void appendLine(std::string &out, const char *name, double value) {
+	char line[256];
+	snprintf(line, sizeof(line), "%s %.9g\n", name, value);
+	out += line;
+	return;
+}
+
+// appends a histogram as a Prometheus summary, in seconds
+static void appendSummary(std::string &out, const char *name, const LatencyHistogram &histogram) {
+	const double QUANTILES[] = {50, 90, 99, 99.9};
+	char label[256];
+	for (int q = 0; q < 4; q++) {
+		snprintf(label, sizeof(label), "%s{quantile=\"%g\"}", name, QUANTILES[q] / 100.0);
+		appendLine(out, label, histogram.percentile(QUANTILES[q]) / 1e9);
+	}
+	snprintf(label, sizeof(label), "%s{quantile=\"1\"}", name);
+	appendLine(out, label, histogram.max() / 1e9);
+	snprintf(label, sizeof(label), "%s_sum", name);
+	appendLine(out, label, histogram.mean() * histogram.count() / 1e9);
+	snprintf(label, sizeof(label), "%s_count", name);
+	appendLine(out, label, histogram.count());
+	return;
+}
+
+// adds up every session, ended or live, and formats the totals
+static std::string metricsReport() {
+	LatencyHistogram processing, cpuTurn, write;
+	long prompts, bytesIn, bytesOut, rounds, misdeals, koikoiPlayer, koikoiCPU;
+
+	pthread_mutex_lock(&registryLock);
+	processing.merge(ended.processing);
+	cpuTurn.merge(ended.cpuTurn);
+	write.merge(ended.write);
+	prompts      = ended.prompts;
+	bytesIn      = ended.bytesIn;
+	bytesOut     = ended.bytesOut;
+	rounds       = ended.rounds;
+	misdeals     = ended.misdeals;
+	koikoiPlayer = ended.koikoiPlayer;
+	koikoiCPU    = ended.koikoiCPU;
+	for (SessionMetrics *s = liveSessions; s != NULL; s = s->next) {
+		s->processing.addTo(processing);
+		s->cpuTurn.addTo(cpuTurn);
+		s->write.addTo(write);
+		prompts      += s->prompts.load(std::memory_order_relaxed);
+		bytesIn      += s->bytesIn.load(std::memory_order_relaxed);
+		bytesOut     += s->bytesOut.load(std::memory_order_relaxed);
+		rounds       += s->rounds.load(std::memory_order_relaxed);
+		misdeals     += s->misdeals.load(std::memory_order_relaxed);
+		koikoiPlayer += s->koikoiPlayer.load(std::memory_order_relaxed);
+		koikoiCPU    += s->koikoiCPU.load(std::memory_order_relaxed);
+	}
+	pthread_mutex_unlock(&registryLock);
+
+	std::string out;
+	appendLine(out, "koikoi_uptime_seconds", (metricsNow() - startedAt) / 1e9);
+	appendLine(out, "koikoi_sessions_active", activeSessions.load());
+	appendLine(out, "koikoi_sessions_total", totalSessions.load());
+	appendLine(out, "koikoi_prompts_total", prompts);
+	appendLine(out, "koikoi_bytes_in_total", bytesIn);
+	appendLine(out, "koikoi_bytes_out_total", bytesOut);
+	appendLine(out, "koikoi_rounds_total", rounds);
+	appendLine(out, "koikoi_misdeals_total", misdeals);
+	appendLine(out, "koikoi_koikoi_calls_total{by=\"player\"}", koikoiPlayer);
+	appendLine(out, "koikoi_koikoi_calls_total{by=\"cpu\"}", koikoiCPU);
+	appendSummary(out, "koikoi_processing_seconds", processing);
+	appendSummary(out, "koikoi_cpu_turn_seconds", cpuTurn);
+	appendSummary(out, "koikoi_write_seconds", write);
+	return out;
+}
+
+// answers one connection to the admin port, then hangs up. The request (one line, which may be an HTTP request line)
+// picks what is sent back: "/trace/start" and "/trace/stop" turn tracing on & off, "/trace" sends the trace so far
+// as Chrome trace JSON (see "trace.hpp"), and anything else, or nothing at all, sends the metrics.
+static void answerAdmin(int connfd) {
+	char request[256] = "";
+	struct pollfd pfd = {connfd, POLLIN, 0};
+	std::string reply;
+	const char *type = "text/plain";
+
+	if (poll(&pfd, 1, 100) > 0) {							// give the client a moment to send a request, but don't wait on it
+		ssize_t n = recv(connfd, request, sizeof(request) - 1, 0);
+		request[n > 0 ? n : 0] = '\0';
+		request[strcspn(request, "\r\n")] = '\0';			// only the first line matters
+	}
+	if (strstr(request, "/trace/start")) {
+		traceStart();
+		reply = "tracing started\n";
+	} else if (strstr(request, "/trace/stop")) {
+		traceStop();
+		reply = "tracing stopped\n";
+	} else if (strstr(request, "/trace")) {
+		reply = traceDump();
+		type  = "application/json";
+	} else {
+		reply = metricsReport();
+	}
+	if (strncmp(request, "GET ", 4) == 0) {					// so that a browser or curl can ask too
+		reply = std::string("HTTP/1.0 200 OK\r\nContent-Type: ") + type + "\r\n\r\n" + reply;
+	}
+	send(connfd, reply.c_str(), reply.length(), MSG_NOSIGNAL);	// a client that hangs up early must not kill the server
+	return;
+}
+
+static void *adminThread(void *vargp) {
+	int listenfd = *static_cast<int*>(vargp);
+	delete static_cast<int*>(vargp);
+	pthread_detach(pthread_self());
+
+	while (true) {
+		int connfd = accept(listenfd, NULL, NULL);
+		if (connfd < 0) {
+			continue;
+		}
+		answerAdmin(connfd);
+		close(connfd);
+	}
+	return NULL;
+}
+
+// listens on localhost only, so that the metrics are never reachable from outside the machine
+void startAdminServer(char *port) {
+	struct sockaddr_in addr;
+	int optval = 1;
+	int *listenfd = new int;
+	pthread_t tid;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family      = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port        = htons(atoi(port));
+
+	*listenfd = Socket(AF_INET, SOCK_STREAM, 0);
+	Setsockopt(*listenfd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+	if (bind(*listenfd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		unix_error((char *) "Admin port bind error");
+	}
+	Listen(*listenfd, LISTENQ);
+	Pthread_create(&tid, NULL, adminThread, listenfd);
+	return;
+}
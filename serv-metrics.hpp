@@ -0,0 +1,50 @@
+#ifndef SERV_METRICS_H
+#define SERV_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include "latency-histogram.hpp"
+
+/*  ========================================
+SERVER METRICS
+Every session thread counts what it does in its own SessionMetrics, with no locks and no shared cache lines:
+each counter is a relaxed atomic that only the session's thread writes. A separate admin thread adds up every
+live session (plus everything from sessions that have already ended) whenever somebody connects to the admin
+port, and sends back the totals as plain text, one "name value" per line (the Prometheus text format).
+========================================    */
+
+// what one session has done so far
+struct SessionMetrics {
+	AtomicLatencyHistogram	processing;		// time the server spends on each answer: from reading it, to waiting for the next one
+	AtomicLatencyHistogram	cpuTurn;		// time the CPU strategy & engine take to play the CPU's turn
+	AtomicLatencyHistogram	write;			// time each write to the client takes
+	std::atomic<long>		prompts;		// # of answers read from the client
+	std::atomic<long>		bytesIn;
+	std::atomic<long>		bytesOut;
+	std::atomic<long>		rounds;			// # of rounds played to the end (including instant wins)
+	std::atomic<long>		misdeals;		// # of deals redone because of the table
+	std::atomic<long>		koikoiPlayer;	// # of times the player called Koi-Koi
+	std::atomic<long>		koikoiCPU;		// # of times the CPU called Koi-Koi
+	unsigned long long		answeredAt;		// when the last answer was read, or 0 before the first (only the session's thread uses this)
+	SessionMetrics			*next;			// next live session (the list is only touched with the registry's lock held)
+
+	SessionMetrics();
+};
+
+// counter += n, for the session's own thread
+inline void countMetric(std::atomic<long> &counter, long n = 1) {
+	counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// a steady clock reading in nanoseconds, for timing things into the histograms
+inline unsigned long long metricsNow() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void metricsStartSession();				// gives the calling thread its own SessionMetrics, and counts it as an active session
+void metricsEndSession();				// folds the calling thread's metrics into the totals, and frees them
+SessionMetrics &sessionMetrics();		// the calling thread's metrics (a throwaway set, on threads that are not running a session)
+
+void startAdminServer(char *port);		// starts a thread that serves the metrics on localhost:port
+
+#endif
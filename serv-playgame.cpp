@@ -1,14 +1,71 @@
 #include "serv-koikoi.hpp"
+#include "serv-match.hpp"
+#include "serv-watch.hpp"
+#include "koikoi-record.hpp"
 #include <iostream>
+#include <random>
 #include <cstdio>
 #include <cstdlib>
 #include <ctime>
+#include <memory>
 extern "C" {
 #include "csapp.h"
 }
 using namespace std;
 
-int serviceKoiKoi (int cfd) {
+static RecordStore gameRecords;
+static bool recording = false;
+
+void openGameRecords(const char *path) {
+	if (!gameRecords.open(path, true)) {
+		unix_error((char *) "Game records open error");
+	}
+	recording = true;
+	return;
+}
+
+// adds a turn to the game's record, and to its checkpoint
+static void keepTurn(GameRecorder &recorder, CheckpointSession *checkpoint, int cfd, const TurnRecord &turn) {
+	unsigned char bytes[3];
+	recorder.addTurn(turn);
+	packTurn(turn, bytes);
+	checkpointTurn(checkpoint, cfd, bytes);
+	return;
+}
+
+// adds a finished round to the game's record (combos: the scoring seat's comboMask())
+static void recordRound(GameRecorder &recorder, int dealer, int &misdeals, int winner, int points, bool instantWin, unsigned int combos) {
+	RoundResult result;
+	result.winner     = winner;
+	result.points     = points;
+	result.instantWin = instantWin;
+	result.misdeals   = misdeals;
+	recorder.addRound(dealer, result, combos);
+	misdeals = 0;
+	return;
+}
+
+// adds a finished game to the game records
+static void recordGame(GameRecorder &recorder, int score0, int score1) {
+	recorder.finish(score0, score1);
+	if (recording && !gameRecords.append(recorder.data(), recorder.length())) {
+		logText(LOG_SERVER, "Could not add a game to the game records");
+	}
+	return;
+}
+
+// what the client chose for its games, kept from one game to the next when it plays again
+struct GameSettings {
+	bool	chosen;				// whether it has chosen yet
+	string	name;				// the name its games go on the leaderboard under ("" = unranked)
+	int		rounds;
+	int		opponent;			// a StrategyKind, or OPPONENT_ARENA
+};
+
+// plays one game with the client (checkpoint: the game's checkpoint, while this thread holds it), asking it for its
+// settings first if it hasn't chosen them yet; returns false if the game could not be played to its end (or the client
+// only watched one: see "serv-watch.hpp")
+static bool playKoiKoi(int cfd, CheckpointSession *&checkpoint, GameSettings &settings) {
 	// current round state
 	int currRound;                      // the current round that is in play (from 1 to TOTALROUNDS)
 	int TOTALROUNDS         = 0;        // total number of rounds that will be played
@@ -19,10 +76,8 @@ int serviceKoiKoi (int cfd) {
 	bool player_ended_round;            // whether the player just ended the current round
 	bool cpu_ended_round;               // whether the cpu just ended the current round
 	int addscore;						// # of points to be added to point total
-	// networking variables
-	rio_t rio;
-	string write_buf = "";
-	char read_buf[MAXLINE] = "\0";
+	int dealer;							// seat that dealt this round (0 = player, 1 = CPU, as in "koikoi-engine.hpp")
+	int misdeals            = 0;        // # of times this round has had to be re-dealt
 
 	// current turn state
 	bool player_turn        = false;    // whether it is the player's turn
@@ -32,31 +87,89 @@ int serviceKoiKoi (int cfd) {
 	Hand playerHand, cpuHand, tableHand;
 	ScorePile playerPile, cpuPile;
 	int playerScore     = 0, cpuScore     = 0;    // current points scored
+	string playerName;                            // the name the player's games go on the leaderboard under ("" = unranked)
+	std::unique_ptr<CPUStrategy> cpu;             // the strategy that plays the CPU's side, chosen by the player
+	// every deal comes from one generator seeded for this game, so that the game's record can replay it
+	std::random_device entropy;
+	unsigned int seed   = entropy();
+	std::mt19937 rng(seed);
+	GameRecorder recorder;
+	unsigned long long token = 0;                 // the game's checkpoint token (the one the player gave, if they asked to resume a game)
+	GameCheckpoint resumed;                       // the game this session carries on with, if the player asked to resume one
+	bool resuming       = false;
+	int watching        = -1;                     // the featured game the client asked to watch instead, if it did (see "serv-watch.hpp")
+	size_t replayed     = 0;                      // bytes of resumed.turns replayed so far
 	//int playerPotential = 0, cpuPotential = 0;    // most recently-calculated points gainable from the score pile
 
-	// solicit for # of rounds
-	write_buf.clear();
-	write_buf += string("How many rounds of koi-koi would you like to play?\t");	// start building string for writing
-	Rio_writen(cfd, const_cast<char*>(write_buf.c_str()), write_buf.length());
-	do {	//infinite loop until the user cooperates
-		// send message to client
-		write_buf.clear();
-		write_buf += string("Enter a number 1-12:\n");								// newline to end this message
-		Rio_writen(cfd, const_cast<char*>(write_buf.c_str()), write_buf.length());				// send the message
-		// read client's response
-		Rio_readinitb(&rio, cfd);											// set up for reading from client
-		Rio_readlineb(&rio, read_buf, 5);									// read from client
-		sscanf(read_buf, "%i", &TOTALROUNDS);								// see if it's an integer
-		// if invalid response, prompt client to insert again
-		if (TOTALROUNDS > 12 || TOTALROUNDS < 1) {
-			write_buf.clear();
-			write_buf += "You must enter a number between 1 and 12, inclusive.\t";
-			Rio_writen(cfd, const_cast<char*>(write_buf.c_str()), write_buf.length());
-		}
-	} while (TOTALROUNDS > 12 || TOTALROUNDS < 1);
-
-	srand(time(NULL));
-	player_is_dealer = static_cast<bool>(rand() % 2);   // randomly choose if player will be dealer or not
+	if (!settings.chosen) {
+		// solicit for the player's name (or a game to resume, or to watch)
+		do {
+			settings.name = promptPlayerName(cfd, token, watching);
+			checkpoint    = (token != 0) ? resumeCheckpoint(token, cfd, resumed) : NULL;
+			resuming      = (checkpoint != NULL) && resumed.strategy < NUMSTRATEGIES && resumed.rounds >= 1 && resumed.rounds <= 12;
+			if (checkpoint != NULL && !resuming) {		// (a game that can't be carried on with is given up)
+				checkpointEnd(checkpoint, cfd);
+				checkpoint = NULL;
+			}
+			if (token != 0 && !resuming) {
+				printResumed(cfd, false);
+			}
+		} while (token != 0 && !resuming);
+
+		if (watching >= 0) {
+			watchGame(cfd, watching);
+			return false;
+		}
+		if (resuming) {		// everything else comes from the checkpoint
+			settings.name     = resumed.name;
+			settings.rounds   = resumed.rounds;
+			settings.opponent = resumed.strategy;
+		} else {
+			// solicit for # of rounds, and which opponent to play against
+			settings.rounds   = promptRounds(cfd);
+			settings.opponent = promptOpponent(cfd);
+		}
+		settings.chosen = true;
+	}
+	TOTALROUNDS = settings.rounds;
+	playerName  = settings.name;
+
+	if (resuming) {		// the game is dealt again from its seed, and its turns replayed
+		seed = resumed.seed;
+		rng.seed(seed);
+		cpu.reset(makeStrategy(static_cast<StrategyKind>(resumed.strategy), entropy()));
+		if (resumed.turns.empty()) {				// (nothing to catch up on: the game starts from its first deal as before)
+			printResumed(cfd, true);
+		}
+		muteClient(cfd, !resumed.turns.empty());			// (until the replay has caught up)
+		logEvent(LOG_RESUME, resumed.turns.size() / 3);
+	} else if (settings.opponent == OPPONENT_ARENA) {
+		sendToClient(cfd, string("Looking for another player to play against...\t\t"));
+		switch (playInArena(cfd, playerName, TOTALROUNDS, (clientProtocol(cfd) == PROTOCOL_TEXT) ? MATCHWAIT : ARENAWAIT)) {
+			case ARENA_PLAYED:
+				return true;
+			case ARENA_ABANDONED:
+				printAbandoned(cfd);
+				return true;
+			case ARENA_UNPAIRED:
+				cpu.reset(makeStrategy(ARENAFALLBACK, entropy()));
+				break;
+		}
+	} else {
+		cpu.reset(makeStrategy(static_cast<StrategyKind>(settings.opponent), entropy()));
+	}
+
+	player_is_dealer = (rng() % 2 == 0);   // randomly choose if player will be dealer or not (the same way as playGame(), which the record relies on)
+	FeaturedGame featured(cfd, playerName, TOTALROUNDS);
+	recorder.begin(seed, RECORDHUMAN, cpu->kind());
+	logEvent(LOG_GAMESTART, TOTALROUNDS, cpu->kind());
+	if (!resuming) {
+		printOpponent(cfd, cpu->kind(), strategyName(cpu->kind()));
+		checkpoint = checkpointStart(cfd, seed, TOTALROUNDS, cpu->kind(), playerName, token);
+		printToken(cfd, token);
+	} else if (resumed.turns.empty()) {			// (otherwise it is shown once the replay has caught up)
+		printOpponent(cfd, cpu->kind(), strategyName(cpu->kind()));
+	}
 
 	for (currRound = 1; currRound <= TOTALROUNDS; currRound++) {
 		// print info for this round
@@ -75,48 +188,39 @@ int serviceKoiKoi (int cfd) {
 
 		// set up for start of round, which includes cleanup(...);
 		if (player_is_dealer) {
-			setup(theDeck, playerHand, cpuHand, tableHand, playerPile, cpuPile);
+			setup(theDeck, playerHand, cpuHand, tableHand, playerPile, cpuPile, rng);
 		} else {    // if cpu is dealer
-			setup(theDeck, cpuHand, playerHand, tableHand, playerPile, cpuPile);
+			setup(theDeck, cpuHand, playerHand, tableHand, playerPile, cpuPile, rng);
 		}
+		dealer = player_is_dealer ? 0 : 1;
+
+		logEvent(LOG_DEAL, currRound, player_is_dealer ? 0 : 1);
 
 		// the dealer goes first
 		player_turn = player_is_dealer;
 
-		write_buf.clear();
 		// check for instant-win combos
-		if (playerHand.instantWin2222()) {
-			write_buf += string("You were dealt four pairs of matching cards--an instant-win combo!\tYou score 6 points, and this round is over.\t");
-			Rio_writen(cfd, const_cast<char*>(write_buf.c_str()), write_buf.length());
-			playerScore += 6;
-			printStandings(cfd, playerScore, cpuScore);
-			continue;
-		} else if (playerHand.instantWin4()) {
-			write_buf += string("You were dealt four of a kind--an instant-win combo!\tYou score 6 points, and this round is over.\t");
-			Rio_writen(cfd, const_cast<char*>(write_buf.c_str()), write_buf.length());
+		if (playerHand.instantWin2222() || playerHand.instantWin4()) {
+			printInstantWin(cfd, 0, !playerHand.instantWin2222());
 			playerScore += 6;
 			printStandings(cfd, playerScore, cpuScore);
+			countMetric(sessionMetrics().rounds);
+			logEvent(LOG_INSTANTWIN, currRound, 0);
+			recordRound(recorder, dealer, misdeals, 0, 6, true, 0);
 			continue;
-		} else if (cpuHand.instantWin2222()) {
-			write_buf += string("The CPU was dealt four pairs of matching cards--an instant-win combo!\tThe CPU scores 6 points, and this round is over.\t");
-			Rio_writen(cfd, const_cast<char*>(write_buf.c_str()), write_buf.length());
+		} else if (cpuHand.instantWin2222() || cpuHand.instantWin4()) {
+			printInstantWin(cfd, 1, !cpuHand.instantWin2222());
 			cpuScore += 6;
 			printStandings(cfd, playerScore, cpuScore);
+			countMetric(sessionMetrics().rounds);
+			logEvent(LOG_INSTANTWIN, currRound, 1);
+			recordRound(recorder, dealer, misdeals, 1, 6, true, 0);
 			continue;
-		} else if (cpuHand.instantWin4()) {
-			write_buf += string("The CPU was dealt four of a kind--an instant-win combo!\tThe CPU scores 6 points, and this round is over.\t");
-			Rio_writen(cfd, const_cast<char*>(write_buf.c_str()), write_buf.length());
-			cpuScore += 6;
-			printStandings(cfd, playerScore, cpuScore);
-			continue;
-		} else if (tableHand.instantWin2222()) {
-			write_buf += string("The Table was dealt four pairs of matching cards--an instant-win combo!\tThis deal is null and void, and the round will be re-dealt.\t");
-			Rio_writen(cfd, const_cast<char*>(write_buf.c_str()), write_buf.length());
-			currRound--;	// repeat this round
-			continue;
-		} else if (tableHand.instantWin4()) {
-			write_buf += string("The Table was dealt four of a kind--an instant-win combo!\tThis deal is null and void, and the round will be re-dealt.\t");
-			Rio_writen(cfd, const_cast<char*>(write_buf.c_str()), write_buf.length());
+		} else if (tableHand.instantWin2222() || tableHand.instantWin4()) {
+			printInstantWin(cfd, 2, !tableHand.instantWin2222());
+			countMetric(sessionMetrics().misdeals);
+			logEvent(LOG_MISDEAL, currRound);
+			misdeals++;
 			currRound--;	// repeat this round
 			continue;
 		}
@@ -126,25 +230,52 @@ int serviceKoiKoi (int cfd) {
 			// printTableState(tableHand);						// print the table cards
 
 			// simulate both players' turns
-			if (player_turn) {	// on player's turn
-				doPlayerTurn(cfd, playerHand, theDeck, tableHand, playerPile, player_KK, player_ended_round, cpu_KK, cpuPile.finalScore(player_KK));
+			if (replayed < resumed.turns.size()) {	// a resumed game catching up: the turn is replayed from the checkpoint, not played
+				TurnRecord turn;
+				bool &called_KK   = player_turn ? player_KK : cpu_KK;
+				bool &ended_round = player_turn ? player_ended_round : cpu_ended_round;
+				bool replayable   = player_turn ? replayTurn(&resumed.turns[replayed], playerHand, theDeck, tableHand, playerPile, turn)
+				                                : replayTurn(&resumed.turns[replayed], cpuHand, theDeck, tableHand, cpuPile, turn);
+				if (!replayable) {
+					muteClient(cfd, false);
+					sendToClient(cfd, string("Sorry, that game could not be resumed.\t"));
+					logText(LOG_SERVER, "A checkpoint could not be replayed");
+					checkpointEnd(checkpoint, cfd);
+					checkpoint = NULL;
+					return false;
+				}
+				replayed   += 3;
+				called_KK   = called_KK || turn.calledKK;
+				ended_round = turn.endRound;
+				round_should_end = ended_round;
+				recorder.addTurn(turn);
+				if (replayed == resumed.turns.size()) {		// caught up: show the player where the game stands
+					muteClient(cfd, false);
+					printResumed(cfd, true);
+					printOpponent(cfd, cpu->kind(), strategyName(cpu->kind()));
+					printRoundHeader(cfd, currRound);
+					printDealer(cfd, player_is_dealer);
+					printStandings(cfd, playerScore, cpuScore);
+					printScoreState(cfd, playerPile, cpu_KK, true);
+					printScoreState(cfd, cpuPile, player_KK, false);
+				}
+			} else if (player_turn) {	// on player's turn
+				keepTurn(recorder, checkpoint, cfd, doPlayerTurn(cfd, playerHand, theDeck, tableHand, playerPile, player_KK, player_ended_round, cpu_KK, cpuPile.finalScore(player_KK)));
 				printScoreState(cfd, playerPile, cpu_KK, true);      // print player's current potential score
 				round_should_end = player_ended_round;
 			} else {			// on computer's turn
-				doComputerTurn(cfd, cpuHand,  theDeck, tableHand, cpuPile,    cpu_KK,    cpu_ended_round);
+				keepTurn(recorder, checkpoint, cfd, doComputerTurn(cfd, *cpu, cpuHand, theDeck, tableHand, cpuPile, cpu_KK, cpu_ended_round, playerPile, player_KK));
 				printScoreState(cfd, cpuPile, player_KK, false);     // print CPU's current potential score
 				round_should_end = cpu_ended_round;
 			}
 
-			// if the deck runs out, there round ends
-			if (theDeck.isEmpty()) {
+			// if the deck runs out, or both players have played every card in their hands, the round ends
+			if (theDeck.isEmpty() || (playerHand.isEmpty() && cpuHand.isEmpty())) {
 				round_should_end = true;
 			}
 			if (!round_should_end) {
 				player_turn = (player_turn == false);	// toggle player_turn true <--> false for next iteration
-				write_buf.clear();
-				write_buf += "-----------------------------\t";
-				Rio_writen(cfd, const_cast<char*>(write_buf.c_str()), write_buf.length());
+				sendToClient(cfd, "-----------------------------\t");
 			}
 		}
 
@@ -170,17 +301,144 @@ int serviceKoiKoi (int cfd) {
 
 		// print standings
 		printStandings(cfd, playerScore, cpuScore);
+		countMetric(sessionMetrics().rounds);
+		logEvent(LOG_ROUNDEND, currRound, player_ended_round ? 0 : (cpu_ended_round ? 1 : -1), addscore);
+		recordRound(recorder, dealer, misdeals, player_ended_round ? 0 : (cpu_ended_round ? 1 : -1), addscore, false,
+		            player_ended_round ? playerPile.comboMask() : (cpu_ended_round ? cpuPile.comboMask() : 0));
 	}
 
 	printFinalResults(cfd, playerScore, cpuScore, TOTALROUNDS);
+	submitGame(playerName, playerScore, TOTALROUNDS, playerScore > cpuScore);
+	logEvent(LOG_GAMEEND, playerScore, cpuScore);
+	checkpointEnd(checkpoint, cfd);
+	checkpoint = NULL;
+	recordGame(recorder, playerScore, cpuScore);
+	return true;
+}
+
+void playMatch(const int cfds[2], const string names[2], int rounds) {
+	DeckType deck;
+	Hand hands[2], table;
+	ScorePile piles[2];
+	int scores[2]     = {0, 0};
+	int misdeals      = 0;
+	std::random_device entropy;
+	unsigned int seed = entropy();
+	std::mt19937 rng(seed);
+	GameRecorder recorder;
+
+	int dealer = (rng() % 2 == 0) ? 0 : 1;		// (as playKoiKoi() & playGame() choose it)
+	FeaturedGame featured(cfds[0], names[0], rounds);		// (watched from seat 0)
+	recorder.begin(seed, RECORDHUMAN, RECORDHUMAN);
+	for (int s = 0; s < 2; s++) {
+		printOpponent(cfds[s], OPPONENT_ARENA, names[1-s]);
+	}
 
-	// send ending message to user
-	write_buf.clear();
-	write_buf += string("Enter 99 to quit.\n");
-	Rio_writen(cfd, const_cast<char*>(write_buf.c_str()), write_buf.length());
-	// get response from user
-	Rio_readinitb(&rio, cfd);
-	Rio_readlineb(&rio, read_buf, 20);
-	// (we don't actually care what the response is)
+	for (int round = 1; round <= rounds; round++) {
+		bool calledKK[2]   = {false, false};
+		bool endedRound[2] = {false, false};
+		bool roundOver     = false;
+		int  points        = 0;
+
+		for (int s = 0; s < 2; s++) {
+			printRoundHeader(cfds[s], round);
+			printDealer(cfds[s], dealer == s);
+		}
+		setup(deck, hands[dealer], hands[1-dealer], table, piles[0], piles[1], rng);
+		logEvent(LOG_DEAL, round, dealer);
+
+		// check for instant-win combos (as playKoiKoi() does)
+		int instant = (hands[0].instantWin2222() || hands[0].instantWin4()) ? 0 : ((hands[1].instantWin2222() || hands[1].instantWin4()) ? 1 : -1);
+		if (instant >= 0) {
+			scores[instant] += 6;
+			for (int s = 0; s < 2; s++) {
+				printInstantWin(cfds[s], (s == instant) ? 0 : 1, !hands[instant].instantWin2222());
+				printStandings(cfds[s], scores[s], scores[1-s]);
+			}
+			countMetric(sessionMetrics().rounds);
+			logEvent(LOG_INSTANTWIN, round, instant);
+			recordRound(recorder, dealer, misdeals, instant, 6, true, 0);
+			continue;
+		} else if (table.instantWin2222() || table.instantWin4()) {
+			for (int s = 0; s < 2; s++) {
+				printInstantWin(cfds[s], 2, !table.instantWin2222());
+			}
+			countMetric(sessionMetrics().misdeals);
+			logEvent(LOG_MISDEAL, round);
+			misdeals++;
+			round--;		// repeat this round
+			continue;
+		}
+
+		// play the round: each turn is prompted of the client whose turn it is, and shown to the other
+		for (int mover = dealer; !roundOver; mover = 1 - mover) {
+			int other = 1 - mover;
+			TurnRecord turn = doPlayerTurn(cfds[mover], hands[mover], deck, table, piles[mover], calledKK[mover], endedRound[mover],
+			                               calledKK[other], piles[other].finalScore(calledKK[mover]), mover);
+			recorder.addTurn(turn);
+			printScoreState(cfds[mover], piles[mover], calledKK[other], true);
+			printOpponentTurn(cfds[other], turn);
+			printScoreState(cfds[other], piles[mover], calledKK[other], false);
+
+			roundOver = endedRound[mover] || deck.isEmpty() || (hands[0].isEmpty() && hands[1].isEmpty());
+			if (!roundOver) {
+				for (int s = 0; s < 2; s++) {
+					sendToClient(cfds[s], "-----------------------------\t");
+				}
+			}
+		}
+
+		int winner = endedRound[0] ? 0 : (endedRound[1] ? 1 : -1);
+		if (winner >= 0) {
+			points = piles[winner].finalScore(calledKK[1-winner]);
+			scores[winner] += points;
+		}
+		for (int s = 0; s < 2; s++) {
+			if (winner >= 0) {
+				printGetPoints(cfds[s], points, s == winner);
+			} else {
+				printNoPoints(cfds[s]);
+			}
+			printStandings(cfds[s], scores[s], scores[1-s]);
+		}
+		countMetric(sessionMetrics().rounds);
+		logEvent(LOG_ROUNDEND, round, winner, points);
+		recordRound(recorder, dealer, misdeals, winner, points, false, (winner >= 0) ? piles[winner].comboMask() : 0);
+		dealer = (winner >= 0) ? winner : dealer;		// winner becomes next dealer
+	}
+
+	for (int s = 0; s < 2; s++) {
+		printFinalResults(cfds[s], scores[s], scores[1-s], rounds);
+		submitGame(names[s], scores[s], rounds, scores[s] > scores[1-s]);
+	}
+	logEvent(LOG_GAMEEND, scores[0], scores[1]);
+	recordGame(recorder, scores[0], scores[1]);
+	return;
+}
+
+int serviceKoiKoi (int cfd) {
+	CheckpointSession *checkpoint = NULL;
+	GameSettings settings;
+	AfterGame after = AFTER_AGAIN;
+
+	settings.chosen = false;
+	if (!openClient(cfd)) {
+		logText(LOG_SERVER, "A connection's fd is too high to serve");
+		return -1;
+	}
+	try {
+		// play games for as long as the client asks for another, showing the leaderboard after each for as long as they ask for it
+		while (after == AFTER_AGAIN && playKoiKoi(cfd, checkpoint, settings)) {
+			while ((after = promptAfterGame(cfd)) == AFTER_LEADERBOARD) {
+				printLeaderboard(cfd, settings.name);
+			}
+		}
+	} catch (const ClientGone &) {		// the connection was lost: the game (if it got that far) waits for the client to come back
+		if (checkpoint != NULL) {
+			parkCheckpoint(checkpoint, cfd);
+			logEvent(LOG_PARK, CHECKPOINTGRACE);
+		}
+	}
+	closeClient(cfd);
 	return 0;
 }
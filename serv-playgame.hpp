@@ -1,6 +1,10 @@
 #ifndef GAMEFUNCTION_H
 #define GAMEFUNCTION_H
 
+#include <string>
+
 int serviceKoiKoi (int cfd);
+void playMatch(const int cfds[2], const std::string names[2], int rounds);		// plays a game between two clients, on the calling thread (see "serv-match.hpp")
+void openGameRecords(const char *path);		// from now on, every game played to the end is appended to the record store at path (see "koikoi-record.hpp")
 
 #endif
\ No newline at end of file
@@ -0,0 +1,280 @@
+#include "serv-watch.hpp"
+#include "serv-koikoi.hpp"
+#include "serv-json.hpp"
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <new>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+// one event, serialized once (as a frame, or as a line of JSON), and shared by every spectator it is queued for
+struct SharedEvent {
+	std::atomic<int>	refs;			// # of spectators' queues (or batches being written) it is in
+	int					length;
+	unsigned char		*bytes;			// (allocated along with it, straight after it)
+};
+
+// a client watching a featured game (on its own thread's stack)
+struct Spectator {
+	int							cfd;
+	bool						json;
+	bool						skipping;		// nothing is queued for it until the next round starts (it fell behind, or has just joined)
+	bool						gone;			// its connection has failed
+	int							sent;			// # of events written to it
+	int							skips;			// # of times it was skipped ahead
+	std::deque<SharedEvent*>	queued;			// (guarded by the broadcast's lock, like skipping)
+};
+
+struct Broadcast {
+	pthread_mutex_t				lock;
+	pthread_cond_t				wake;			// signalled when anything is queued, and when the game ends
+	int							number;			// # of the featured game (1 to FEATUREDGAMES)
+	bool						live;			// whether the game is being played
+	std::string					name;			// the player in seat 0's leaderboard name
+	int							rounds;
+	WireFrame					opponent;		// the last WIRE_OPPONENT cast, for spectators that join later
+	std::vector<Spectator*>		spectators;
+	std::atomic<int>			watching;		// # of spectators, for reading without the lock
+
+	Broadcast() : number(0), live(false), rounds(0), opponent(WIRE_OPPONENT), watching(0) {
+		pthread_mutex_init(&lock, NULL);
+		pthread_cond_init(&wake, NULL);
+	}
+};
+
+static Broadcast featured[FEATUREDGAMES];
+static thread_local Broadcast *unwoken = NULL;		// the game this thread has queued events for since it last woke its spectators
+
+static SharedEvent *newEvent(const void *bytes, int length) {
+	void *block = malloc(sizeof(SharedEvent) + length);
+	if (block == NULL) {
+		throw std::bad_alloc();
+	}
+	SharedEvent *event = new (block) SharedEvent;
+	event->refs.store(0, std::memory_order_relaxed);
+	event->length = length;
+	event->bytes  = static_cast<unsigned char*>(block) + sizeof(SharedEvent);
+	memcpy(event->bytes, bytes, length);
+	return event;
+}
+
+// lets go of one reference to the event, freeing it with the last
+static void releaseEvent(SharedEvent *event) {
+	if (event->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		event->~SharedEvent();
+		free(event);
+	}
+	return;
+}
+
+// drops everything queued for the spectator (the broadcast's lock must be held)
+static void dropQueued(Spectator *spectator) {
+	for (SharedEvent *event : spectator->queued) {
+		releaseEvent(event);
+	}
+	spectator->queued.clear();
+	return;
+}
+
+FeaturedGame::FeaturedGame(int cfd, const std::string &name, int rounds) : cfd(cfd), broadcast(NULL) {
+	for (int i = 0; i < FEATUREDGAMES && broadcast == NULL; i++) {
+		Broadcast &slot = featured[i];
+		pthread_mutex_lock(&slot.lock);
+		if (!slot.live && slot.spectators.empty()) {		// (a slot is free once the last game's spectators have all left)
+			slot.number   = i + 1;
+			slot.live     = true;
+			slot.name     = name;
+			slot.rounds   = rounds;
+			slot.opponent = WireFrame(WIRE_OPPONENT);
+			broadcast = &slot;
+		}
+		pthread_mutex_unlock(&slot.lock);
+	}
+	if (broadcast != NULL) {
+		featureClient(cfd, broadcast);
+	}
+}
+
+FeaturedGame::~FeaturedGame() {
+	if (broadcast == NULL) {
+		return;
+	}
+	featureClient(cfd, NULL);
+	if (unwoken == broadcast) {
+		unwoken = NULL;
+	}
+	pthread_mutex_lock(&broadcast->lock);
+	broadcast->live = false;
+	pthread_cond_broadcast(&broadcast->wake);
+	pthread_mutex_unlock(&broadcast->lock);
+}
+
+void castEvent(Broadcast *broadcast, const unsigned char *frame) {
+	int length = WIREHEADER + frame[1];
+	if (frame[0] == WIRE_OPPONENT) {
+		pthread_mutex_lock(&broadcast->lock);
+		memcpy(broadcast->opponent.bytes, frame, length);
+		broadcast->opponent.length = length;
+		pthread_mutex_unlock(&broadcast->lock);
+	}
+	if (broadcast->watching.load(std::memory_order_relaxed) == 0) {
+		return;
+	}
+	bool roundStarts = (frame[0] == WIRE_ROUND);
+	bool gameEnds    = (frame[0] == WIRE_FINAL || frame[0] == WIRE_ABANDONED);
+	SharedEvent *asFrame = NULL, *asJson = NULL;		// (each made the first time a spectator needs it)
+
+	pthread_mutex_lock(&broadcast->lock);
+	for (Spectator *spectator : broadcast->spectators) {
+		if (spectator->gone || (spectator->skipping && !roundStarts && !gameEnds)) {
+			continue;
+		}
+		if (static_cast<int>(spectator->queued.size()) >= WATCHBACKLOG) {		// it has fallen behind: skip it ahead to the next round
+			dropQueued(spectator);
+			spectator->skipping = true;
+			spectator->skips++;
+			if (!roundStarts && !gameEnds) {
+				continue;
+			}
+		}
+		if (roundStarts) {
+			spectator->skipping = false;
+		}
+		SharedEvent *&event = spectator->json ? asJson : asFrame;
+		if (event == NULL && spectator->json) {
+			char line[JSONMAXEVENT];
+			event = newEvent(line, frameToJson(frame, line));
+		} else if (event == NULL) {
+			event = newEvent(frame, length);
+		}
+		event->refs.fetch_add(1, std::memory_order_relaxed);
+		spectator->queued.push_back(event);
+	}
+	pthread_mutex_unlock(&broadcast->lock);
+	if (asFrame != NULL || asJson != NULL) {
+		unwoken = broadcast;
+	}
+	return;
+}
+
+void wakeSpectators() {
+	if (unwoken != NULL) {
+		pthread_cond_broadcast(&unwoken->wake);
+		unwoken = NULL;
+	}
+	return;
+}
+
+// writes a batch of events to the spectator in one go, straight from their shared buffers; returns false if the connection fails
+static bool writeEvents(int cfd, SharedEvent *const *batch, int count) {
+	struct iovec iov[WATCHBATCH];
+	struct iovec *at = iov;
+	for (int i = 0; i < count; i++) {
+		iov[i].iov_base = batch[i]->bytes;
+		iov[i].iov_len  = batch[i]->length;
+	}
+	while (count > 0) {
+		ssize_t written = writev(cfd, at, count);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+		if (written <= 0) {				// (including a write that timed out after WATCHTIMEOUT)
+			return false;
+		}
+		countMetric(sessionMetrics().bytesOut, written);
+		for (; count > 0 && static_cast<size_t>(written) >= at->iov_len; at++, count--) {
+			written -= at->iov_len;
+		}
+		if (count > 0) {				// (part of an event was written: the rest goes next)
+			at->iov_base = static_cast<unsigned char*>(at->iov_base) + written;
+			at->iov_len -= written;
+		}
+	}
+	return true;
+}
+
+void watchGame(int cfd, int game) {
+	if (clientProtocol(cfd) == PROTOCOL_TEXT) {
+		sendToClient(cfd, std::string("Sorry, games can only be watched by a binary or JSON client.\t"));
+		return;
+	}
+	Spectator self;
+	self.cfd      = cfd;
+	self.json     = (clientProtocol(cfd) == PROTOCOL_JSON);
+	self.skipping = true;				// (from the start of the next round)
+	self.gone     = false;
+	self.sent     = 0;
+	self.skips    = 0;
+	WireFrame watching(WIRE_WATCHING), opponent(WIRE_OPPONENT);
+	Broadcast *broadcast = NULL;
+	int number = 0;
+
+	for (int i = 0; i < FEATUREDGAMES && broadcast == NULL; i++) {
+		Broadcast &slot = featured[i];
+		if (game != 0 && game != i + 1) {
+			continue;
+		}
+		pthread_mutex_lock(&slot.lock);
+		if (slot.live) {
+			watching.u8(slot.number).u8(slot.rounds).text(slot.name.data(), slot.name.length());
+			opponent = slot.opponent;
+			slot.spectators.push_back(&self);
+			slot.watching.fetch_add(1, std::memory_order_relaxed);
+			broadcast = &slot;
+			number    = slot.number;
+		}
+		pthread_mutex_unlock(&slot.lock);
+	}
+	if (broadcast == NULL) {			// (nothing to watch)
+		sendFrame(cfd, watching.u8(0).u8(0));
+		return;
+	}
+
+	// from here on, a spectator that stops reading is dropped, rather than holding up its thread for good
+	struct timeval timeout = {WATCHTIMEOUT, 0};
+	setsockopt(cfd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+	try {
+		sendFrame(cfd, watching);
+		if (opponent.length > WIREHEADER) {
+			sendFrame(cfd, opponent);
+		}
+	} catch (const ClientGone &) {
+		self.gone = true;
+	}
+
+	// write out whatever is queued, until the game is over and it has all been written
+	SharedEvent *batch[WATCHBATCH];
+	pthread_mutex_lock(&broadcast->lock);
+	while (!self.gone) {
+		while (self.queued.empty() && broadcast->live) {
+			pthread_cond_wait(&broadcast->wake, &broadcast->lock);
+		}
+		if (self.queued.empty()) {
+			break;
+		}
+		int count = 0;
+		for (; count < WATCHBATCH && !self.queued.empty(); count++) {
+			batch[count] = self.queued.front();
+			self.queued.pop_front();
+		}
+		pthread_mutex_unlock(&broadcast->lock);
+		bool written = writeEvents(cfd, batch, count);
+		for (int i = 0; i < count; i++) {
+			releaseEvent(batch[i]);
+		}
+		pthread_mutex_lock(&broadcast->lock);
+		self.gone  = !written;
+		self.sent += written ? count : 0;
+	}
+	broadcast->spectators.erase(std::find(broadcast->spectators.begin(), broadcast->spectators.end(), &self));
+	broadcast->watching.fetch_sub(1, std::memory_order_relaxed);
+	dropQueued(&self);
+	pthread_mutex_unlock(&broadcast->lock);
+	logEvent(LOG_WATCH, number, self.sent, self.skips);
+	return;
+}
@@ -0,0 +1,46 @@
+#ifndef SERV_WATCH_H
+#define SERV_WATCH_H
+
+#include <string>
+
+/*  ========================================
+WATCHING GAMES
+Up to FEATUREDGAMES games at a time are featured: each game takes a free slot when it starts (if there is one), and
+gives it back when it ends. A binary or JSON client can watch one instead of playing, by answering the name prompt
+with "watch" (the first featured game being played) or "watch <n>" (the n-th). It is sent WIRE_WATCHING, then every
+event of the game as the player in seat 0 is shown it (never a prompt, or the game's token), from the start of the
+next round on; when the game is over, its connection is closed.
+
+Each event is cast to the spectators once, as it happens: it is serialized a single time for all of them (once as a
+frame and once as a line of JSON, if any spectator speaks each), into a buffer that is counted by reference, and each
+spectator's queue just gets a pointer to it. The game's thread never writes to a spectator: it wakes the spectators'
+own threads once each time it waits on a player's answer, and each one writes out everything queued for it since (up
+to WATCHBATCH events) with one writev(), straight from the shared buffers, and lets go of them. So players never wait
+on spectators, however many there are, or however slowly they read. A spectator that falls WATCHBACKLOG events behind
+is skipped ahead instead: what is queued for it is dropped, and it is sent nothing more until the next round starts
+(or the game ends). One whose writes block for WATCHTIMEOUT seconds is dropped.
+========================================    */
+
+#define FEATUREDGAMES	4			// # of games that can be watched at once
+#define WATCHBACKLOG	256			// # of events queued for a spectator before it is skipped ahead
+#define WATCHBATCH		64			// most events written to a spectator in one writev()
+#define WATCHTIMEOUT	10			// s a spectator's connection can hold up a write before it is dropped
+
+struct Broadcast;		// a featured game's spectators, and what is queued for them
+
+// features the client's game for as long as it is in scope, if one of the FEATUREDGAMES slots is free
+class FeaturedGame {
+public:
+	FeaturedGame(int cfd, const std::string &name, int rounds);
+	~FeaturedGame();
+
+private:
+	int			cfd;
+	Broadcast	*broadcast;			// (NULL if no slot was free)
+};
+
+void castEvent(Broadcast *broadcast, const unsigned char *frame);		// queues the frame for every spectator of the game
+void wakeSpectators();													// has the spectators write out what the calling thread has queued for them
+void watchGame(int cfd, int game);										// has the client watch featured game # game (0 for the first being played) until it ends
+
+#endif
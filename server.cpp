@@ -3,44 +3,99 @@ extern "C" {
 #include "csapp.h"
 }
 #include <cstdlib>
+#include <netinet/tcp.h>
 #include "serv-playgame.hpp"
+#include "serv-metrics.hpp"
+#include "serv-log.hpp"
+#include "serv-leaderboard.hpp"
+#include "serv-checkpoint.hpp"
+
+// each session's thread gets a stack this size, rather than the default (8 MB on Linux), so that thousands of games (and
+// twice as many threads, with the arena's bots) fit in the server's address space; a session needs well under a tenth of it
+#define SESSIONSTACK    (256 * 1024)
 
 typedef struct {
     int cfd;                // connection file descriptor
-    char hostn[MAXLINE];    // host name
-    char portn[MAXLINE];    // port name
+    long session;           // session # (for the log)
+    struct sockaddr_storage addr;   // client's address
+    socklen_t addrlen;
 } ClientInfo;
 
-// void *thread(void *vargp);
+void *thread(void *vargp);     // serves one client, on its own thread
 
 int main(int argc, char**argv) {
     int listenfd;
     ClientInfo *clientptr;
-    socklen_t clientlen;
-    struct sockaddr_storage clientaddr;
-    
-    printf("Initializing server...\n");
+    pthread_t tid;
+    pthread_attr_t attr;
+    long sessions = 0;
+    char message[MAXLINE];
+
+    // everything the server has to say goes through the log, written by its own thread (to an optional third argument, or stdout)
+    startLogger((argc > 3 && strcmp(argv[3], "-") != 0) ? argv[3] : NULL);
+    logText(LOG_SERVER, "Initializing server...");
     listenfd = Open_listenfd(argv[1]);
-    printf("Server ready to receive connection.\n\n");
+    if (argc > 2 && strcmp(argv[2], "-") != 0) {     // metrics are served on an optional second (local-only) port
+        startAdminServer(argv[2]);
+        snprintf(message, sizeof(message), "Serving metrics on localhost:%s.", argv[2]);
+        logText(LOG_SERVER, message);
+    }
+    if (argc > 4 && strcmp(argv[4], "-") != 0) {     // finished games are recorded to an optional fourth argument
+        openGameRecords(argv[4]);
+        snprintf(message, sizeof(message), "Recording games to %s.", argv[4]);
+        logText(LOG_SERVER, message);
+    }
+    if (argc > 5 && strcmp(argv[5], "-") != 0) {     // the leaderboard is kept in an optional fifth argument (otherwise it only lasts as long as the server)
+        openLeaderboard(argv[5]);
+        snprintf(message, sizeof(message), "Keeping the leaderboard in %s.", argv[5]);
+        logText(LOG_SERVER, message);
+    }
+    if (argc > 6 && strcmp(argv[6], "-") != 0) {     // games in progress are checkpointed to an optional sixth argument, so that they can be resumed after a restart
+        openCheckpoints(argv[6]);
+        snprintf(message, sizeof(message), "Checkpointing games to %s.", argv[6]);
+        logText(LOG_SERVER, message);
+    }
+    // a client that drops mid-write shows up as a failed write to its session (which parks its game), not as a SIGPIPE
+    // that would take the whole server down
+    signal(SIGPIPE, SIG_IGN);
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, SESSIONSTACK);
+    logText(LOG_SERVER, "Server ready to receive connection.");
     
     while (1) {
         //dynamically allocate memory and create connection to client
-        clientlen = sizeof(struct sockaddr_storage);
         clientptr = new ClientInfo;
-        clientptr->cfd = Accept(listenfd, (struct sockaddr *) &clientaddr, &clientlen);
+        clientptr->addrlen = sizeof(struct sockaddr_storage);
+        clientptr->cfd     = accept(listenfd, (struct sockaddr *) &clientptr->addr, &clientptr->addrlen);
+        if (clientptr->cfd < 0) {       // (e.g. the client gave up before it was accepted, or we are out of fds): keep serving the others
+            snprintf(message, sizeof(message), "Accept error: %s", strerror(errno));
+            logText(LOG_SERVER, message);
+            delete clientptr;
+            continue;
+        }
+        clientptr->session = ++sessions;
+
+        // send every message as soon as it is written: the server writes each prompt in several pieces, and otherwise
+        // the last piece would wait for the client to acknowledge the others (up to 40 ms on Linux) before it goes out
+        int nodelay = 1;
+        setsockopt(clientptr->cfd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
 
-        // print info of who we've connected to
-        Getnameinfo( (struct sockaddr *) &clientaddr, clientlen, clientptr->hostn, MAXLINE, clientptr->portn, MAXLINE, 0);
-        printf("Connected to (%s, %s).\n", clientptr->hostn, clientptr->portn);
-        
-        // make a thread to deal with this new client
-        serviceKoiKoi(clientptr->cfd);
-        
-        //then wait for a new client
-        printf("Connection to (%s, %s) closed.\n", clientptr->hostn, clientptr->portn);
-        close(clientptr->cfd);
-        delete clientptr;
-        
+        // notice a client that vanished without closing its connection (a phone losing signal) after about 90 s of
+        // silence, rather than keeping its thread waiting on a prompt for hours: its game is then parked for it
+        int keepalive = 1, idle = 60, interval = 10, probes = 3;
+        setsockopt(clientptr->cfd, SOL_SOCKET, SO_KEEPALIVE, &keepalive, sizeof(keepalive));
+        setsockopt(clientptr->cfd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+        setsockopt(clientptr->cfd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+        setsockopt(clientptr->cfd, IPPROTO_TCP, TCP_KEEPCNT, &probes, sizeof(probes));
+
+        // make a thread to deal with this new client (it frees clientptr when the client is done)
+        int rc = pthread_create(&tid, &attr, thread, clientptr);
+        if (rc != 0) {
+            snprintf(message, sizeof(message), "Could not start a session thread: %s", strerror(rc));
+            logText(LOG_SERVER, message);
+            close(clientptr->cfd);
+            delete clientptr;
+        }
     }
     return 0;
 }
@@ -48,36 +103,35 @@ int main(int argc, char**argv) {
 /* ================================================================
    SERVICE THREAD
    ================================================================ */
-/*
 void *thread(void *vargp) {
-    int userchoice;  //holds user-input choice
     //get info from the clientptr object passed here
     ClientInfo *thisClient = (ClientInfo*)vargp;
     int connfd = thisClient->cfd;
+    char hostn[NI_MAXHOST], portn[NI_MAXSERV], client[NI_MAXHOST + NI_MAXSERV + 8];
     
     //run in "detached" mode so that we self-reap once we hit "return NULL"
     pthread_detach(pthread_self());
+
+    // log who we've connected to (numerically: a reverse DNS lookup could take seconds)
+    logSession(thisClient->session);
+    if (getnameinfo( (struct sockaddr *) &thisClient->addr, thisClient->addrlen, hostn, NI_MAXHOST, portn, NI_MAXSERV, NI_NUMERICHOST | NI_NUMERICSERV) != 0) {
+        strcpy(hostn, "?");
+        strcpy(portn, "?");
+    }
+    snprintf(client, sizeof(client), "(%s, %s)", hostn, portn);
+    logText(LOG_CONNECT, client);
     
     // BEGIN SERVICE
-    do {
-        userchoice = PromptUserChoice(connfd);
-        //if (userchoice == 1) {      //if the user chooses 1, then we're adding a new record
-        //    AddRecordService(connfd);
-        //} 
-        //else
-        if (userchoice == 1) { //if the user chooses 2, then we're reading for a record
-            ReadRecordService(connfd);
-        }
-    } while (userchoice != 2); //if the user chooses 3, then we're closing the connection
+    metricsStartSession();
+    serviceKoiKoi(connfd);
+    metricsEndSession();
 
     // END SERVICE
-    PrintGoodbye(connfd);
-    printf("Connection to (%s, %s) closed.\n", thisClient->hostn, thisClient->portn);
+    logText(LOG_DISCONNECT, client);
     close(connfd);
     
     //free the dynamically-allocated memory to avoid a leak
-    free(vargp);
+    delete thisClient;
     
     return NULL;
 }
-*/
\ No newline at end of file
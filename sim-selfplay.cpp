@@ -0,0 +1,214 @@
+#include "sim-selfplay.hpp"
+#include "koikoi-engine.hpp"
+extern "C" {
+#include "csapp.h"
+}
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+/* =====================================
+STATISTICS
+===================================== */
+
+SelfPlayStats::SelfPlayStats() {
+	memset(this, 0, sizeof(SelfPlayStats));		// every member is a plain counter
+}
+
+void SelfPlayStats::merge(const SelfPlayStats &other) {
+	games          += other.games;
+	rounds         += other.rounds;
+	turns          += other.turns;
+	gameTies       += other.gameTies;
+	roundsNoPoints += other.roundsNoPoints;
+	instantWins    += other.instantWins;
+	misdeals       += other.misdeals;
+	for (int seat = 0; seat < 2; seat++) {
+		gameWins[seat]     += other.gameWins[seat];
+		gamePoints[seat]   += other.gamePoints[seat];
+		gamePointsSq[seat] += other.gamePointsSq[seat];
+		roundWins[seat]    += other.roundWins[seat];
+		koikoiCalls[seat]  += other.koikoiCalls[seat];
+		koikoiRounds[seat] += other.koikoiRounds[seat];
+		koikoiWon[seat]    += other.koikoiWon[seat];
+		koikoiLost[seat]   += other.koikoiLost[seat];
+		for (int p = 0; p <= POINTBUCKETS; p++) {
+			roundPoints[seat][p] += other.roundPoints[seat][p];
+		}
+	}
+	return;
+}
+
+// counts up every round as the engine finishes it
+// (and records them too, if it is given a recorder)
+class StatsObserver {
+private:
+	SelfPlayStats &stats;
+	GameRecorder *recorder;
+public:
+	StatsObserver(SelfPlayStats &s, GameRecorder *r) : stats(s), recorder(r) {}
+
+	void onTurn(const GameState &game, int seat, const TurnRecord &turn) {
+		if (recorder != NULL) {
+			recorder->onTurn(game, seat, turn);
+		}
+	}
+
+	void onRound(const GameState &game, const RoundResult &result) {
+		if (recorder != NULL) {
+			recorder->onRound(game, result);
+		}
+		stats.rounds++;
+		stats.turns    += result.turns;
+		stats.misdeals += result.misdeals;
+		if (result.winner == -1) {
+			stats.roundsNoPoints++;
+		} else {
+			stats.roundWins[result.winner]++;
+			stats.roundPoints[result.winner][result.points < POINTBUCKETS ? result.points : POINTBUCKETS]++;
+			if (result.instantWin) {
+				stats.instantWins++;
+			}
+		}
+		for (int seat = 0; seat < 2; seat++) {
+			if (result.koikoiCalls[seat] > 0) {
+				stats.koikoiCalls[seat]  += result.koikoiCalls[seat];
+				stats.koikoiRounds[seat]++;
+				if (result.winner == seat) {
+					stats.koikoiWon[seat]++;
+				} else if (result.winner == 1-seat) {
+					stats.koikoiLost[seat]++;
+				}
+			}
+		}
+		return;
+	}
+};
+
+/* =====================================
+WORKER THREADS
+===================================== */
+
+// everything one worker thread needs; each thread has its own generator, game state, strategies, and stats
+struct SelfPlayWorker {
+	const SelfPlayConfig	*config;
+	int						index;		// which worker this is (0 to threads-1)
+	long					games;		// # of games this worker plays
+	SelfPlayStats			stats;
+};
+
+static void *selfPlayThread(void *vargp) {
+	SelfPlayWorker *worker = static_cast<SelfPlayWorker*>(vargp);
+	const SelfPlayConfig &config = *worker->config;
+
+	std::seed_seq seeds = {config.seed, static_cast<unsigned int>(worker->index)};
+	std::mt19937 rng(seeds);					// same seed & thread count => same games
+	std::mt19937 deals;							// each game is dealt from its own seed, so that its record can replay it
+	GameState game;
+	GameRecorder recorder;
+	StatsObserver observer(worker->stats, (config.records != NULL) ? &recorder : NULL);
+	SelfPlayStats &stats = worker->stats;
+
+	visitStrategy(config.strategies[0], rng(), [&](auto &cpu0) {
+		visitStrategy(config.strategies[1], rng(), [&](auto &cpu1) {
+			for (long g = 0; g < worker->games; g++) {
+				unsigned int seed = rng();
+				deals.seed(seed);
+				recorder.begin(seed, config.strategies[0], config.strategies[1]);
+				int winner = playGame(game, cpu0, cpu1, config.rounds, deals, observer);
+				if (config.records != NULL) {
+					recorder.finish(game.scores[0], game.scores[1]);
+					config.records->append(recorder.data(), recorder.length());
+				}
+				stats.games++;
+				if (winner == -1) {
+					stats.gameTies++;
+				} else {
+					stats.gameWins[winner]++;
+				}
+				for (int seat = 0; seat < 2; seat++) {
+					stats.gamePoints[seat]   += game.scores[seat];
+					stats.gamePointsSq[seat] += static_cast<double>(game.scores[seat]) * game.scores[seat];
+				}
+			}
+		});
+	});
+	return NULL;
+}
+
+// plays all the games, split as evenly as possible across the worker threads
+SelfPlayStats runSelfPlay(const SelfPlayConfig &config, double &seconds) {
+	std::vector<SelfPlayWorker> workers(config.threads);
+	std::vector<pthread_t> tids(config.threads);
+	SelfPlayStats total;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < config.threads; i++) {
+		workers[i].config = &config;
+		workers[i].index  = i;
+		workers[i].games  = config.games / config.threads + (i < config.games % config.threads ? 1 : 0);
+		Pthread_create(&tids[i], NULL, selfPlayThread, &workers[i]);
+	}
+	for (int i = 0; i < config.threads; i++) {
+		Pthread_join(tids[i], NULL);
+		total.merge(workers[i].stats);
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	return total;
+}
+
+/* =====================================
+REPORTING
+===================================== */
+
+// percentage of part in whole, or 0 if whole is 0
+static double percent(long part, long whole) {
+	return (whole == 0) ? 0.0 : 100.0 * part / whole;
+}
+
+void printSelfPlayReport(const SelfPlayConfig &config, const SelfPlayStats &stats, double seconds) {
+	printf("%ld games of %d rounds: %s (seat 0) vs %s (seat 1), %d threads, seed %u\n",
+	       stats.games, config.rounds, strategyName(config.strategies[0]), strategyName(config.strategies[1]), config.threads, config.seed);
+	printf("Played in %.3f s: %.0f games/s, %.0f rounds/s, %.0f turns/s\n\n",
+	       seconds, stats.games / seconds, stats.rounds / seconds, stats.turns / seconds);
+
+	printf("GAMES\n");
+	printf("  won by seat 0:        %6.2f%%\n", percent(stats.gameWins[0], stats.games));
+	printf("  won by seat 1:        %6.2f%%\n", percent(stats.gameWins[1], stats.games));
+	printf("  tied:                 %6.2f%%\n", percent(stats.gameTies, stats.games));
+	for (int seat = 0; seat < 2; seat++) {
+		double mean = (stats.games == 0) ? 0.0 : static_cast<double>(stats.gamePoints[seat]) / stats.games;
+		double var  = (stats.games == 0) ? 0.0 : stats.gamePointsSq[seat] / stats.games - mean * mean;
+		printf("  seat %d points/game:   %6.2f  (std. dev. %.2f)\n", seat, mean, std::sqrt(var > 0 ? var : 0));
+	}
+
+	printf("\nROUNDS\n");
+	printf("  scored by seat 0:     %6.2f%%\n", percent(stats.roundWins[0], stats.rounds));
+	printf("  scored by seat 1:     %6.2f%%\n", percent(stats.roundWins[1], stats.rounds));
+	printf("  no points (deck out): %6.2f%%\n", percent(stats.roundsNoPoints, stats.rounds));
+	printf("  instant wins:         %6.2f%%\n", percent(stats.instantWins, stats.rounds));
+	printf("  misdeals per round:   %8.4f\n", (stats.rounds == 0) ? 0.0 : static_cast<double>(stats.misdeals) / stats.rounds);
+	printf("  turns per round:      %6.2f\n", (stats.rounds == 0) ? 0.0 : static_cast<double>(stats.turns) / stats.rounds);
+
+	printf("\nKOI-KOI\n");
+	for (int seat = 0; seat < 2; seat++) {
+		printf("  seat %d: %.3f calls/round, called in %.2f%% of rounds; of those, won %.2f%%, lost %.2f%%\n", seat,
+		       (stats.rounds == 0) ? 0.0 : static_cast<double>(stats.koikoiCalls[seat]) / stats.rounds,
+		       percent(stats.koikoiRounds[seat], stats.rounds),
+		       percent(stats.koikoiWon[seat], stats.koikoiRounds[seat]),
+		       percent(stats.koikoiLost[seat], stats.koikoiRounds[seat]));
+	}
+
+	printf("\nPOINTS PER SCORING ROUND      seat 0    seat 1\n");
+	for (int p = 0; p <= POINTBUCKETS; p++) {
+		if (stats.roundPoints[0][p] == 0 && stats.roundPoints[1][p] == 0) {
+			continue;				// skip point values that never came up
+		}
+		printf("  %3d%s                       %6.2f%%   %6.2f%%\n", p, (p == POINTBUCKETS) ? "+" : " ",
+		       percent(stats.roundPoints[0][p], stats.roundWins[0]), percent(stats.roundPoints[1][p], stats.roundWins[1]));
+	}
+	return;
+}
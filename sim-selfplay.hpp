@@ -0,0 +1,45 @@
+#ifndef SIM_SELFPLAY_H
+#define SIM_SELFPLAY_H
+
+#include "koikoi-strategy.hpp"
+#include "koikoi-record.hpp"
+
+#define POINTBUCKETS 64		// points-per-round histogram has one bucket per point value up to this, and one more for everything above
+
+// settings for a batch of self-play games
+struct SelfPlayConfig {
+	StrategyKind	strategies[2];		// which strategy plays each seat
+	long			games;				// total # of games to play
+	int				rounds;				// # of rounds per game
+	int				threads;			// # of worker threads
+	unsigned int	seed;				// base seed; each thread derives its own generator from it, and each game its own seed
+	RecordStore		*records;			// every game is appended here, if this is not NULL
+};
+
+// everything counted over a batch of self-play games (each worker thread fills its own, and they are merged at the end)
+struct SelfPlayStats {
+	long	games;
+	long	rounds;
+	long	turns;
+	long	gameWins[2];						// games won by each seat
+	long	gameTies;
+	long	gamePoints[2];						// sum of each seat's final game score
+	double	gamePointsSq[2];					// sum of squares of each seat's final game score (for the standard deviation)
+	long	roundWins[2];						// rounds in which each seat scored
+	long	roundsNoPoints;						// rounds that ended with the deck running out
+	long	instantWins;						// rounds won by an instant-win hand
+	long	misdeals;							// deals that had to be redone
+	long	roundPoints[2][POINTBUCKETS+1];		// histogram of points scored in each round won, per seat
+	long	koikoiCalls[2];						// times each seat called Koi-Koi
+	long	koikoiRounds[2];					// rounds in which each seat called Koi-Koi at least once
+	long	koikoiWon[2];						// ...of which the caller went on to score
+	long	koikoiLost[2];						// ...of which the opponent went on to score
+
+	SelfPlayStats();
+	void merge(const SelfPlayStats &other);		// adds the other stats into these
+};
+
+SelfPlayStats runSelfPlay(const SelfPlayConfig &config, double &seconds);		// plays all the games across config.threads threads; also returns the wall-clock time taken
+void printSelfPlayReport(const SelfPlayConfig &config, const SelfPlayStats &stats, double seconds);	// prints a summary to stdout
+
+#endif
@@ -0,0 +1,323 @@
+#include "sim-tournament.hpp"
+#include "koikoi-engine.hpp"
+extern "C" {
+#include "csapp.h"
+}
+#include <random>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+#define DEALSPERBATCH 256		// # of deals handed to a worker thread at a time
+
+/* =====================================
+PAIR RESULTS
+===================================== */
+
+void PairResult::merge(const PairResult &other) {
+	games    += other.games;
+	winsA    += other.winsA;
+	winsB    += other.winsB;
+	ties     += other.ties;
+	dupPairs += other.dupPairs;
+	dupSum   += other.dupSum;
+	dupSumSq += other.dupSumSq;
+	return;
+}
+
+double PairResult::scoreA() const {
+	return (games == 0) ? 0.5 : (winsA + 0.5 * ties) / games;
+}
+
+double PairResult::designEffect() const {
+	if (dupPairs < 2 || games == 0) {
+		return 1.0;
+	}
+	double p       = scoreA();
+	double perGame = (winsA + 0.25 * ties) / games - p * p;		// variance of a single game's score (a tie scores 0.5, so counts 0.25 towards E[score^2])
+	double mean    = dupSum / dupPairs;
+	double perPair = dupSumSq / dupPairs - mean * mean;			// observed variance of a duplicate pair's score
+	if (perGame <= 0) {
+		return 1.0;
+	}
+	return std::max(0.05, perPair / (2 * perGame));
+}
+
+/* =====================================
+WORKER THREADS
+===================================== */
+
+// one batch of deals for one pair of entrants
+struct TournamentItem {
+	int			pair;			// index into the list of pairs
+	long		firstDeal;		// deals [firstDeal, lastDeal) are played
+	long		lastDeal;
+	PairResult	result;
+};
+
+// shared by all the worker threads; each item is only ever touched by the thread that took it
+struct TournamentPool {
+	const TournamentConfig		*config;
+	std::vector<TournamentItem>	items;
+	std::atomic<long>			next;		// index of the next item to hand out
+};
+
+// score of the seat that A sat in: 1 for a win, 0.5 for a tie, 0 for a loss
+static double scoreFor(int winner, int seat) {
+	return (winner == -1) ? 0.5 : (winner == seat ? 1.0 : 0.0);
+}
+
+static void playItem(const TournamentConfig &config, const std::vector<Entrant> &entrants, TournamentItem &item, int a, int b) {
+	GameState game;
+	std::mt19937 rng;
+	PairResult &result = item.result;
+
+	// strategies are seeded from the deal set too, so that the whole tournament is reproducible from the seed
+	std::seed_seq strategySeeds = {config.seed, static_cast<unsigned int>(item.pair), static_cast<unsigned int>(item.firstDeal)};
+	unsigned int seeds[2];
+	strategySeeds.generate(seeds, seeds + 2);
+
+	visitStrategy(entrants[a].kind, seeds[0], [&](auto &cpuA) {
+		visitStrategy(entrants[b].kind, seeds[1], [&](auto &cpuB) {
+			for (long deal = item.firstDeal; deal < item.lastDeal; deal++) {
+				std::seed_seq dealSeed = {config.seed, static_cast<unsigned int>(deal)};
+				double score;
+
+				rng.seed(dealSeed);
+				int first  = playGame(game, cpuA, cpuB, config.rounds, rng);		// A in seat 0
+				rng.seed(dealSeed);
+				int second = playGame(game, cpuB, cpuA, config.rounds, rng);		// same deals, A in seat 1
+
+				int outcomes[2] = {first, second};
+				int seatOfA[2]  = {0, 1};
+				score = 0;
+				for (int g = 0; g < 2; g++) {
+					result.games++;
+					if (outcomes[g] == -1) {
+						result.ties++;
+					} else if (outcomes[g] == seatOfA[g]) {
+						result.winsA++;
+					} else {
+						result.winsB++;
+					}
+					score += scoreFor(outcomes[g], seatOfA[g]);
+				}
+				result.dupPairs++;
+				result.dupSum   += score;
+				result.dupSumSq += score * score;
+			}
+		});
+	});
+	return;
+}
+
+static void *tournamentThread(void *vargp) {
+	TournamentPool *pool = static_cast<TournamentPool*>(vargp);
+	const TournamentConfig &config = *pool->config;
+	int n = config.entrants.size();
+
+	while (true) {
+		long i = pool->next.fetch_add(1);
+		if (i >= static_cast<long>(pool->items.size())) {
+			break;
+		}
+		TournamentItem &item = pool->items[i];
+		// turn the pair index back into the two entrants (pairs are numbered (0,1), (0,2), ..., (1,2), ...)
+		int a = 0, b, p = item.pair;
+		while (p >= n - 1 - a) {
+			p -= n - 1 - a;
+			a++;
+		}
+		b = a + 1 + p;
+		playItem(config, config.entrants, item, a, b);
+	}
+	return NULL;
+}
+
+std::vector<PairResult> runTournament(const TournamentConfig &config, double &seconds) {
+	int n = config.entrants.size();
+	int numPairs = n * (n - 1) / 2;
+	TournamentPool pool;
+	std::vector<pthread_t> tids(config.threads);
+	std::vector<PairResult> pairs(numPairs);
+
+	// split every pair's deals into batches
+	pool.config = &config;
+	pool.next   = 0;
+	for (int p = 0; p < numPairs; p++) {
+		for (long first = 0; first < config.deals; first += DEALSPERBATCH) {
+			TournamentItem item;
+			item.pair      = p;
+			item.firstDeal = first;
+			item.lastDeal  = std::min(config.deals, first + DEALSPERBATCH);
+			pool.items.push_back(item);
+		}
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < config.threads; i++) {
+		Pthread_create(&tids[i], NULL, tournamentThread, &pool);
+	}
+	for (int i = 0; i < config.threads; i++) {
+		Pthread_join(tids[i], NULL);
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// gather each pair's batches back together
+	for (int a = 0, p = 0; a < n; a++) {
+		for (int b = a + 1; b < n; b++, p++) {
+			pairs[p].a = a;
+			pairs[p].b = b;
+		}
+	}
+	for (size_t i = 0; i < pool.items.size(); i++) {
+		pairs[pool.items[i].pair].merge(pool.items[i].result);
+	}
+	return pairs;
+}
+
+/* =====================================
+RATINGS
+===================================== */
+
+// inverts the n x n matrix m in place by Gauss-Jordan elimination with partial pivoting; returns false if it is singular
+static bool invertMatrix(std::vector<std::vector<double> > &m) {
+	int n = m.size();
+	std::vector<std::vector<double> > inv(n, std::vector<double>(n, 0.0));
+	for (int i = 0; i < n; i++) {
+		inv[i][i] = 1.0;
+	}
+	for (int col = 0; col < n; col++) {
+		int pivot = col;
+		for (int row = col + 1; row < n; row++) {
+			if (std::fabs(m[row][col]) > std::fabs(m[pivot][col])) {
+				pivot = row;
+			}
+		}
+		if (std::fabs(m[pivot][col]) < 1e-12) {
+			return false;
+		}
+		std::swap(m[pivot], m[col]);
+		std::swap(inv[pivot], inv[col]);
+		double scale = m[col][col];
+		for (int k = 0; k < n; k++) {
+			m[col][k]   /= scale;
+			inv[col][k] /= scale;
+		}
+		for (int row = 0; row < n; row++) {
+			if (row != col && m[row][col] != 0.0) {
+				double factor = m[row][col];
+				for (int k = 0; k < n; k++) {
+					m[row][k]   -= factor * m[col][k];
+					inv[row][k] -= factor * inv[col][k];
+				}
+			}
+		}
+	}
+	m = inv;
+	return true;
+}
+
+// fits a Bradley-Terry model (a tie counts as half a win) by the minorization-maximization algorithm, then converts it to Elo.
+// Confidence intervals come from the Fisher information, with each pair's game count divided by its design effect, so that
+// the variance that duplicate play removes is not counted.
+std::vector<Rating> computeRatings(int entrants, const std::vector<PairResult> &pairs) {
+	const double ELOSCALE = 400.0 / std::log(10.0);		// Elo points per unit of natural-log strength
+	std::vector<Rating> ratings(entrants);
+	std::vector<double> strength(entrants, 1.0);
+	std::vector<double> wins(entrants, 0.0);
+
+	// every entrant gets one virtual draw against each opponent, so that a clean sweep still has a finite rating
+	for (size_t p = 0; p < pairs.size(); p++) {
+		wins[pairs[p].a] += pairs[p].winsA + 0.5 * pairs[p].ties + 0.5;
+		wins[pairs[p].b] += pairs[p].winsB + 0.5 * pairs[p].ties + 0.5;
+	}
+	for (int iter = 0; iter < 10000; iter++) {
+		double change = 0.0, logmean = 0.0;
+		for (int i = 0; i < entrants; i++) {
+			double denom = 0.0;
+			for (size_t p = 0; p < pairs.size(); p++) {
+				if (pairs[p].a == i || pairs[p].b == i) {
+					int j = (pairs[p].a == i) ? pairs[p].b : pairs[p].a;
+					denom += (pairs[p].games + 1) / (strength[i] + strength[j]);
+				}
+			}
+			double updated = (denom > 0) ? wins[i] / denom : 1.0;
+			change = std::max(change, std::fabs(std::log(updated / strength[i])));
+			strength[i] = updated;
+		}
+		for (int i = 0; i < entrants; i++) {
+			logmean += std::log(strength[i]) / entrants;
+		}
+		for (int i = 0; i < entrants; i++) {
+			strength[i] /= std::exp(logmean);			// keep the mean log-strength at 0
+		}
+		if (change < 1e-10) {
+			break;
+		}
+	}
+
+	// Fisher information of the log-strengths; its rows sum to zero, so invert (I + J/n) and subtract J/n to get the pseudo-inverse
+	std::vector<std::vector<double> > info(entrants, std::vector<double>(entrants, 0.0));
+	for (size_t p = 0; p < pairs.size(); p++) {
+		int a = pairs[p].a, b = pairs[p].b;
+		double pa = strength[a] / (strength[a] + strength[b]);
+		double w  = (pairs[p].games / pairs[p].designEffect()) * pa * (1 - pa);
+		info[a][a] += w;
+		info[b][b] += w;
+		info[a][b] -= w;
+		info[b][a] -= w;
+	}
+	for (int i = 0; i < entrants; i++) {
+		for (int j = 0; j < entrants; j++) {
+			info[i][j] += 1.0 / entrants;
+		}
+	}
+	bool invertible = invertMatrix(info);
+
+	for (int i = 0; i < entrants; i++) {
+		double variance = invertible ? info[i][i] - 1.0 / entrants : 0.0;
+		ratings[i].elo  = 1500.0 + ELOSCALE * std::log(strength[i]);
+		ratings[i].ci95 = invertible ? 1.96 * ELOSCALE * std::sqrt(std::max(0.0, variance)) : INFINITY;
+	}
+	return ratings;
+}
+
+/* =====================================
+REPORTING
+===================================== */
+
+void printTournamentReport(const TournamentConfig &config, const std::vector<PairResult> &pairs, double seconds) {
+	int n = config.entrants.size();
+	long games = 0;
+	std::vector<Rating> ratings = computeRatings(n, pairs);
+	std::vector<int> order(n);
+
+	for (size_t p = 0; p < pairs.size(); p++) {
+		games += pairs[p].games;
+	}
+	for (int i = 0; i < n; i++) {
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&](int x, int y) { return ratings[x].elo > ratings[y].elo; });
+
+	printf("Round-robin tournament: %d entrants, %ld deals per pair (each played in both seat orders), %d rounds per game, %d threads, seed %u\n",
+	       n, config.deals, config.rounds, config.threads, config.seed);
+	printf("Played %ld games in %.3f s: %.0f games/s\n\n", games, seconds, games / seconds);
+
+	printf("RATINGS (Elo, mean 1500, with 95%% confidence interval)\n");
+	for (int r = 0; r < n; r++) {
+		printf("  %2d. %-16s %7.1f +/- %.1f\n", r + 1, config.entrants[order[r]].label.c_str(), ratings[order[r]].elo, ratings[order[r]].ci95);
+	}
+
+	printf("\nPAIRINGS                                  score      W      L      T   duplicate variance factor\n");
+	for (size_t p = 0; p < pairs.size(); p++) {
+		const PairResult &pr = pairs[p];
+		printf("  %-16s vs %-16s   %6.2f%%  %5ld  %5ld  %5ld   %.3f\n",
+		       config.entrants[pr.a].label.c_str(), config.entrants[pr.b].label.c_str(),
+		       100.0 * pr.scoreA(), pr.winsA, pr.winsB, pr.ties, pr.designEffect());
+	}
+	return;
+}
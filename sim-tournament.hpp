@@ -0,0 +1,55 @@
+#ifndef SIM_TOURNAMENT_H
+#define SIM_TOURNAMENT_H
+
+#include <vector>
+#include <string>
+#include "koikoi-strategy.hpp"
+
+/*  ========================================
+ROUND-ROBIN TOURNAMENT
+Every pair of entrants plays the same set of seeded deals twice ("duplicate" play): once with each entrant in
+seat 0, and once with the seats swapped. The first dealer comes from the seed, so each entrant gets the other's
+cards (and role) in the second game of a pair, which cancels out most of the luck of the deal.
+Games are split into batches, and the batches are handed out to a pool of worker threads.
+========================================    */
+
+struct Entrant {
+	StrategyKind	kind;
+	std::string		label;		// unique name shown in the results (the strategy name, numbered if it is entered twice)
+};
+
+// settings for a tournament
+struct TournamentConfig {
+	std::vector<Entrant>	entrants;
+	long					deals;		// # of seeded deals per pair of entrants (each is played twice)
+	int						rounds;		// # of rounds per game
+	int						threads;	// # of worker threads
+	unsigned int			seed;		// base seed for the set of deals (the same set is used for every pair)
+};
+
+// results of all the games between one pair of entrants, from the point of view of the first entrant ("A")
+struct PairResult {
+	int		a, b;				// indices of the entrants in TournamentConfig::entrants
+	long	games;
+	long	winsA, winsB, ties;
+	long	dupPairs;			// # of duplicate pairs played (each pair = 2 games on the same deals)
+	double	dupSum;				// sum over duplicate pairs of A's score (0 to 2, with a tie worth 0.5)
+	double	dupSumSq;			// sum of squares of the same
+
+	PairResult() : a(0), b(0), games(0), winsA(0), winsB(0), ties(0), dupPairs(0), dupSum(0), dupSumSq(0) {}
+	void merge(const PairResult &other);
+	double scoreA() const;		// A's average score per game (0 to 1)
+	double designEffect() const;	// variance of a duplicate pair divided by the variance of two independent games (below 1 = duplicate play helped)
+};
+
+// Elo rating of one entrant
+struct Rating {
+	double	elo;				// rating, with the mean of all entrants set to 1500
+	double	ci95;				// half-width of the 95% confidence interval
+};
+
+std::vector<PairResult> runTournament(const TournamentConfig &config, double &seconds);		// plays every pair; also returns the wall-clock time taken
+std::vector<Rating> computeRatings(int entrants, const std::vector<PairResult> &pairs);		// maximum-likelihood (Bradley-Terry) Elo ratings with confidence intervals
+void printTournamentReport(const TournamentConfig &config, const std::vector<PairResult> &pairs, double seconds);		// prints standings & pairings to stdout
+
+#endif
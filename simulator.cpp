@@ -0,0 +1,129 @@
+//simulator.cpp
+// Plays CPU-vs-CPU games of Koi-Koi with no sockets or text at all, on every core, and reports on them.
+// With -T, plays a round-robin tournament between strategies instead, and rates them.
+extern "C" {
+#include "csapp.h"
+}
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include "sim-selfplay.hpp"
+#include "sim-tournament.hpp"
+
+// prints how to run the simulator, then exits
+static void usage(const char *progname) {
+    fprintf(stderr, "usage: %s [-g games] [-r rounds] [-t threads] [-s seed] [-a strategy] [-b strategy] [-o records]\n", progname);
+    fprintf(stderr, "       %s -T [-p strategy]... [-g deals] [-r rounds] [-t threads] [-s seed]\n", progname);
+    fprintf(stderr, "   -g  number of games to play (default 100000)\n");
+    fprintf(stderr, "   -r  rounds per game, 1-12 (default 12)\n");
+    fprintf(stderr, "   -t  worker threads (default: one per online core)\n");
+    fprintf(stderr, "   -s  base random seed (default: current time)\n");
+    fprintf(stderr, "   -T  play a round-robin tournament; -g is then the number of deals per pair (default 10000)\n");
+    fprintf(stderr, "   -p  enter a strategy in the tournament (repeatable; default: every strategy once)\n");
+    fprintf(stderr, "   -o  append every game to this record store (see koikoi-record.hpp)\n");
+    fprintf(stderr, "   -a  strategy for seat 0, -b strategy for seat 1 (default Random); one of:");
+    for (int k = 0; k < NUMSTRATEGIES; k++) {
+        fprintf(stderr, " %s", strategyName(static_cast<StrategyKind>(k)));
+    }
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+// looks up a strategy by name, exiting with the usage message if there is no such strategy
+static StrategyKind parseStrategy(const char *name, const char *progname) {
+    StrategyKind kind = strategyFromName(name);
+    if (kind == NUMSTRATEGIES) {
+        fprintf(stderr, "%s: unknown strategy \"%s\"\n", progname, name);
+        usage(progname);
+    }
+    return kind;
+}
+
+int main(int argc, char **argv) {
+    SelfPlayConfig config;
+    TournamentConfig tournament;
+    RecordStore records;
+    const char *records_path = NULL;
+    bool is_tournament = false;
+    long games = 0;
+    double seconds;
+    int opt;
+
+    config.strategies[0] = CPU_RANDOM;
+    config.strategies[1] = CPU_RANDOM;
+    config.games         = 100000;
+    config.rounds        = 12;
+    config.threads       = sysconf(_SC_NPROCESSORS_ONLN);
+    config.seed          = time(NULL);
+    config.records       = NULL;
+
+    while ((opt = getopt(argc, argv, "g:r:t:s:a:b:o:Tp:")) != -1) {
+        switch (opt) {
+            case 'g': games                = atol(optarg);                    break;
+            case 'r': config.rounds        = atoi(optarg);                    break;
+            case 't': config.threads       = atoi(optarg);                    break;
+            case 's': config.seed          = strtoul(optarg, NULL, 10);       break;
+            case 'a': config.strategies[0] = parseStrategy(optarg, argv[0]);  break;
+            case 'b': config.strategies[1] = parseStrategy(optarg, argv[0]);  break;
+            case 'o': records_path         = optarg;                          break;
+            case 'T': is_tournament        = true;                            break;
+            case 'p': {
+                Entrant entrant;
+                entrant.kind  = parseStrategy(optarg, argv[0]);
+                entrant.label = strategyName(entrant.kind);
+                tournament.entrants.push_back(entrant);
+                break;
+            }
+            default:  usage(argv[0]);
+        }
+    }
+    if (config.rounds < 1 || config.rounds > 12 || config.threads < 1 || games < 0) {
+        usage(argv[0]);
+    }
+
+    if (!is_tournament) {
+        config.games = (games > 0) ? games : config.games;
+        if (records_path != NULL) {
+            if (!records.open(records_path, true)) {
+                perror(records_path);
+                return 1;
+            }
+            config.records = &records;
+        }
+        SelfPlayStats stats = runSelfPlay(config, seconds);
+        printSelfPlayReport(config, stats, seconds);
+        return 0;
+    }
+
+    // tournament: default to every registered strategy, and number any strategy that was entered more than once
+    if (tournament.entrants.empty()) {
+        for (int k = 0; k < NUMSTRATEGIES; k++) {
+            Entrant entrant;
+            entrant.kind  = static_cast<StrategyKind>(k);
+            entrant.label = strategyName(entrant.kind);
+            tournament.entrants.push_back(entrant);
+        }
+    }
+    for (size_t i = 0; i < tournament.entrants.size(); i++) {
+        int copy = 1;
+        for (size_t j = 0; j < i; j++) {
+            copy += (tournament.entrants[j].kind == tournament.entrants[i].kind) ? 1 : 0;
+        }
+        if (copy > 1) {
+            tournament.entrants[i].label += "#" + std::to_string(copy);
+        }
+    }
+    if (tournament.entrants.size() < 2) {
+        fprintf(stderr, "%s: a tournament needs at least two entrants (enter a strategy twice with -p to compare it with itself)\n", argv[0]);
+        return 1;
+    }
+    tournament.deals   = (games > 0) ? games : 10000;
+    tournament.rounds  = config.rounds;
+    tournament.threads = config.threads;
+    tournament.seed    = config.seed;
+
+    std::vector<PairResult> pairs = runTournament(tournament, seconds);
+    printTournamentReport(tournament, pairs, seconds);
+    return 0;
+}
@@ -0,0 +1,381 @@
+//test-allocs.cpp
+// Checks that playing a turn never touches the heap. Plays seeded games through the engine (see "koikoi-engine.hpp")
+// for every pair of strategies, both directly and through the server's CPUStrategy interface, then whole sessions of the
+// server's own (see "serv-playgame.hpp"), with game records, checkpoints & the leaderboard kept, against the CPU with a
+// client in every protocol and in the arena, and counts every heap allocation made during each turn. After one warm-up
+// game, no turn may allocate more than MAXALLOCSPERTURN times.
+// Run "make check" to build & run it; it exits with 1 (and says which turn it was) if any turn allocates too much.
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <dirent.h>
+#include "koikoi-engine.hpp"
+#include "koikoi-strategy.hpp"
+#include "serv-koikoi.hpp"
+#include "serv-playgame.hpp"
+#include "serv-leaderboard.hpp"
+#include "trace.hpp"
+
+#define MAXALLOCSPERTURN	0		// heap allocations allowed in one turn, once the game is warmed up
+#define WARMUPGAMES			1		// games played (and not checked) before counting starts, so that one-time setup is not counted
+#define CHECKEDGAMES		50		// games checked for each pair of strategies
+#define SERVERGAMES			10		// games checked for each protocol, through the server's sessions
+#define ROUNDS				12
+
+/* =====================================
+COUNTING ALLOCATIONS
+Every heap allocation in the program goes through these. Only the threads that play games count theirs, each in a
+count of its own: the main thread, and the server's session threads (not the clients answering them, nor the
+server's background threads).
+===================================== */
+
+static std::atomic<long> allocations(0);				// the main thread's
+static thread_local std::atomic<long> *counter = NULL;	// this thread's count, if it is counted
+
+void *operator new(std::size_t size) {
+	if (counter != NULL) {
+		counter->fetch_add(1, std::memory_order_relaxed);
+	}
+	void *p = std::malloc(size ? size : 1);
+	if (p == NULL) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+	std::free(p);
+}
+
+/* =====================================
+CHECKING EVERY TURN
+===================================== */
+
+// counts the allocations between one turn and the next (the first turn of a round includes the deal)
+struct AllocObserver {
+	const std::atomic<long>	*count;		// the count of the thread playing the game
+	const char	*label;
+	bool		checking;		// false during the warm-up games
+	int			game;
+	long		mark;			// allocations at the end of the last turn
+	long		turns;			// # of turns checked
+	long		worst;			// most allocations in any checked turn
+	bool		failed;
+
+	bool		inTurns;		// whether the last prompt the client saw was for a turn (see onPrompt())
+
+	explicit AllocObserver(const char *l, const std::atomic<long> *c = &allocations)
+		: count(c), label(l), checking(false), game(0), mark(*c), turns(0), worst(0), failed(false), inTurns(false) {}
+
+	void onTurn(const GameState &g, int seat, const TurnRecord &turn) {
+		long made = *count - mark;
+		if (checking) {
+			turns++;
+			if (made > worst) {
+				worst = made;
+			}
+			if (made > MAXALLOCSPERTURN && !failed) {
+				printf("FAIL %s: game %d, seat %d played %s and allocated %ld time(s) (at most %d allowed)\n",
+				       label, game, seat, turn.handCard.cardNameText(), made, MAXALLOCSPERTURN);
+				failed = true;
+			}
+		}
+		mark = *count;
+	}
+	void onRound(const GameState &, const RoundResult &) {
+		mark = *count;
+	}
+
+	// for a server's game, watched from the client's end: the server waits for an answer after each prompt, so what its
+	// session thread allocated between two prompts for turns (a card to play or match, or Koi-Koi) went on playing turns
+	// (the first turn of a round includes the deal, as above; the prompts before & after a game are not turns; in the
+	// arena, the thread hosting the game plays both clients' turns, all between its own client's prompts)
+	void onPrompt(int kind) {
+		long made = *count - mark;
+		bool turn = (kind >= WIREPROMPT_PLAY && kind <= WIREPROMPT_KOIKOI);
+		if (checking && turn && inTurns) {
+			turns++;
+			if (made > worst) {
+				worst = made;
+			}
+			if (made > MAXALLOCSPERTURN && !failed) {
+				printf("FAIL %s: game %d, the server allocated %ld time(s) in the turn before a prompt of kind %d (at most %d allowed)\n",
+				       label, game, made, kind, MAXALLOCSPERTURN);
+				failed = true;
+			}
+		}
+		inTurns = turn;
+		mark    = *count;
+	}
+};
+
+// plays the warm-up games, then the checked games, between two strategies; returns true if no checked turn allocated too much
+template <class S0, class S1>
+bool checkGames(const char *label, S0 &cpu0, S1 &cpu1, unsigned int seed) {
+	std::mt19937 rng(seed);
+	GameState game;
+	AllocObserver observer(label);
+
+	for (observer.game = 1; observer.game <= WARMUPGAMES + CHECKEDGAMES; observer.game++) {
+		observer.checking = (observer.game > WARMUPGAMES);
+		playGame(game, cpu0, cpu1, ROUNDS, rng, observer);
+	}
+	printf("%-32s %7ld turns, at most %ld allocation(s) in a turn\n", label, observer.turns, observer.worst);
+	return !observer.failed;
+}
+
+// every pair of registered strategies, played directly as templates
+static bool checkAllPairs(const char *suffix, unsigned int seed) {
+	bool ok = true;
+	for (int k0 = 0; k0 < NUMSTRATEGIES; k0++) {
+		for (int k1 = 0; k1 < NUMSTRATEGIES; k1++) {
+			visitStrategy(static_cast<StrategyKind>(k0), seed, [&](auto &cpu0) {
+				visitStrategy(static_cast<StrategyKind>(k1), seed + 1, [&](auto &cpu1) {
+					char label[64];
+					snprintf(label, sizeof(label), "%s v %s%s", strategyName(static_cast<StrategyKind>(k0)),
+					         strategyName(static_cast<StrategyKind>(k1)), suffix);
+					ok = checkGames(label, cpu0, cpu1, seed) && ok;
+				});
+			});
+		}
+	}
+	return ok;
+}
+
+/* =====================================
+CHECKING THE SERVER'S TURNS
+Each client is served by serviceKoiKoi() on one end of a socketpair, on a session thread of its own, just as the server
+serves a connection; a client thread on the other end answers every prompt (the first choice offered, or to a text
+client, every number in turn until one is taken), and plays game after game until enough have been checked.
+===================================== */
+
+// sends a reply line for the JSON protocol or the text one
+static void sendLine(int fd, const char *line) {
+	if (write(fd, line, strlen(line)) < 0) {
+		perror("write");
+	}
+}
+
+// the kind of prompt (a WIREPROMPT_) a text line or a JSON event is, or 0 if it isn't one
+static int promptKind(const char *line, ClientProtocol protocol) {
+	static const char *jsonKinds[] = {"", "\"name\"", "\"rounds\"", "\"strategy\"", "\"play\"", "\"match\"", "\"giveup\"", "\"koikoi\"", "\"after\""};
+	if (protocol == PROTOCOL_JSON) {
+		const char *kind = strstr(line, "\"kind\":");
+		for (int k = WIREPROMPT_NAME; kind != NULL && strstr(line, "\"event\":\"prompt\"") != NULL && k <= WIREPROMPT_AFTER; k++) {
+			if (strncmp(kind + 7, jsonKinds[k], strlen(jsonKinds[k])) == 0) {
+				return k;
+			}
+		}
+		return 0;
+	}
+	if (strstr(line, "Enter a name") != NULL) {			// (every line a text client is sent is a prompt)
+		return WIREPROMPT_NAME;
+	} else if (strstr(line, "Enter a number 1-12") != NULL) {
+		return WIREPROMPT_ROUNDS;
+	} else if (strstr(line, "Enter a number 1-") != NULL) {
+		return WIREPROMPT_STRATEGY;
+	} else if (strstr(line, "to play again") != NULL) {
+		return WIREPROMPT_AFTER;
+	}
+	return (strstr(line, "Koi-Koi") != NULL) ? WIREPROMPT_KOIKOI : WIREPROMPT_PLAY;
+}
+
+// the answer to a prompt, as a number: ROUNDS rounds, the given opponent, and another game until the warm-up & checked
+// games are done (text clients number opponents from 1, and answer "after" prompts with 97 or 99)
+static int chooseAnswer(int kind, CardMask choices, ClientProtocol protocol, int opponent, AllocObserver &observer) {
+	switch (kind) {
+		case WIREPROMPT_ROUNDS:
+			return ROUNDS;
+		case WIREPROMPT_STRATEGY:
+			return opponent + ((protocol == PROTOCOL_TEXT) ? 1 : 0);
+		case WIREPROMPT_AFTER:
+			if (observer.game++ >= WARMUPGAMES + SERVERGAMES) {
+				return (protocol == PROTOCOL_TEXT) ? 99 : AFTER_QUIT;
+			}
+			observer.checking = (observer.game > WARMUPGAMES);
+			return (protocol == PROTOCOL_TEXT) ? 97 : AFTER_AGAIN;
+		default:
+			return __builtin_ctzll(choices);
+	}
+}
+
+// plays the client's side of a session (see above) until the server closes its end, counting the server's turns
+static void answerPrompts(int fd, ClientProtocol protocol, unsigned char hello, const char *name, int opponent, AllocObserver *observer) {
+	char buffer[8192];
+	int have = 0, next = 0;
+	bool greeted = false;			// whether the name prompt (answered up front, with the handshake) has been read
+	char line[32];
+	int length = 0;
+
+	if (hello != 0) {				// (the name line, sent straight away, starts with the handshake byte)
+		line[length++] = hello;
+	}
+	snprintf(line + length, sizeof(line) - length, "%s\n", name);
+	sendLine(fd, line);
+	observer->game = 1;
+	while (true) {
+		ssize_t n = read(fd, buffer + have, sizeof(buffer) - have);
+		if (n <= 0) {
+			return;
+		}
+		have += n;
+		int used = 0;
+		while (used < have) {
+			char *at = buffer + used;
+			if (protocol == PROTOCOL_BINARY && greeted) {
+				if (have - used < WIREHEADER || have - used < WIREHEADER + static_cast<unsigned char>(at[1])) {
+					break;
+				}
+				if (at[0] == WIRE_PROMPT) {
+					observer->onPrompt(at[2]);
+					CardMask choices = wireU64(reinterpret_cast<unsigned char*>(at) + 4);
+					unsigned char answer[3] = {WIRE_ANSWER, 1, static_cast<unsigned char>(chooseAnswer(at[2], choices, protocol, opponent, *observer))};
+					if (write(fd, answer, sizeof(answer)) < 0) {
+						perror("write");
+					}
+				}
+				used += WIREHEADER + static_cast<unsigned char>(at[1]);
+				continue;
+			}
+			char *end = static_cast<char*>(memchr(at, '\n', have - used));
+			if (end == NULL) {
+				break;
+			}
+			*end = '\0';
+			int kind = promptKind(at, protocol);
+			if (!greeted) {
+				greeted = true;
+			} else if (kind != 0) {
+				observer->onPrompt(kind);
+				if (protocol == PROTOCOL_TEXT) {
+					int answer = (kind >= WIREPROMPT_PLAY && kind <= WIREPROMPT_KOIKOI) ? next++ % NUMCARDS : chooseAnswer(kind, 0, protocol, opponent, *observer);
+					snprintf(line, sizeof(line), "%d\n", answer);
+				} else {
+					const char *choices = strstr(at, "\"choices\":[");
+					CardMask mask = (choices != NULL) ? 1ULL << strtol(choices + 11, NULL, 10) : 0;
+					snprintf(line, sizeof(line), "{\"answer\":%d}\n", chooseAnswer(kind, mask, protocol, opponent, *observer));
+				}
+				sendLine(fd, line);
+			}
+			used = end + 1 - buffer;
+		}
+		memmove(buffer, buffer + used, have - used);
+		have -= used;
+	}
+}
+
+// serves a client on the end of a socketpair on a session thread, as the server would, then closes it
+static void serveSession(int fd, std::atomic<long> *allocs) {
+	counter = allocs;
+	serviceKoiKoi(fd);
+	close(fd);
+}
+
+// plays the warm-up game, then the checked games, with a client per name (to two clients, the opponent should be the
+// arena) that shakes hands with hello (0: a text client); returns true if no checked turn allocated too much
+static bool checkServerSessions(const char *label, unsigned char hello, int opponent, int clients, const char *const names[]) {
+	ClientProtocol protocol = ((hello & WIREJSON) != 0) ? PROTOCOL_JSON : (((hello & WIREHELLO) != 0) ? PROTOCOL_BINARY : PROTOCOL_TEXT);
+	std::thread servers[2], players[2];
+	std::atomic<long> allocs[2] = {{0}, {0}};
+	AllocObserver observers[2] = {AllocObserver(label, &allocs[0]), AllocObserver(label, &allocs[1])};
+	int fds[2][2];
+	bool ok = true;
+
+	for (int c = 0; c < clients; c++) {
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds[c]) < 0) {
+			perror("socketpair");
+			return false;
+		}
+		servers[c] = std::thread(serveSession, fds[c][0], &allocs[c]);
+		players[c] = std::thread(answerPrompts, fds[c][1], protocol, hello, names[c], opponent, &observers[c]);
+	}
+	for (int c = 0; c < clients; c++) {
+		servers[c].join();
+		players[c].join();
+		close(fds[c][1]);
+		printf("%-32s %7ld turns, at most %ld allocation(s) in a turn\n", label, observers[c].turns, observers[c].worst);
+		ok = !observers[c].failed && observers[c].turns > 0 && ok;
+	}
+	return ok;
+}
+
+// keeps game records, checkpoints & the leaderboard in a fresh directory, as the server would, for the sessions
+static void openServerFiles(char *dir) {
+	char path[64];
+	if (mkdtemp(dir) == NULL) {
+		perror("mkdtemp");
+		exit(1);
+	}
+	snprintf(path, sizeof(path), "%s/records", dir);
+	openGameRecords(path);
+	snprintf(path, sizeof(path), "%s/checkpoints", dir);
+	openCheckpoints(path);
+	snprintf(path, sizeof(path), "%s/leaderboard", dir);
+	openLeaderboard(path);
+}
+
+// deletes the directory & everything in it (the server's files stay open, but the test is about to end)
+static void removeServerFiles(const char *dir) {
+	char path[320];
+	DIR *listing = opendir(dir);
+	struct dirent *entry;
+	while (listing != NULL && (entry = readdir(listing)) != NULL) {
+		if (entry->d_name[0] != '.') {
+			snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+			unlink(path);
+		}
+	}
+	if (listing != NULL) {
+		closedir(listing);
+	}
+	rmdir(dir);
+}
+
+int main() {
+	static const char *const players[2] = {"server-test", "server-test-2"};
+	static const char *const arenaPlayers[2] = {"arena-test", "arena-test-2"};
+	char dir[] = "/tmp/htest.XXXXXX";
+	bool ok = true;
+
+	counter = &allocations;
+	ok = checkAllPairs("", 1) && ok;
+
+	// the server plays its CPU through the runtime interface
+	for (int k = 0; k < NUMSTRATEGIES; k++) {
+		CPUStrategy *cpu0 = makeStrategy(static_cast<StrategyKind>(k), 1);
+		CPUStrategy *cpu1 = makeStrategy(static_cast<StrategyKind>(k), 2);
+		char label[64];
+		snprintf(label, sizeof(label), "%s v %s (CPUStrategy)", strategyName(static_cast<StrategyKind>(k)), strategyName(static_cast<StrategyKind>(k)));
+		ok = checkGames(label, *cpu0, *cpu1, 1) && ok;
+		delete cpu0;
+		delete cpu1;
+	}
+
+	// the server's sessions, with the prompts & everything printed, recorded, checkpointed & ranked, in every protocol
+	openServerFiles(dir);
+	ok = checkServerSessions("Server turns (text)", 0, CPU_GREEDY, 1, players) && ok;
+	ok = checkServerSessions("Server turns (text, deltas)", WIREDELTAS, CPU_GREEDY, 1, players) && ok;
+	ok = checkServerSessions("Server turns (binary)", WIREHELLO, CPU_GREEDY, 1, players) && ok;
+	ok = checkServerSessions("Server turns (binary, deltas)", WIREHELLO | WIREDELTAS, CPU_GREEDY, 1, players) && ok;
+	ok = checkServerSessions("Server turns (JSON)", WIREJSON, CPU_GREEDY, 1, players) && ok;
+	ok = checkServerSessions("Server turns (binary, arena)", WIREHELLO, OPPONENT_ARENA, 2, arenaPlayers) && ok;
+	removeServerFiles(dir);
+
+	// recording trace events must not allocate either (the thread's ring is handed out during the warm-up)
+	traceStart();
+	ok = checkAllPairs(" (tracing)", 2) && ok;
+	traceStop();
+
+	printf("%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
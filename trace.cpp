@@ -0,0 +1,119 @@
+#include "trace.hpp"
+#include <pthread.h>
+#include <chrono>
+#include <vector>
+#include <cstdio>
+
+std::atomic<bool> traceEnabled(false);
+
+// one finished TRACE_SCOPE
+struct TraceEvent {
+	const char			*name;
+	unsigned long long	start, end;
+};
+
+// one thread's events; only the owning thread writes events & head, and a ring is only handed to a new owner with the lock held
+struct TraceRing {
+	TraceEvent					events[TRACEEVENTS];
+	std::atomic<unsigned long>	head;			// # of events written since the ring was handed to its owner (the next goes in head % TRACEEVENTS)
+	int							tid;			// thread # shown in the trace
+	bool						inUse;			// false once the owning thread has exited (its events are kept until the ring is reused)
+	TraceRing					*next;			// every ring ever made
+};
+
+static pthread_mutex_t ringLock = PTHREAD_MUTEX_INITIALIZER;
+static TraceRing *allRings = NULL;
+static int nextTid = 1;
+static std::atomic<unsigned long long> startedAt(0);	// events from before the last traceStart() are left out of the dump
+
+// gives the ring back when its thread exits, so that the next new thread can reuse it
+struct RingHolder {
+	TraceRing *ring;
+	RingHolder() : ring(NULL) {}
+	~RingHolder() {
+		if (ring != NULL) {
+			pthread_mutex_lock(&ringLock);
+			ring->inUse = false;
+			pthread_mutex_unlock(&ringLock);
+		}
+	}
+};
+static thread_local RingHolder holder;
+
+static TraceRing *acquireRing() {
+	TraceRing *ring;
+	pthread_mutex_lock(&ringLock);
+	for (ring = allRings; ring != NULL && ring->inUse; ring = ring->next) {}
+	if (ring == NULL) {
+		ring = new TraceRing;
+		ring->next = allRings;
+		allRings   = ring;
+	}
+	ring->head.store(0, std::memory_order_relaxed);
+	ring->tid   = nextTid++;
+	ring->inUse = true;
+	pthread_mutex_unlock(&ringLock);
+	return ring;
+}
+
+unsigned long long traceNow() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void traceRecord(const char *name, unsigned long long start, unsigned long long end) {
+	if (holder.ring == NULL) {
+		holder.ring = acquireRing();
+	}
+	TraceRing *ring = holder.ring;
+	unsigned long h = ring->head.load(std::memory_order_relaxed);
+	TraceEvent &event = ring->events[h % TRACEEVENTS];
+	event.name  = name;
+	event.start = start;
+	event.end   = end;
+	ring->head.store(h + 1, std::memory_order_release);
+	return;
+}
+
+void traceStart() {
+	startedAt.store(traceNow());
+	traceEnabled.store(true);
+	return;
+}
+
+void traceStop() {
+	traceEnabled.store(false);
+	return;
+}
+
+std::string traceDump() {
+	unsigned long long since = startedAt.load();
+	std::vector<TraceEvent> copied;
+	std::string out = "{\"traceEvents\":[\n";
+	char line[256];
+	bool first = true;
+
+	pthread_mutex_lock(&ringLock);
+	for (TraceRing *ring = allRings; ring != NULL; ring = ring->next) {
+		// copy the ring while its owner may still be writing to it, then drop anything that was overwritten during the copy
+		unsigned long before = ring->head.load(std::memory_order_acquire);
+		unsigned long oldest = (before > TRACEEVENTS) ? before - TRACEEVENTS : 0;
+		copied.assign(ring->events, ring->events + TRACEEVENTS);
+		unsigned long after = ring->head.load(std::memory_order_acquire);
+		unsigned long valid = (after > TRACEEVENTS) ? after - TRACEEVENTS : 0;
+
+		for (unsigned long i = (oldest > valid ? oldest : valid); i < before; i++) {
+			const TraceEvent &event = copied[i % TRACEEVENTS];
+			if (event.start < since) {
+				continue;
+			}
+			snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+			         first ? "" : ",\n", event.name, (event.start - since) / 1000.0, (event.end - event.start) / 1000.0, ring->tid);
+			out += line;
+			first = false;
+		}
+	}
+	pthread_mutex_unlock(&ringLock);
+
+	out += "\n]}\n";
+	return out;
+}
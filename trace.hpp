@@ -0,0 +1,49 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <string>
+
+/*  ========================================
+TRACING
+TRACE_SCOPE("name") records how long the rest of the enclosing block takes, as one event in the calling thread's own
+ring buffer (the oldest events are overwritten once it is full). traceDump() turns every thread's ring into Chrome
+trace JSON, which chrome://tracing or ui.perfetto.dev can open.
+
+Tracing is off until traceStart() is called; while it is off, a TRACE_SCOPE costs one relaxed load and a branch.
+Compiling with -DNOTRACE removes every TRACE_SCOPE entirely.
+========================================    */
+
+#define TRACEEVENTS 8192		// # of events each thread's ring holds
+
+extern std::atomic<bool> traceEnabled;
+
+unsigned long long traceNow();											// steady clock reading in nanoseconds
+void traceRecord(const char *name, unsigned long long start, unsigned long long end);	// adds an event to the calling thread's ring
+void traceStart();														// starts recording events (and forgets any recorded before)
+void traceStop();														// stops recording events (those already recorded can still be dumped)
+std::string traceDump();												// every recorded event, as Chrome trace JSON
+
+// records the time from its construction to its destruction, if tracing was on when it was constructed
+class TraceScope {
+private:
+	const char			*name;			// must be a string literal (only the pointer is kept)
+	unsigned long long	start;			// 0 if tracing was off
+public:
+	explicit TraceScope(const char *n) : name(n), start(traceEnabled.load(std::memory_order_relaxed) ? traceNow() : 0) {}
+	~TraceScope() {
+		if (start != 0) {
+			traceRecord(name, start, traceNow());
+		}
+	}
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#ifdef NOTRACE
+#define TRACE_SCOPE(name)
+#else
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#endif
+
+#endif